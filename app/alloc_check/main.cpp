@@ -0,0 +1,238 @@
+/*
+ *  SLAMTEC LIDAR
+ *  Steady State Allocation Checker
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#include "sl_lidar.h"
+#include "sl_lidar_driver.h"
+#ifndef _countof
+#define _countof(_Array) (int)(sizeof(_Array) / sizeof(_Array[0]))
+#endif
+
+using namespace sl;
+
+// Every heap allocation of the process goes through these hooks. While the check is armed,
+// any allocation, from the calling thread or from the capture thread of the driver, is counted.
+static std::atomic<bool> allocCheckArmed(false);
+static std::atomic<unsigned long> allocCount(0);
+
+static void countAlloc()
+{
+    if (allocCheckArmed.load(std::memory_order_relaxed)) allocCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+// glibc exports its allocator under these names, the C allocation functions can then be interposed by the program
+// to also catch the allocations of the C library on behalf of the SDK (fopen, getaddrinfo...).
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        countAlloc();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        countAlloc();
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        countAlloc();
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+#endif
+
+void* operator new(size_t size)
+{
+#ifndef __GLIBC__
+    // counted by malloc otherwise
+    countAlloc();
+#endif
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+static void armAllocCheck()
+{
+    allocCount = 0;
+    allocCheckArmed = true;
+}
+
+static unsigned long disarmAllocCheck()
+{
+    allocCheckArmed = false;
+    return allocCount;
+}
+
+void print_usage(int argc, const char * argv[])
+{
+    printf("Usage:\n"
+           " For serial channel\n %s --serial <com port> <baudrate> [scan count]\n"
+           " For tcp channel\n %s --tcp <ipaddr> <port NO.> [scan count]\n"
+           " For udp channel\n %s --udp <ipaddr> <port NO.> [scan count]\n"
+           , argv[0], argv[0], argv[0]);
+}
+
+static IChannel* createChannel(const char* type, const char* address, int param)
+{
+    if (strcmp(type, "--serial") == 0) return *createSerialPortChannel(address, param);
+    if (strcmp(type, "--tcp") == 0) return *createTcpChannel(address, param);
+    if (strcmp(type, "--udp") == 0) return *createUdpChannel(address, param);
+    return NULL;
+}
+
+// The control requests an application keeps issuing once the lidar is up
+static void runControlPath(ILidarDriver* drv)
+{
+    sl_lidar_response_device_info_t devinfo;
+    sl_lidar_response_device_health_t health;
+    LidarMotorInfo motorInfo;
+    sl_u16 typicalMode;
+    sl_u8 macAddr[6];
+
+    drv->getDeviceInfo(devinfo);
+    drv->getHealth(health);
+    drv->getMotorInfo(motorInfo);
+    drv->getTypicalScanMode(typicalMode);
+    // not cached by the driver, each call goes through a full configuration request
+    drv->getDeviceMacAddr(macAddr);
+}
+
+int main(int argc, const char * argv[]) {
+    int scanCount = 100;
+    int failures = 0;
+
+    printf("Steady state allocation checker for SLAMTEC LIDAR.\n"
+           "Version: %s\n", SL_LIDAR_SDK_VERSION);
+
+    if (argc < 4) {
+        print_usage(argc, argv);
+        return -1;
+    }
+    if (argc > 4) scanCount = atoi(argv[4]);
+
+    IChannel* channel = createChannel(argv[1], argv[2], (int)strtoul(argv[3], NULL, 10));
+    ILidarDriver* drv = *createLidarDriver();
+    if (!channel || !drv || SL_IS_FAIL(drv->connect(channel))) {
+        fprintf(stderr, "Error, cannot connect to the lidar.\n");
+        return -1;
+    }
+
+    // the first round fills the per-connection caches, only the following ones are steady state
+    runControlPath(drv);
+    armAllocCheck();
+    for (int round = 0; round < 10; ++round) {
+        runControlPath(drv);
+    }
+    unsigned long controlAllocs = disarmAllocCheck();
+    printf("control path, cached: %lu allocation(s)\n", controlAllocs);
+    if (controlAllocs) ++failures;
+
+    // a new driver has not learned the device profile yet, every request of its first round goes to the lidar
+    controlAllocs = 0;
+    for (int round = 0; round < 10; ++round) {
+        drv->disconnect();
+        delete drv;
+        drv = *createLidarDriver();
+        if (!drv || SL_IS_FAIL(drv->connect(channel))) {
+            fprintf(stderr, "Error, cannot connect to the lidar.\n");
+            return -1;
+        }
+        armAllocCheck();
+        runControlPath(drv);
+        controlAllocs += disarmAllocCheck();
+    }
+    printf("control path, requests: %lu allocation(s)\n", controlAllocs);
+    if (controlAllocs) ++failures;
+
+    if (SL_IS_FAIL(drv->startScan(false, true))) {
+        fprintf(stderr, "Error, cannot start the scan.\n");
+        return -1;
+    }
+
+    sl_lidar_response_measurement_node_hq_t nodes[8192];
+    size_t count;
+    for (int scan = 0; scan < 5; ++scan) {
+        count = _countof(nodes);
+        drv->grabScanDataHq(nodes, count);
+    }
+
+    armAllocCheck();
+    int grabbed = 0;
+    for (int scan = 0; scan < scanCount; ++scan) {
+        LidarScanHeader header;
+        count = _countof(nodes);
+        if (SL_IS_OK(drv->grabScanDataHqWithHeader(header, nodes, count))) {
+            drv->ascendScanData(nodes, count);
+            ++grabbed;
+        }
+        // served from the last known health while scanning, without interrupting the capture
+        sl_lidar_response_device_health_t health;
+        drv->getHealth(health);
+    }
+    unsigned long captureAllocs = disarmAllocCheck();
+    printf("capture path: %lu allocation(s) over %d scan(s)\n", captureAllocs, grabbed);
+    if (captureAllocs || !grabbed) ++failures;
+
+    drv->stop();
+    drv->disconnect();
+    delete drv;
+    delete channel;
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*
+ *  SLAMTEC LIDAR
+ *  Bring-up Latency Benchmark App
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "sl_lidar.h"
+#include "sl_lidar_driver.h"
+#ifndef _countof
+#define _countof(_Array) (int)(sizeof(_Array) / sizeof(_Array[0]))
+#endif
+
+using namespace sl;
+
+void print_usage(int argc, const char * argv[])
+{
+    printf("Usage:\n"
+           " For serial channel\n %s --serial <com port> <baudrate> [options]\n"
+           " For tcp channel\n %s --tcp <ipaddr> <port NO.> [options]\n"
+           " For udp channel\n %s --udp <ipaddr> <port NO.> [options]\n"
+           " Options:\n"
+           "  --rounds <count>          number of connect to first scan cycles, 5 by default\n"
+           "  --profile-cache <dir>     enable the on-disk device profile cache\n"
+           , argv[0], argv[0], argv[0]);
+}
+
+static double elapsedMs(const std::chrono::steady_clock::time_point& from)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - from).count();
+}
+
+enum BringupPhase
+{
+    PHASE_CONNECT = 0,
+    PHASE_DEVINFO,
+    PHASE_HEALTH,
+    PHASE_START_SCAN,
+    PHASE_FIRST_SCAN,
+    PHASE_STOP,
+    PHASE_COUNT,
+};
+
+static const char* phaseNames[PHASE_COUNT] = {
+    "connect", "getDeviceInfo", "getHealth", "startScan", "first scan", "stop",
+};
+
+static IChannel* createChannel(const char* type, const char* address, int param)
+{
+    if (strcmp(type, "--serial") == 0) return *createSerialPortChannel(address, param);
+    if (strcmp(type, "--tcp") == 0) return *createTcpChannel(address, param);
+    if (strcmp(type, "--udp") == 0) return *createUdpChannel(address, param);
+    return NULL;
+}
+
+// One bring-up cycle as done by a freshly started application, from the channel open to the first complete scan
+static bool runRound(IChannel* channel, const char* profileCacheDir, double* phaseMs)
+{
+    ILidarDriver* drv = *createLidarDriver();
+    if (!drv) return false;
+    if (profileCacheDir) drv->setDeviceProfileCache(profileCacheDir);
+
+    bool ok = false;
+    std::chrono::steady_clock::time_point ts = std::chrono::steady_clock::now();
+    do {
+        if (SL_IS_FAIL(drv->connect(channel))) break;
+        phaseMs[PHASE_CONNECT] = elapsedMs(ts);
+
+        ts = std::chrono::steady_clock::now();
+        sl_lidar_response_device_info_t devinfo;
+        if (SL_IS_FAIL(drv->getDeviceInfo(devinfo))) break;
+        phaseMs[PHASE_DEVINFO] = elapsedMs(ts);
+
+        ts = std::chrono::steady_clock::now();
+        sl_lidar_response_device_health_t health;
+        if (SL_IS_FAIL(drv->getHealth(health))) break;
+        phaseMs[PHASE_HEALTH] = elapsedMs(ts);
+
+        ts = std::chrono::steady_clock::now();
+        LidarScanMode scanMode;
+        if (SL_IS_FAIL(drv->startScan(false, true, 0, &scanMode))) break;
+        phaseMs[PHASE_START_SCAN] = elapsedMs(ts);
+
+        ts = std::chrono::steady_clock::now();
+        sl_lidar_response_measurement_node_hq_t nodes[8192];
+        size_t count = _countof(nodes);
+        if (SL_IS_FAIL(drv->grabScanDataHq(nodes, count, 5000))) break;
+        phaseMs[PHASE_FIRST_SCAN] = elapsedMs(ts);
+
+        ts = std::chrono::steady_clock::now();
+        drv->stop();
+        phaseMs[PHASE_STOP] = elapsedMs(ts);
+        ok = true;
+    } while (0);
+
+    drv->disconnect();
+    delete drv;
+    return ok;
+}
+
+int main(int argc, const char * argv[]) {
+    const char * profileCacheDir = NULL;
+    int rounds = 5;
+
+    printf("Bring-up latency benchmark for SLAMTEC LIDAR.\n"
+           "Version: %s\n", SL_LIDAR_SDK_VERSION);
+
+    if (argc < 4) {
+        print_usage(argc, argv);
+        return -1;
+    }
+
+    for (int pos = 4; pos < argc; ++pos) {
+        if (strcmp(argv[pos], "--rounds") == 0 && pos + 1 < argc) {
+            rounds = atoi(argv[++pos]);
+        } else if (strcmp(argv[pos], "--profile-cache") == 0 && pos + 1 < argc) {
+            profileCacheDir = argv[++pos];
+        } else {
+            print_usage(argc, argv);
+            return -1;
+        }
+    }
+
+    IChannel* channel = createChannel(argv[1], argv[2], (int)strtoul(argv[3], NULL, 10));
+    if (!channel) {
+        print_usage(argc, argv);
+        return -1;
+    }
+
+    double sumMs[PHASE_COUNT] = { 0 };
+    double maxMs[PHASE_COUNT] = { 0 };
+    int succeeded = 0;
+
+    printf("%-6s", "round");
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) printf(" %14s", phaseNames[phase]);
+    printf(" %14s\n", "total (ms)");
+
+    for (int round = 0; round < rounds; ++round) {
+        double phaseMs[PHASE_COUNT] = { 0 };
+        if (!runRound(channel, profileCacheDir, phaseMs)) {
+            fprintf(stderr, "Error, round %d failed to bring up the lidar.\n", round);
+            continue;
+        }
+
+        double total = 0;
+        printf("%-6d", round);
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            printf(" %14.1f", phaseMs[phase]);
+            sumMs[phase] += phaseMs[phase];
+            if (phaseMs[phase] > maxMs[phase]) maxMs[phase] = phaseMs[phase];
+            if (phase != PHASE_STOP) total += phaseMs[phase];
+        }
+        printf(" %14.1f\n", total);
+        ++succeeded;
+    }
+
+    if (succeeded) {
+        double total = 0;
+        printf("%-6s", "mean");
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            printf(" %14.1f", sumMs[phase] / succeeded);
+            if (phase != PHASE_STOP) total += sumMs[phase] / succeeded;
+        }
+        printf(" %14.1f\n", total);
+
+        printf("%-6s", "max");
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) printf(" %14.1f", maxMs[phase]);
+        printf("\n");
+    }
+
+    delete channel;
+    return succeeded == rounds ? 0 : 1;
+}
@@ -65,8 +65,11 @@ void print_usage(int argc, const char* argv[])
         "Usage:\n"
         " %s <com port> [baudrate]\n"
         " The baudrate can be ANY possible values between 115200 to 512000.\n"
+        " %s <com port> --auto [profile cache dir]\n"
+        " Starting from 115200, move to the fastest baudrate keeping the capsule loss under 0.1%%.\n"
+        " With a profile cache dir, the baudrate found is recorded and verified first on the next run.\n"
 
-        , "SL_LIDAR_SDK_VERSION", argv[0]);
+        , "SL_LIDAR_SDK_VERSION", argv[0], argv[0]);
 }
 
 
@@ -77,6 +80,8 @@ int main(int argc, const char* argv[]) {
     sl_result   op_result;
 
     IChannel* _channel;
+    bool        opt_auto = false;
+    const char* opt_profile_cache = NULL;
 
     printf("Baudrate negotiation demo for SLAMTEC LIDAR.\n");
 
@@ -91,7 +96,13 @@ int main(int argc, const char* argv[]) {
         return -1;
     }
 
-    if (argc > 2)
+    if (argc > 2 && strcmp(argv[2], "--auto") == 0)
+    {
+        opt_auto = true;
+        opt_required_baudrate = 115200;
+        if (argc > 3) opt_profile_cache = argv[3];
+    }
+    else if (argc > 2)
     {
         opt_required_baudrate = strtoul(argv[2], NULL, 10);
         if (opt_required_baudrate < 115200 || opt_required_baudrate > 512000)
@@ -120,6 +131,24 @@ int main(int argc, const char* argv[]) {
             break;
         }
 
+        if (opt_auto)
+        {
+            static const sl_u32 candidates[] = { 230400, 256000, 460800, 512000 };
+            std::vector<sl_u32> baudrates(candidates, candidates + _countof(candidates));
+            LidarBaudRateNegotiation negotiation;
+
+            if (opt_profile_cache) (drv)->setDeviceProfileCache(opt_profile_cache);
+            if (SL_IS_FAIL((drv)->negotiateBestSerialBaudRate(baudrates, 0.001f, &negotiation)))
+            {
+                fprintf(stderr, "Error, cannot perform baudrate negotiation.\n");
+                break;
+            }
+
+            printf("Settled on %d bps%s. Detected: %d bps, error: %.3f %%, capsule loss: %.4f %%\n"
+                , negotiation.baudrate, negotiation.from_record ? " (recorded)" : ""
+                , negotiation.detected_bps, negotiation.bps_error, negotiation.loss_rate * 100.0f);
+            break;
+        }
 
         // the same baudrate value must be used here 
         sl_u32 baudrateDetected;
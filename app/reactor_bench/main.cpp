@@ -0,0 +1,517 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+
+#include "sl_lidar.h"
+#include "sl_lidar_driver.h"
+#ifndef _countof
+#define _countof(_Array) (int)(sizeof(_Array) / sizeof(_Array[0]))
+#endif
+
+using namespace sl;
+
+// Simulated lidars: 10 rotations per second of 40 dense capsules, 16000 samples per second each
+enum {
+    SIM_ROTATION_HZ = 10,
+    SIM_CAPSULES_PER_ROTATION = 40,
+};
+
+void print_usage(int argc, const char * argv[])
+{
+    printf("Usage:\n"
+           " %s [options]\n"
+           " Options:\n"
+           "  --devices <count>         number of simulated lidars, 16 by default\n"
+           "  --threads <count>         threads of the reactor, 1 by default\n"
+           "  --seconds <count>         duration of each measurement, 5 by default\n"
+           "  --mode <thread|reactor>   only run one of the two capture modes\n"
+           , argv[0]);
+}
+
+static sl_u64 monotonicUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (sl_u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Written by the simulator, read by the benchmark: when the first capsule of the last rotation of each lidar was sent
+struct SharedClock
+{
+    std::atomic<sl_u64> rotation_sent_us[1];
+};
+
+// One simulated lidar of the simulator process, answering on its own TCP port
+struct SimDevice
+{
+    int     listen_fd;
+    int     conn_fd;
+    bool    streaming;
+    int     capsule_index;
+    sl_u64  next_capsule_us;
+    sl_u8   rx[256];
+    size_t  rx_size;
+};
+
+static void simSend(SimDevice& dev, sl_u8 type, const void* payload, sl_u32 size)
+{
+    sl_u8 buf[256];
+    sl_lidar_ans_header_t header;
+    header.syncByte1 = SL_LIDAR_ANS_SYNC_BYTE1;
+    header.syncByte2 = SL_LIDAR_ANS_SYNC_BYTE2;
+    // the measurement stream is a multiple response
+    header.size_q30_subtype = size | (type == SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED ? (1u << SL_LIDAR_ANS_HEADER_SUBTYPE_SHIFT) : 0);
+    header.type = type;
+    memcpy(buf, &header, sizeof(header));
+    if (payload) memcpy(buf + sizeof(header), payload, size);
+    send(dev.conn_fd, buf, sizeof(header) + (payload ? size : 0), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static void simAnswerConf(SimDevice& dev, const sl_u8* payload, size_t size)
+{
+    if (size < 4) return;
+    sl_u8 buf[64];
+    sl_u32 type;
+    memcpy(&type, payload, 4);
+    memcpy(buf, &type, 4);
+    size_t len = 4;
+    sl_u16 mode = 0;
+    if (size >= 6) memcpy(&mode, payload + 4, 2);
+
+    // two scan modes: Standard, and the typical one answering dense capsules
+    sl_u32 value32 = 0;
+    sl_u16 value16 = 0;
+    switch (type) {
+    case SL_LIDAR_CONF_SCAN_MODE_COUNT:
+        value16 = 2;
+        memcpy(buf + len, &value16, 2); len += 2;
+        break;
+    case SL_LIDAR_CONF_SCAN_MODE_TYPICAL:
+        value16 = 1;
+        memcpy(buf + len, &value16, 2); len += 2;
+        break;
+    case SL_LIDAR_CONF_SCAN_MODE_US_PER_SAMPLE:
+        value32 = (1000000 / (SIM_ROTATION_HZ * SIM_CAPSULES_PER_ROTATION * 40)) << 8;
+        memcpy(buf + len, &value32, 4); len += 4;
+        break;
+    case SL_LIDAR_CONF_SCAN_MODE_MAX_DISTANCE:
+        value32 = 12 << 8;
+        memcpy(buf + len, &value32, 4); len += 4;
+        break;
+    case SL_LIDAR_CONF_SCAN_MODE_ANS_TYPE:
+        buf[len++] = mode ? SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED : SL_LIDAR_ANS_TYPE_MEASUREMENT;
+        break;
+    case SL_LIDAR_CONF_SCAN_MODE_NAME:
+        strcpy((char*)buf + len, mode ? "Dense" : "Standard");
+        len += strlen((char*)buf + len) + 1;
+        break;
+    default:
+        memcpy(buf + len, &value32, 4); len += 4;
+        break;
+    }
+    simSend(dev, SL_LIDAR_ANS_TYPE_GET_LIDAR_CONF, buf, (sl_u32)len);
+}
+
+static void simHandleCommand(SimDevice& dev, sl_u8 cmd, const sl_u8* payload, size_t size)
+{
+    switch (cmd) {
+    case SL_LIDAR_CMD_GET_DEVICE_INFO:
+        {
+            sl_lidar_response_device_info_t info;
+            memset(&info, 0, sizeof(info));
+            info.model = 0x71;
+            info.firmware_version = 0x0102;
+            info.hardware_version = 3;
+            simSend(dev, SL_LIDAR_ANS_TYPE_DEVINFO, &info, sizeof(info));
+        }
+        break;
+    case SL_LIDAR_CMD_GET_DEVICE_HEALTH:
+        {
+            sl_lidar_response_device_health_t health;
+            memset(&health, 0, sizeof(health));
+            simSend(dev, SL_LIDAR_ANS_TYPE_DEVHEALTH, &health, sizeof(health));
+        }
+        break;
+    case SL_LIDAR_CMD_GET_LIDAR_CONF:
+        simAnswerConf(dev, payload, size);
+        break;
+    case SL_LIDAR_CMD_EXPRESS_SCAN:
+        simSend(dev, SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED, NULL, sizeof(sl_lidar_response_dense_capsule_measurement_nodes_t));
+        dev.streaming = true;
+        dev.capsule_index = 0;
+        dev.next_capsule_us = monotonicUs();
+        break;
+    case SL_LIDAR_CMD_STOP:
+        dev.streaming = false;
+        break;
+    }
+}
+
+// Parse the requests received so far, the ones without answer (motor, reset...) are ignored
+static void simParse(SimDevice& dev)
+{
+    size_t pos = 0;
+    while (pos < dev.rx_size) {
+        if (dev.rx[pos] != SL_LIDAR_CMD_SYNC_BYTE) { ++pos; continue; }
+        if (dev.rx_size - pos < 2) break;
+        sl_u8 cmd = dev.rx[pos + 1];
+        if (!(cmd & SL_LIDAR_CMDFLAG_HAS_PAYLOAD)) {
+            simHandleCommand(dev, cmd, NULL, 0);
+            pos += 2;
+            continue;
+        }
+        if (dev.rx_size - pos < 3) break;
+        size_t size = dev.rx[pos + 2];
+        if (dev.rx_size - pos < 4 + size) break;
+        simHandleCommand(dev, cmd, dev.rx + pos + 3, size);
+        pos += 4 + size;
+    }
+    memmove(dev.rx, dev.rx + pos, dev.rx_size - pos);
+    dev.rx_size -= pos;
+}
+
+static void simSendCapsule(SimDevice& dev, int devIndex, SharedClock* clock)
+{
+    sl_lidar_response_dense_capsule_measurement_nodes_t capsule;
+    memset(&capsule, 0, sizeof(capsule));
+    sl_u16 angle_q6 = (sl_u16)((360 << 6) * dev.capsule_index / SIM_CAPSULES_PER_ROTATION);
+    capsule.start_angle_sync_q6 = angle_q6 | (dev.capsule_index ? 0 : SL_LIDAR_RESP_MEASUREMENT_EXP_SYNCBIT);
+    for (int pos = 0; pos < _countof(capsule.cabins); ++pos) {
+        capsule.cabins[pos].distance = (sl_u16)(1000 + pos);
+    }
+    sl_u8 checksum = 0;
+    for (size_t pos = 2; pos < sizeof(capsule); ++pos) {
+        checksum ^= ((sl_u8*)&capsule)[pos];
+    }
+    capsule.s_checksum_1 = (SL_LIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4) | (checksum & 0xF);
+    capsule.s_checksum_2 = (SL_LIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4) | (checksum >> 4);
+
+    if (!dev.capsule_index) clock->rotation_sent_us[devIndex].store(monotonicUs());
+    send(dev.conn_fd, &capsule, sizeof(capsule), MSG_NOSIGNAL | MSG_DONTWAIT);
+    dev.capsule_index = (dev.capsule_index + 1) % SIM_CAPSULES_PER_ROTATION;
+}
+
+// The simulator process: all the lidars from a single thread, so it costs the same whatever the capture mode
+static void runSimulator(std::vector<SimDevice>& devices, SharedClock* clock)
+{
+    const sl_u64 capsuleIntervalUs = 1000000 / (SIM_ROTATION_HZ * SIM_CAPSULES_PER_ROTATION);
+    std::vector<pollfd> fds(devices.size() * 2);
+    while (true) {
+        sl_u64 currentTs = monotonicUs();
+        sl_u64 nextTs = currentTs + 100000;
+        for (size_t pos = 0; pos < devices.size(); ++pos) {
+            SimDevice& dev = devices[pos];
+            while (dev.streaming && dev.next_capsule_us <= currentTs) {
+                simSendCapsule(dev, (int)pos, clock);
+                dev.next_capsule_us += capsuleIntervalUs;
+            }
+            if (dev.streaming) nextTs = std::min(nextTs, dev.next_capsule_us);
+
+            fds[pos * 2].fd = dev.listen_fd;
+            fds[pos * 2].events = POLLIN;
+            fds[pos * 2 + 1].fd = dev.conn_fd;
+            fds[pos * 2 + 1].events = POLLIN;
+        }
+
+        int timeoutMs = (int)((nextTs - currentTs + 999) / 1000);
+        if (poll(&fds[0], fds.size(), timeoutMs) < 0 && errno != EINTR) return;
+
+        for (size_t pos = 0; pos < devices.size(); ++pos) {
+            SimDevice& dev = devices[pos];
+            if (fds[pos * 2].revents & POLLIN) {
+                int fd = accept(dev.listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    if (dev.conn_fd >= 0) close(dev.conn_fd);
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    dev.conn_fd = fd;
+                    dev.streaming = false;
+                    dev.rx_size = 0;
+                }
+            }
+            if (dev.conn_fd >= 0 && (fds[pos * 2 + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                ssize_t size = recv(dev.conn_fd, dev.rx + dev.rx_size, sizeof(dev.rx) - dev.rx_size, MSG_DONTWAIT);
+                if (size <= 0) {
+                    close(dev.conn_fd);
+                    dev.conn_fd = -1;
+                    dev.streaming = false;
+                    continue;
+                }
+                dev.rx_size += size;
+                simParse(dev);
+                if (dev.rx_size == sizeof(dev.rx)) dev.rx_size = 0;
+            }
+        }
+    }
+}
+
+static int threadCount()
+{
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return 0;
+    char line[256];
+    int count = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "Threads: %d", &count) == 1) break;
+    }
+    fclose(file);
+    return count;
+}
+
+static double cpuMs(const rusage& usage)
+{
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+struct BenchResult
+{
+    int     threads;
+    double  cpu_ms;
+    long    context_switches;
+    size_t  scans;
+    size_t  expected_scans;
+    double  latency_p50_us;
+    double  latency_p99_us;
+    double  latency_max_us;
+};
+
+// Capture from all the simulated lidars for the given time, from a reactor or from the thread of each driver
+static bool runBench(const std::vector<int>& ports, ILidarReactor* reactor, int seconds, SharedClock* clock, BenchResult& result)
+{
+    std::vector<IChannel*> channels;
+    std::vector<ILidarDriver*> drivers;
+    bool ok = true;
+    for (size_t pos = 0; pos < ports.size() && ok; ++pos) {
+        IChannel* channel = *createTcpChannel("127.0.0.1", ports[pos]);
+        ILidarDriver* drv = *createLidarDriver();
+        channels.push_back(channel);
+        drivers.push_back(drv);
+        if (reactor) drv->setCaptureReactor(reactor);
+        ok = SL_IS_OK(drv->connect(channel)) && SL_IS_OK(drv->startScan(false, true));
+        if (!ok) fprintf(stderr, "Error, cannot start the scan of the simulated lidar %d.\n", (int)pos);
+    }
+
+    if (ok) {
+        // let the scans settle, the first rotation of each lidar is incomplete
+        usleep(500000);
+
+        // the scans are grabbed by this thread once the ready handle of their driver is readable
+        static sl_lidar_response_measurement_node_hq_t nodes[8192];
+        std::vector<double> latencies;
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        for (size_t pos = 0; pos < drivers.size(); ++pos) {
+            int handle;
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = pos;
+            if (SL_IS_FAIL(drivers[pos]->getScanReadyHandle(handle)) || epoll_ctl(epollFd, EPOLL_CTL_ADD, handle, &ev) != 0) {
+                fprintf(stderr, "Error, cannot poll the scans of the simulated lidar %d.\n", (int)pos);
+                ok = false;
+            }
+            LidarScanHeader header;
+            size_t count = _countof(nodes);
+            drivers[pos]->tryGrabScanDataHq(header, nodes, count);
+        }
+
+        result.threads = threadCount();
+        rusage startUsage, endUsage;
+        getrusage(RUSAGE_SELF, &startUsage);
+        sl_u64 endTs = monotonicUs() + seconds * 1000000ULL;
+        sl_u64 currentTs;
+        while (ok && (currentTs = monotonicUs()) < endTs) {
+            epoll_event events[64];
+            int eventCount = epoll_wait(epollFd, events, _countof(events), (int)((endTs - currentTs) / 1000) + 1);
+            for (int pos = 0; pos < eventCount; ++pos) {
+                size_t index = (size_t)events[pos].data.u64;
+                LidarScanHeader header;
+                size_t count = _countof(nodes);
+                if (SL_IS_FAIL(drivers[index]->tryGrabScanDataHq(header, nodes, count))) continue;
+                sl_u64 receivedTs = monotonicUs();
+                sl_u64 sentTs = clock->rotation_sent_us[index].load();
+                if (receivedTs >= sentTs) latencies.push_back((double)(receivedTs - sentTs));
+            }
+        }
+        close(epollFd);
+        getrusage(RUSAGE_SELF, &endUsage);
+
+        result.cpu_ms = cpuMs(endUsage) - cpuMs(startUsage);
+        result.context_switches = (endUsage.ru_nvcsw + endUsage.ru_nivcsw) - (startUsage.ru_nvcsw + startUsage.ru_nivcsw);
+        result.scans = latencies.size();
+        result.expected_scans = drivers.size() * seconds * SIM_ROTATION_HZ;
+        std::sort(latencies.begin(), latencies.end());
+        result.latency_p50_us = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+        result.latency_p99_us = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+        result.latency_max_us = latencies.empty() ? 0 : latencies.back();
+    }
+
+    for (size_t pos = 0; pos < drivers.size(); ++pos) {
+        drivers[pos]->stop();
+        drivers[pos]->disconnect();
+        delete drivers[pos];
+        delete channels[pos];
+    }
+    return ok;
+}
+
+static void printResult(const char* mode, const BenchResult& result)
+{
+    printf("%-8s %8d %10.1f %10ld %7zu/%-7zu %10.0f %10.0f %10.0f\n", mode, result.threads, result.cpu_ms, result.context_switches,
+        result.scans, result.expected_scans, result.latency_p50_us, result.latency_p99_us, result.latency_max_us);
+}
+
+int main(int argc, const char * argv[]) {
+    int deviceCount = 16;
+    int reactorThreads = 1;
+    int seconds = 5;
+    bool runThread = true;
+    bool runReactor = true;
+
+    printf("Reactor benchmark for SLAMTEC LIDAR, thread-per-driver against a shared reactor.\n"
+           "Version: %s\n", SL_LIDAR_SDK_VERSION);
+
+    for (int pos = 1; pos < argc; ++pos) {
+        if (strcmp(argv[pos], "--devices") == 0 && pos + 1 < argc) {
+            deviceCount = atoi(argv[++pos]);
+        } else if (strcmp(argv[pos], "--threads") == 0 && pos + 1 < argc) {
+            reactorThreads = atoi(argv[++pos]);
+        } else if (strcmp(argv[pos], "--seconds") == 0 && pos + 1 < argc) {
+            seconds = atoi(argv[++pos]);
+        } else if (strcmp(argv[pos], "--mode") == 0 && pos + 1 < argc) {
+            ++pos;
+            runThread = (strcmp(argv[pos], "thread") == 0);
+            runReactor = (strcmp(argv[pos], "reactor") == 0);
+        } else {
+            print_usage(argc, argv);
+            return -1;
+        }
+    }
+    if (deviceCount <= 0 || reactorThreads <= 0 || seconds <= 0 || (!runThread && !runReactor)) {
+        print_usage(argc, argv);
+        return -1;
+    }
+
+    // the listening sockets are shared with the simulator process, their ports are known before it starts
+    std::vector<SimDevice> devices(deviceCount);
+    std::vector<int> ports;
+    for (int pos = 0; pos < deviceCount; ++pos) {
+        SimDevice& dev = devices[pos];
+        memset(&dev, 0, sizeof(dev));
+        dev.conn_fd = -1;
+        dev.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen = sizeof(addr);
+        if (dev.listen_fd < 0 || bind(dev.listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(dev.listen_fd, 1) != 0
+            || getsockname(dev.listen_fd, (sockaddr*)&addr, &addrLen) != 0) {
+            fprintf(stderr, "Error, cannot listen for the simulated lidar %d.\n", pos);
+            return -1;
+        }
+        ports.push_back(ntohs(addr.sin_port));
+    }
+
+    size_t clockSize = sizeof(SharedClock) + sizeof(std::atomic<sl_u64>) * deviceCount;
+    SharedClock* clock = (SharedClock*)mmap(NULL, clockSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (clock == MAP_FAILED) {
+        fprintf(stderr, "Error, cannot map the clock shared with the simulator.\n");
+        return -1;
+    }
+
+    pid_t simulator = fork();
+    if (simulator < 0) {
+        fprintf(stderr, "Error, cannot start the simulator.\n");
+        return -1;
+    }
+    if (simulator == 0) {
+        runSimulator(devices, clock);
+        _exit(0);
+    }
+    for (int pos = 0; pos < deviceCount; ++pos) {
+        close(devices[pos].listen_fd);
+    }
+
+    printf("%d simulated lidars over TCP, %d scans per second of %d samples each, %d s per mode\n\n",
+        deviceCount, SIM_ROTATION_HZ, SIM_CAPSULES_PER_ROTATION * 40, seconds);
+    printf("%-8s %8s %10s %10s %15s %10s %10s %10s\n", "mode", "threads", "cpu (ms)", "ctx sw", "scans", "p50 (us)", "p99 (us)", "max (us)");
+
+    int failed = 0;
+    BenchResult result;
+    if (runThread) {
+        if (runBench(ports, NULL, seconds, clock, result)) printResult("thread", result);
+        else ++failed;
+    }
+    if (runReactor) {
+        ILidarReactor* reactor = *createLidarReactor(reactorThreads);
+        if (!reactor) {
+            fprintf(stderr, "Error, the reactor is not supported on this platform.\n");
+            ++failed;
+        } else {
+            if (runBench(ports, reactor, seconds, clock, result)) {
+                printResult("reactor", result);
+                LidarReactorStats stats;
+                reactor->getStats(stats);
+                printf("\nreactor: %u threads, %llu wakeups, %llu steps, %llu on a deadline\n", stats.thread_count,
+                    (unsigned long long)stats.wakeups, (unsigned long long)stats.steps, (unsigned long long)stats.deadline_steps);
+            } else {
+                ++failed;
+            }
+            delete reactor;
+        }
+    }
+    printf("\nlatency: from the first capsule of a rotation sent by the simulator to the scan grabbed\n");
+
+    kill(simulator, SIGTERM);
+    waitpid(simulator, NULL, 0);
+    munmap(clock, clockSize);
+    return failed ? 1 : 0;
+}
@@ -192,24 +192,25 @@ int main(int argc, const char * argv[]) {
             }
         }
         else{
-            size_t baudRateArraySize = (sizeof(baudrateArray))/ (sizeof(baudrateArray[0]));
-			for(size_t i = 0; i < baudRateArraySize; ++i)
-			{
-				_channel = (*createSerialPortChannel(opt_channel_param_first, baudrateArray[i]));
+            // short device info probes on each candidate baudrate, instead of a full connect for each of them
+            std::vector<std::string> devices(1, opt_channel_param_first);
+            std::vector<sl_u32> baudrates(baudrateArray, baudrateArray + _countof(baudrateArray));
+            std::vector<LidarProbeResult> found;
+            if (SL_IS_OK(probeSerialLidars(devices, baudrates, found))) {
+                _channel = (*createSerialPortChannel(opt_channel_param_first, found[0].baudrate));
                 if (SL_IS_OK((drv)->connect(_channel))) {
                     op_result = drv->getDeviceInfo(devinfo);
 
                     if (SL_IS_OK(op_result)) 
                     {
 	                    connectSuccess = true;
-                        break;
                     }
                     else{
                         delete drv;
 					    drv = NULL;
                     }
                 }
-			}
+            }
         }
     }
     else if(opt_channel_type == CHANNEL_TYPE_UDP){
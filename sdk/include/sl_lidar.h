@@ -39,4 +39,6 @@
 #define SL_LIDAR_SDK_VERSION_MINOR  0
 #define SL_LIDAR_SDK_VERSION_PATCH  0
 #define SL_LIDAR_SDK_VERSION_SEQ    ((SL_LIDAR_SDK_VERSION_MAJOR << 16) | (SL_LIDAR_SDK_VERSION_MINOR << 8) | SL_LIDAR_SDK_VERSION_PATCH)
-#define SL_LIDAR_SDK_VERSION        (#SL_LIDAR_SDK_VERSION_MAJOR "." #SL_LIDAR_SDK_VERSION_MINOR "." #SL_LIDAR_SDK_VERSION_PATCH)
+#define SL_LIDAR_SDK_STRINGIFY_(x)  #x
+#define SL_LIDAR_SDK_STRINGIFY(x)   SL_LIDAR_SDK_STRINGIFY_(x)
+#define SL_LIDAR_SDK_VERSION        (SL_LIDAR_SDK_STRINGIFY(SL_LIDAR_SDK_VERSION_MAJOR) "." SL_LIDAR_SDK_STRINGIFY(SL_LIDAR_SDK_VERSION_MINOR) "." SL_LIDAR_SDK_STRINGIFY(SL_LIDAR_SDK_VERSION_PATCH))
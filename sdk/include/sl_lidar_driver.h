@@ -88,6 +88,161 @@ namespace sl {
         char    scan_mode[64];
     };
 
+    /**
+    * Angular sector of a scan, published as soon as the sector is complete
+    */
+    struct LidarScanSector
+    {
+        // Sequence number of the sector, increases by one for every published sector
+        sl_u32  sequence;
+
+        // Index of the sector inside one rotation
+        sl_u16  index;
+
+        // Start angle of the sector (in degrees)
+        float   start_angle;
+
+        // End angle of the sector (in degrees)
+        float   end_angle;
+    };
+
+    /**
+    * Metadata of a published 360 degree scan
+    */
+    struct LidarScanHeader
+    {
+        // Sequence number of the scan, increases by one for every published scan
+        sl_u32  sequence;
+
+        // Host timestamps (in microseconds, monotonic clock) at which the capsules holding the first and the last node of the scan arrived,
+        // see IChannel::readWithTimestamp. For the channels which do not record it, the time the nodes were decoded.
+        sl_u64  first_timestamp_us;
+        sl_u64  last_timestamp_us;
+
+        // Rotation frequency (in Hz) measured between the start of this scan and the start of the next one
+        float   measured_frequency;
+
+        // Ratio of the nodes carrying a valid distance
+        float   valid_ratio;
+
+        // Mean quality of the valid nodes
+        float   mean_quality;
+
+        // Count of capsules rejected by checksum since the previous published scan
+        sl_u32  checksum_errors;
+
+        // Count of nodes dropped since the previous published scan (scan buffer overflow)
+        sl_u32  dropped_nodes;
+
+        // Duration of the link outage recovered just before this scan (in milliseconds), 0 if the stream was not interrupted
+        // See setAutoReconnect
+        sl_u32  link_downtime_ms;
+    };
+
+    /**
+    * Performance counters of a communication channel, all values are cumulative since the channel creation
+    */
+    struct ChannelStats
+    {
+        sl_u64  bytes_read;
+        sl_u64  bytes_written;
+
+        // Count of read system calls, the reads served from the io_uring buffers make none and are not counted
+        sl_u64  read_calls;
+
+        // Count of wait (select/poll) system calls, and of those which expired without enough data
+        sl_u64  wait_calls;
+        sl_u64  wait_timeouts;
+
+        // UDP only: datagrams received, datagrams longer than the receive buffer of the channel (their tail is lost),
+        // and datagrams dropped by the socket because its receive buffer was full (Linux only, counted on the next datagram received)
+        sl_u64  datagrams_received;
+        sl_u64  datagrams_truncated;
+        sl_u64  datagrams_dropped;
+
+        // TCP only: reads served from the read-ahead buffer of the channel without a system call,
+        // and connections closed or reset by the peer
+        sl_u64  buffered_reads;
+        sl_u64  peer_disconnects;
+    };
+
+    /**
+    * Performance counters of the lidar driver, all values are cumulative since the driver creation
+    */
+    struct LidarDriverStats
+    {
+        enum
+        {
+            DECODE_TIME_BUCKETS = 12,
+        };
+
+        sl_u64  capsules_decoded;
+
+        // Capsules rejected by checksum or CRC
+        sl_u64  checksum_errors;
+
+        // Frame synchronization losses
+        sl_u64  resyncs;
+
+        // Capture waits expired without a complete capsule
+        sl_u64  timeouts;
+
+        sl_u64  scans_published;
+
+        // Published scans overwritten before being grabbed
+        sl_u64  scans_dropped;
+
+        // Contended lock acquisitions by the capture thread and the time spent waiting for them (in microseconds)
+        sl_u64  lock_contentions;
+        sl_u64  lock_wait_us;
+
+        // Histogram of the decode and publication time of one capsule (in microseconds)
+        // decode_time_bucket[n] counts the samples taking up to (1 << n) us, the last bucket counts everything longer
+        sl_u64  decode_time_sum_us;
+        sl_u64  decode_time_bucket[DECODE_TIME_BUCKETS];
+    };
+
+    enum LidarSafetyZoneType
+    {
+        SafetyZoneSector = 0,
+        SafetyZonePolygon = 1,
+    };
+
+    /**
+    * Protective field evaluated by the driver on every decoded capsule
+    * Angles follow the lidar convention (degrees, 0 at the front, clockwise).
+    * Polygon vertices are given in millimeters in the lidar frame: the x axis points to 0 degree and the y axis to 90 degree.
+    */
+    struct LidarSafetyZone
+    {
+        enum
+        {
+            MAX_VERTICES = 16,
+        };
+
+        // SafetyZoneSector or SafetyZonePolygon
+        sl_u32  type;
+
+        // Sector zone: angular range [start_angle, end_angle), wraps around 360 if start_angle > end_angle
+        float   start_angle;
+        float   end_angle;
+
+        // Sector zone: a measurement intrudes the zone if its distance (in millimeters) lies in [min_distance, max_distance)
+        float   min_distance;
+        float   max_distance;
+
+        // Polygon zone: vertices of the polygon (in millimeters)
+        sl_u32  vertex_count;
+        float   vertex_x[MAX_VERTICES];
+        float   vertex_y[MAX_VERTICES];
+
+        // Count of consecutive intruding measurements inside the zone required to raise the intrusion
+        sl_u16  trigger_count;
+
+        // Count of consecutive rotations without any intruding measurement required to release the intrusion
+        sl_u16  release_count;
+    };
+
     template <typename T>
     struct Result
     {
@@ -159,6 +314,17 @@ namespace sl {
         */
         virtual bool waitForData(size_t size, sl_u32 timeoutInMs = -1, size_t* actualReady = nullptr) = 0;
 
+        /**
+        * Make the pending and the following waitForData calls return false immediately, until resumeWait is called
+        * Can be called from any thread. Channels without support keep waiting until the timeout expires.
+        */
+        virtual void cancelWait() {}
+
+        /**
+        * Allow waitForData to wait again after cancelWait
+        */
+        virtual void resumeWait() {}
+
         /**
         * Send data to remote endpoint
         * \param data The data buffer
@@ -175,6 +341,20 @@ namespace sl {
         */
         virtual int read(void* buffer, size_t size) = 0;
 
+        /**
+        * Read data from the channel, along with the time the data arrived
+        * The built-in channels take the time from the kernel for UDP, and when the bytes reached the host for TCP and serial ports.
+        * \param buffer The buffer to receive data
+        * \param size The size of the read buffer
+        * \param timestampUs [out] Host time (in microseconds, monotonic clock) the first returned byte arrived, 0 if the channel does not record it
+        * \return Bytes read (negative for read failure)
+        */
+        virtual int readWithTimestamp(void* buffer, size_t size, sl_u64* timestampUs)
+        {
+            if (timestampUs) *timestampUs = 0;
+            return read(buffer, size);
+        }
+
         /**
         * Clear read cache
         */
@@ -182,6 +362,18 @@ namespace sl {
 
         virtual int getChannelType() = 0;
 
+        /**
+        * Get the performance counters of the channel, the counters can be read at any time without blocking the I/O
+        */
+        virtual sl_result getStats(ChannelStats& stats) { return SL_RESULT_OPERATION_NOT_SUPPORT; }
+
+        /**
+        * Descriptor which becomes readable when data arrives, for the event loops servicing the channel (see ILidarReactor)
+        * The data already buffered by the channel does not make it readable again, waitForData with a zero timeout tells about it.
+        * \return The descriptor, -1 if the channel has none
+        */
+        virtual int getPollHandle() { return -1; }
+
     private:
 
     };
@@ -196,6 +388,42 @@ namespace sl {
 
     public:
         virtual void setDTR(bool dtr) = 0;
+
+        /**
+        * Change the baudrate of the port, the new baudrate is used from the next open
+        * \return false if the channel does not support it
+        */
+        virtual bool setBaudRate(sl_u32 baudrate) { return false; }
+
+        /**
+        * Baudrate used by the port, 0 if unknown
+        */
+        virtual sl_u32 getBaudRate() { return 0; }
+    };
+
+    /**
+    * Options of a serial channel, see createSerialPortChannel
+    */
+    enum SerialPortFlag
+    {
+        // Linux only, ignored elsewhere: the port is switched to ASYNC_LOW_LATENCY, the latency timer of FTDI style USB adapters
+        // is lowered to 1 ms when writable, and the waits wake up on each arrival of data instead of sleeping for the time the
+        // missing bytes should take at the baudrate. Lowers the receive latency and its jitter at the cost of more wake-ups.
+        SERIAL_PORT_FLAG_LOW_LATENCY = 0x1,
+
+        // Linux 6.7 and later, ignored elsewhere: a multishot read stays outstanding on the port through io_uring, the waits
+        // cost a single system call and the reads none. Falls back to the regular receive path when the kernel lacks support.
+        SERIAL_PORT_FLAG_IO_URING = 0x2,
+    };
+
+    /**
+    * Flags of the TCP and UDP channels
+    */
+    enum NetworkChannelFlag
+    {
+        // Linux 6.0 and later, ignored elsewhere: a multishot receive stays outstanding on the socket through io_uring, the waits
+        // cost a single system call and the receives none. Falls back to the regular receive path when the kernel lacks support.
+        NETWORK_CHANNEL_FLAG_IO_URING = 0x1,
     };
 
     /**
@@ -205,22 +433,30 @@ namespace sl {
     *                   on Unix-Like OS, it may be /dev/ttyS1, /dev/ttyUSB2, etc
     * \param baudrate Baudrate
     *                   Please refer to the datasheet for the baudrate (maybe 115200 or 256000)
+    * \param flags Combination of SerialPortFlag
     */
-    Result<IChannel*> createSerialPortChannel(const std::string& device, int baudrate);
+    Result<IChannel*> createSerialPortChannel(const std::string& device, int baudrate, sl_u32 flags = 0);
 
     /**
     * Create a TCP channel
+    * The channel reads ahead into its own buffer with large receives, and serves the byte stream reads from it.
     * \param ip IP address of the device
     * \param port TCP port
+    * \param receiveBufferSize Size of the socket receive buffer (SO_RCVBUF) in bytes, 0 to keep the system default
+    * \param flags Combination of NetworkChannelFlag
     */
-    Result<IChannel*> createTcpChannel(const std::string& ip, int port);
+    Result<IChannel*> createTcpChannel(const std::string& ip, int port, size_t receiveBufferSize = 0, sl_u32 flags = 0);
 
     /**
     * Create a UDP channel
+    * The channel receives whole datagrams, in batches, and serves the byte stream reads from them.
     * \param ip IP address of the device
     * \param port UDP port
+    * \param receiveBufferSize Size of the socket receive buffer (SO_RCVBUF) in bytes, 0 to keep the system default
+    *                   A larger buffer rides out longer stalls of the capture thread, see ChannelStats::datagrams_dropped
+    * \param flags Combination of NetworkChannelFlag
     */
-    Result<IChannel*> createUdpChannel(const std::string& ip, int port);
+    Result<IChannel*> createUdpChannel(const std::string& ip, int port, size_t receiveBufferSize = 0, sl_u32 flags = 0);
 
     enum MotorCtrlSupport
     {
@@ -236,6 +472,84 @@ namespace sl {
     };
 
         /**
+    * Receiver of the events detected by the capture thread
+    * The callbacks are invoked from the capture thread, or from a thread of the reactor set by setCaptureReactor.
+    * Keep them short as no data is decoded meanwhile.
+    * A callback may call setEventListener, but must not call stop(), the startScan family, setCaptureReactor or the other
+    * methods controlling the capture: they wait for the very thread running the callback. Hand such requests over to
+    * another thread instead.
+    */
+    class ILidarEventListener
+    {
+    public:
+        virtual ~ILidarEventListener() {}
+
+        /// Invoked when the intrusion state of one or more safety zones changes
+        ///
+        /// \param intrudedMask   Bit mask of the safety zones currently intruded (bit n for zone id n)
+        ///
+        /// \param changedMask    Bit mask of the safety zones whose state has just changed
+        virtual void onSafetyZoneStateChanged(sl_u32 intrudedMask, sl_u32 changedMask) {}
+
+        /// Invoked when no capsule has been received for longer than the stall timeout (see setStallDetection)
+        ///
+        /// \param gapMs          Time elapsed since the last capsule (in milliseconds)
+        virtual void onStreamStalled(sl_u32 gapMs) {}
+
+        /// Invoked when capsules are received again after a stall
+        ///
+        /// \param gapMs          Duration of the interruption (in milliseconds)
+        virtual void onStreamResumed(sl_u32 gapMs) {}
+
+        /// Invoked when the link supervision detects the loss of the link (see setAutoReconnect)
+        virtual void onLinkLost() {}
+
+        /// Invoked when the link supervision has reopened the channel and restarted the scan
+        ///
+        /// \param downtimeMs     Duration of the outage (in milliseconds)
+        virtual void onLinkRestored(sl_u32 downtimeMs) {}
+    };
+
+    /**
+    * State of the stall watchdog of the measurement stream
+    */
+    struct LidarWatchdogState
+    {
+        // Stalls are only detected once the first capsule of the scan has been received
+        bool    armed;
+        bool    stalled;
+
+        // Expected interval between two capsules, derived from the sample duration of the scan mode (in microseconds)
+        sl_u32  expected_interval_us;
+
+        // No capsule for this long is reported as a stall (in milliseconds)
+        sl_u32  stall_timeout_ms;
+
+        // Stalls detected since the driver creation, and the longest gap between two capsules (in milliseconds)
+        sl_u64  stall_count;
+        sl_u32  longest_gap_ms;
+    };
+
+    /**
+    * Outcome of negotiateBestSerialBaudRate
+    */
+    struct LidarBaudRateNegotiation
+    {
+        // Baudrate settled on, the channel and the lidar use it on return
+        sl_u32  baudrate;
+
+        // Baudrate measured by the lidar and its error from the requested one (in percent), 0 if it was not renegotiated
+        sl_u32  detected_bps;
+        float   bps_error;
+
+        // Fraction of the capsules lost to checksum errors and resyncs during the scan burst at this baudrate
+        float   loss_rate;
+
+        // The baudrate recorded by a previous negotiation with this device was reused, without climbing through the candidates
+        bool    from_record;
+    };
+
+    /**
     * Lidar motor info
     */
     struct LidarMotorInfo
@@ -252,6 +566,93 @@ namespace sl {
         sl_u16 min_speed;
     };
 
+    /**
+    * One request of a ILidarDriver::getLidarConfBatch call
+    */
+    struct LidarConfQuery
+    {
+        enum {
+            // the longest known answer is the scan mode name, see LidarScanMode::scan_mode
+            MAX_ANSWER_SIZE = 64,
+        };
+
+        sl_u32              type;       // SL_LIDAR_CONF_xxx
+        sl_u16              param;      // scan mode id of the per-mode configurations
+        sl_result           result;
+        size_t              answer_size;
+        sl_u8               answer[MAX_ANSWER_SIZE];
+
+        LidarConfQuery(sl_u32 confType = 0, sl_u16 confParam = 0)
+            : type(confType), param(confParam), result(SL_RESULT_OPERATION_TIMEOUT), answer_size(0)
+        {}
+    };
+
+    enum LidarHealthSource
+    {
+        // No health information is available yet
+        HealthSourceNone = 0,
+        // Answer of an explicit GET_HEALTH request
+        HealthSourceQuery = 1,
+        // Derived from the measurement stream while scanning
+        HealthSourceStream = 2,
+    };
+
+    /**
+    * Last known health and status of the lidar, gathered without sending any request
+    * The ages are in milliseconds relative to the getHealthStatus call.
+    */
+    struct LidarHealthStatus
+    {
+        // Best health estimate currently available and where it comes from
+        sl_lidar_response_device_health_t health;
+        LidarHealthSource health_source;
+        sl_u32  health_age_ms;
+
+        // Answer of the last GET_HEALTH request of this connection
+        bool    query_valid;
+        sl_lidar_response_device_health_t query_health;
+        sl_u32  query_age_ms;
+
+        // Device status word carried by every Ultra Dense capsule
+        bool    dev_status_valid;
+        sl_u16  dev_status;
+        sl_u32  dev_status_age_ms;
+
+        // Measurement stream liveness, last_capsule_age_ms is only meaningful once a capsule has been decoded
+        bool    is_scanning;
+        bool    capsule_received;
+        sl_u32  last_capsule_age_ms;
+    };
+
+    /**
+    * Counters of a reactor, see ILidarReactor::getStats
+    */
+    struct LidarReactorStats
+    {
+        sl_u32  thread_count;
+        sl_u32  capture_count;      // scans currently serviced by the reactor
+        sl_u64  wakeups;            // returns from the readiness waits, all threads together
+        sl_u64  steps;              // captures serviced, on readiness or deadline
+        sl_u64  deadline_steps;     // captures serviced because no data arrived before their deadline
+    };
+
+    /**
+    * Event loop servicing the capture of many lidars from a few threads, see createLidarReactor
+    * Instead of a capture thread per driver blocking on its channel, each reactor thread waits for the readiness of the
+    * channels of many drivers at once, frames and decodes their capsules as they arrive and publishes the scans to the
+    * grab interfaces of each driver. The event listener callbacks of these drivers are invoked from the reactor threads.
+    */
+    class ILidarReactor
+    {
+    public:
+        virtual ~ILidarReactor() {}
+
+        /**
+        * Get the counters of the reactor, they can be read at any time
+        */
+        virtual sl_result getStats(LidarReactorStats& stats) = 0;
+    };
+
     class ILidarDriver
     {
     public:
@@ -278,7 +679,8 @@ namespace sl {
     public:
         enum
         {
-            DEFAULT_TIMEOUT = 2000
+            DEFAULT_TIMEOUT = 2000,
+            MAX_SAFETY_ZONES = 8,
         };
 
     public:
@@ -312,6 +714,9 @@ namespace sl {
 
         /// Retrieve the health status of the RPLIDAR
         /// The host system can use this operation to check whether RPLIDAR is in the self-protection mode.
+        /// While scanning, no request is sent unless scan interruption is allowed (see setScanInterruptionAllowed):
+        /// the last known health is returned instead, as described by getHealthStatus, and SL_RESULT_OPERATION_NOT_SUPPORT
+        /// is returned if none is available yet.
         ///
         /// \param health        The health status info returned from the RPLIDAR
         ///
@@ -319,13 +724,15 @@ namespace sl {
         virtual sl_result getHealth(sl_lidar_response_device_health_t& health, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
 
         /// Get the device information of the RPLIDAR include the serial number, firmware version, device model etc.
+        /// Note: the answer is cached per connection, see checkMotorCtrlSupport for the behavior while scanning.
         /// 
         /// \param info          The device information returned from the RPLIDAR
         /// \param timeout       The operation timeout value (in millisecond) for the serial port communication  
         virtual sl_result getDeviceInfo(sl_lidar_response_device_info_t& info, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
 
         /// Check whether the device support motor control
-        /// Note: this API will disable grab.
+        /// Note: the answer is cached per connection, a request is only needed before it is known and then stops the scan
+        /// if scan interruption is allowed (see setScanInterruptionAllowed). SL_RESULT_OPERATION_NOT_SUPPORT is returned otherwise.
         /// 
         /// \param motorCtrlSupport Return the result.
         /// \param timeout          The operation timeout value (in millisecond) for the serial port communication. 
@@ -334,6 +741,7 @@ namespace sl {
         /// Calculate LIDAR's current scanning frequency from the given scan data
         /// Please refer to the application note doc for details
         /// Remark: the calcuation will be incorrect if the specified scan data doesn't contains enough data
+        /// Remark: this is the nominal frequency derived from the sample duration, the measured one is available in LidarScanHeader (see grabScanDataHqWithHeader)
         ///
         /// \param scanMode      Lidar's current scan mode
         /// \param nodes         Current scan's measurements
@@ -381,6 +789,21 @@ namespace sl {
         /// \The caller application can set the timeout value to Zero(0) to make this interface always returns immediately to achieve non-block operation.
         virtual sl_result grabScanDataHq(sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+        /// Wait and grab a complete 0-360 degree scan data together with its header
+        /// Same as grabScanDataHq, the header carries the sequence number, timestamps, measured rotation frequency and statistics of the scan.
+        ///
+        /// \param header        The header of the grabbed scan
+        ///
+        /// \param nodebuffer     Buffer provided by the caller application to store the scan data
+        ///
+        /// \param count          The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_hq_t).
+        ///                       Once the interface returns, this parameter will store the actual received data count.
+        ///
+        /// \param timeout        Max duration allowed to wait for a complete scan data
+        ///
+        /// The interface will return SL_RESULT_OPERATION_TIMEOUT to indicate that no complete 0-360 degree scan can be retrieved withing the given timeout duration.
+        virtual sl_result grabScanDataHqWithHeader(LidarScanHeader& header, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
+
         /// Ascending the scan data according to the angle value in the scan.
         ///
         /// \param nodebuffer     Buffer provided by the caller application to do the reorder. Should be retrived from the grabScanData
@@ -398,18 +821,201 @@ namespace sl {
         ///
         /// The interface will return SL_RESULT_OPERATION_TIMEOUT to indicate that not even a single node can be retrieved since last call. 
         virtual sl_result getScanDataWithIntervalHq(sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count) = 0;
+
+        /// Enable or disable the sector publish mode
+        /// In sector publish mode the scan is also published as fixed angular sectors (aligned to 0 degree),
+        /// each sector is available as soon as its last measurement is decoded instead of waiting for a full rotation.
+        ///
+        /// \param sectorSpan     Angular span of each sector (in degrees, up to 180). Use 0 to disable the sector publish mode.
+        virtual sl_result setSectorPublishMode(float sectorSpan) = 0;
+
+        /// Wait and grab the latest complete angular sector
+        /// Sectors which are not grabbed in time are overwritten by the newer ones, use the sequence number to detect them.
+        ///
+        /// \param sector         The sequence number and angular span of the grabbed sector
+        ///
+        /// \param nodebuffer     Buffer provided by the caller application to store the sector data
+        ///
+        /// \param count          The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_hq_t).
+        ///                       Once the interface returns, this parameter will store the actual received data count.
+        ///
+        /// \param timeout        Max duration allowed to wait for a complete sector
+        ///
+        /// The interface will return SL_RESULT_OPERATION_TIMEOUT to indicate that no complete sector can be retrieved withing the given timeout duration.
+        virtual sl_result grabScanSectorHq(LidarScanSector& sector, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+        /// Get a descriptor to poll from the event loop of the application instead of waiting in the grab functions
+        /// The descriptor is readable while a complete scan or sector waits to be grabbed, grab them with tryGrabScanDataHq
+        /// and tryGrabScanSectorHq. It belongs to the driver and stays valid until the driver is deleted, do not close it.
+        ///
+        /// \param handle        The descriptor, an eventfd on Linux and the read end of a pipe on the other POSIX systems
+        ///
+        /// The interface will return SL_RESULT_OPERATION_NOT_SUPPORT on Windows.
+        virtual sl_result getScanReadyHandle(int& handle) = 0;
+
+        /// Grab the complete 0-360 degree scan waiting to be grabbed together with its header, without waiting for it
+        ///
+        /// \param header        The header of the grabbed scan
+        ///
+        /// \param nodebuffer    Buffer provided by the caller application to store the scan data
+        ///
+        /// \param count         The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_hq_t).
+        ///                      Once the interface returns, this parameter will store the actual received data count.
+        ///
+        /// The interface will return SL_RESULT_OPERATION_TIMEOUT if no new scan is available.
+        virtual sl_result tryGrabScanDataHq(LidarScanHeader& header, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count) = 0;
+
+        /// Grab the latest complete angular sector, without waiting for it, see grabScanSectorHq
+        ///
+        /// The interface will return SL_RESULT_OPERATION_TIMEOUT if no new sector is available.
+        virtual sl_result tryGrabScanSectorHq(LidarScanSector& sector, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count) = 0;
+
+        /// Enable or disable the predictive decoding of the capsuled scan formats (Express/Boost/Dense modes)
+        /// These formats only carry the start angle of each capsule, so the nodes of a capsule are normally decoded once the next capsule arrives.
+        /// In predictive mode each capsule is decoded as soon as it is received, its angular span is extrapolated from the previous capsules.
+        /// This removes one capsule of latency at the cost of a small angle error while the rotation speed changes.
+        /// The error of each estimate is made up by the next capsule, which starts where the estimate ended, so no gap nor overlap is left.
+        /// The setting takes effect at the next scan start, the HQ and Ultra capsule formats are not affected.
+        ///
+        /// \param enable        true to enable the predictive decoding, false to restore the default interpolating decoding
+        virtual sl_result setPredictiveCapsuleDecode(bool enable) = 0;
+
+        /// Enable the on-disk cache of the device profile (device info, scan modes, typical scan mode, motor limits and IP config)
+        /// The profile is stored in one file per device, named after its serial number, and is only reused when the firmware version
+        /// and the other device info fields still match. With a valid cache file, connect only needs a single getDeviceInfo round trip.
+        /// The cache is disabled by default, call this before connect to use it on the first connection.
+        /// What the driver learned is written once the scan has started, on disconnect and when the driver is released.
+        ///
+        /// \param cacheDir      An existing directory to store the profiles in, or NULL to disable the cache
+        virtual sl_result setDeviceProfileCache(const char* cacheDir) = 0;
+
+        /// Get the last known health and status of the lidar without sending any request, the scan is never interrupted
+        /// While scanning, the health is derived from the measurement stream: the Ultra Dense capsules carry a device status
+        /// word, a non zero one is reported as SL_LIDAR_STATUS_WARNING with the word as error code. With the other formats,
+        /// the answer of the last GET_HEALTH request is used, or an OK status as long as capsules keep arriving since the
+        /// lidar stops measuring in self-protection mode.
+        ///
+        /// \param status        The current health and status
+        virtual sl_result getHealthStatus(LidarHealthStatus& status) = 0;
+
+        /// Allow the requests expecting an answer (getHealth, getDeviceInfo, checkMotorCtrlSupport and the configuration requests)
+        /// to stop the scan, the scan is not restarted afterwards. Scan interruption is not allowed by default.
+        /// Requests without answer, such as setMotorSpeed, never interrupt the scan: they are written by the capture thread.
+        ///
+        /// \param allow         true to allow the active requests to stop the scan
+        virtual sl_result setScanInterruptionAllowed(bool allow) = 0;
+
+        /// Enable the supervision of the link while scanning
+        /// When the channel fails, or no capsule is received for linkLossTimeoutMs, the capture thread closes and reopens the
+        /// channel with an exponential backoff, checks that the same device answers, restores the motor speed and restarts
+        /// the scan mode in use. The grab interfaces keep working across the outage, without restarting the scan, and the
+        /// first scan published afterwards reports the outage in LidarScanHeader::link_downtime_ms. The scan ends if another
+        /// device answers on the channel or stop() is called. The supervision is disabled by default.
+        ///
+        /// \param enable             true to enable the supervision
+        ///
+        /// \param linkLossTimeoutMs  Time without capsule after which the link is considered lost (in milliseconds)
+        ///
+        /// \param maxBackoffMs       Upper bound of the delay between two reconnection attempts (in milliseconds)
+        virtual sl_result setAutoReconnect(bool enable, sl_u32 linkLossTimeoutMs = 500, sl_u32 maxBackoffMs = 2000) = 0;
+
+        /// Configure the stall watchdog of the measurement stream
+        /// The expected interval between two capsules is derived from the sample duration of the scan mode and the number
+        /// of samples per capsule. The stream is stalled when no capsule arrives within intervalMultiple times this interval,
+        /// but never before minTimeoutMs, to tolerate the latency of USB serial bridges. Stalls are reported through
+        /// onStreamStalled of the event listener and getWatchdogState, the scan keeps running and resumes by itself.
+        /// The default is 8 intervals and at least 20ms. The setting takes effect at the next scan start.
+        ///
+        /// \param intervalMultiple  Stall timeout in capsule intervals, 0 to use the fixed DEFAULT_TIMEOUT instead
+        ///
+        /// \param minTimeoutMs      Lower bound of the stall timeout (in milliseconds)
+        virtual sl_result setStallDetection(float intervalMultiple, sl_u32 minTimeoutMs) = 0;
+
+        /// Get the state of the stall watchdog, it can be read at any time without blocking the capture thread
+        ///
+        /// \param state         The current state
+        virtual sl_result getWatchdogState(LidarWatchdogState& state) = 0;
+
+        /// Get the performance counters of the driver, the counters can be read at any time without blocking the capture thread
+        ///
+        /// \param stats         The current counters
+        virtual sl_result getStats(LidarDriverStats& stats) = 0;
+
+        /// Get the performance counters of the driver and of its channel in the Prometheus text exposition format
+        ///
+        /// \param text          The formatted counters
+        virtual sl_result getStatsText(std::string& text) = 0;
+
+        /// Set the receiver of the events detected by the capture thread
+        ///
+        /// \param listener      The listener, or NULL to remove the current one. The caller keeps the ownership and must keep it alive while it is registered.
+        ///                      A callback already started when the listener is removed still completes, stop the scan before releasing the listener.
+        virtual sl_result setEventListener(ILidarEventListener* listener) = 0;
+
+        /// Capture the scans from a reactor shared with other drivers instead of the capture thread of this driver
+        /// The reactor frames and decodes the capsules as soon as the channel is readable. The grab interfaces, the event
+        /// listener, the stall watchdog and the link supervision work as with the capture thread, the reconnection itself
+        /// runs on the capture thread. A channel without poll handle (see IChannel::getPollHandle) keeps the capture thread.
+        /// The setting takes effect when a scan starts or resumes after a link loss. The reactor must outlive the scans it services.
+        ///
+        /// \param reactor       A reactor created by createLidarReactor, or NULL to capture from the thread of the driver
+        virtual sl_result setCaptureReactor(ILidarReactor* reactor) = 0;
+
+        /// Register or replace a safety zone
+        /// The zone is evaluated on every decoded capsule by the capture thread, intrusions are reported immediately
+        /// through the event listener and waitSafetyZoneStateChange, without waiting for the end of the rotation.
+        ///
+        /// \param zoneId        Id of the zone, from 0 to MAX_SAFETY_ZONES - 1
+        ///
+        /// \param zone          The zone definition
+        virtual sl_result setSafetyZone(int zoneId, const LidarSafetyZone& zone) = 0;
+
+        /// Remove a safety zone
+        ///
+        /// \param zoneId        Id of the zone, from 0 to MAX_SAFETY_ZONES - 1
+        virtual sl_result clearSafetyZone(int zoneId) = 0;
+
+        /// Get the current intrusion state of the safety zones
+        ///
+        /// \param intrudedMask  Bit mask of the safety zones currently intruded (bit n for zone id n)
+        virtual sl_result getSafetyZoneState(sl_u32& intrudedMask) = 0;
+
+        /// Wait for the intrusion state of the safety zones to change
+        ///
+        /// \param intrudedMask  Bit mask of the safety zones currently intruded (bit n for zone id n)
+        ///
+        /// \param timeout       Max duration allowed to wait for a state change
+        ///
+        /// The interface will return SL_RESULT_OPERATION_TIMEOUT if the state does not change within the given timeout duration.
+        virtual sl_result waitSafetyZoneStateChange(sl_u32& intrudedMask, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
+
         /// Set lidar motor speed
         /// The host system can use this operation to set lidar motor speed.
         ///
         /// \param speed        The speed value set to lidar
         ///
-        ///Note: The function will stop scan if speed is DEFAULT_MOTOR_SPEED.
+        ///Note: While scanning, the request is written by the capture thread between two capsules. With DEFAULT_MOTOR_SPEED the
+        ///      desired speed must already be known, it is queried when the scan starts.
         virtual sl_result setMotorSpeed(sl_u16 speed = DEFAULT_MOTOR_SPEED) = 0;
         
         /// Get the motor information of the RPLIDAR include the max speed, min speed, desired speed.
         /// 
         /// \param motorInfo          The motor information returned from the RPLIDAR
         virtual sl_result getMotorInfo(LidarMotorInfo &motorInfo, sl_u32 timeoutInMs = DEFAULT_TIMEOUT) = 0;
+
+        /// Query several configuration entries at once
+        /// The requests are written back-to-back and the answers are matched to them by their configuration type,
+        /// so the whole batch costs about one round trip instead of one per entry.
+        /// Firmwares which drop or reorder pipelined requests are detected, the driver then sends the missing requests
+        /// again and falls back to one request at a time for this connection.
+        ///
+        /// \param queries       The requests, the answer and the result of each one are filled on return
+        /// \param count         Number of requests
+        ///
+        /// A request answered with an error or not answered within the timeout keeps that error as its result, the others
+        /// are still answered. The interface returns SL_RESULT_OK if every request succeeded, the result of the first failed
+        /// one otherwise.
+        virtual sl_result getLidarConfBatch(LidarConfQuery* queries, size_t count, sl_u32 timeout = DEFAULT_TIMEOUT) = 0;
     
 
         /// Ask the LIDAR to use a new baudrate for serial communication
@@ -420,6 +1026,20 @@ namespace sl {
         /// \param requiredBaudRate   The new baudrate required to be used. It MUST matches with the baudrate of the binded channel.
         /// \param baudRateDetected   The actual baudrate detected by the LIDAR system
         virtual sl_result negotiateSerialBaudRate(sl_u32 requiredBaudRate, sl_u32* baudRateDetected = NULL) = 0;
+
+        /// Move the serial link to the fastest reliable baudrate
+        /// The candidates above the current baudrate of the channel are tried in increasing order. Each step negotiates the
+        /// baudrate, skips it if the bps error detected by the LIDAR exceeds 5%, then runs a short scan burst to measure the
+        /// fraction of capsules lost to checksum errors and resyncs. The climb stops at the first baudrate over the loss budget
+        /// and the link goes back to the last good one. Any scan in progress is stopped, the scan is not restarted.
+        /// With the device profile cache enabled (see setDeviceProfileCache), the outcome is recorded with the profile of the
+        /// device and the recorded baudrate is verified first on the next negotiation, which then skips the climb.
+        /// The channel must be a serial port channel supporting ISerialPortChannel::setBaudRate.
+        ///
+        /// \param candidates         Baudrates to try, e.g. 256000, 460800, 921600, 1000000
+        /// \param lossBudget         Highest acceptable fraction of lost capsules
+        /// \param result             Receives the baudrate settled on and its measurements
+        virtual sl_result negotiateBestSerialBaudRate(const std::vector<sl_u32>& candidates, float lossBudget = 0.001f, LidarBaudRateNegotiation* result = NULL) = 0;
 };
 
     /**
@@ -450,4 +1070,50 @@ namespace sl {
     * delete *channel;
     */
     Result<ILidarDriver*> createLidarDriver();
+
+    /**
+    * Create a reactor to service the capture of many drivers from a few threads, see ILidarDriver::setCaptureReactor
+    * Each thread polls the channels of the drivers assigned to it with epoll, the drivers go to the least loaded thread.
+    * Linux only, SL_RESULT_OPERATION_NOT_SUPPORT is returned elsewhere.
+    * \param threadCount Number of threads, one is enough for a dozen lidars, use up to one per core for several dozens
+    */
+    Result<ILidarReactor*> createLidarReactor(size_t threadCount = 1);
+
+    /**
+    * Lidar answering on a serial port, see probeSerialLidars
+    */
+    struct LidarProbeResult
+    {
+        std::string device;
+        sl_u32 baudrate;
+        sl_lidar_response_device_info_t devinfo;
+    };
+
+    /**
+    * Look for lidars on a set of serial ports
+    * Each port is probed by its own thread, all the ports at the same time. A port is probed with one short GET_DEVICE_INFO
+    * request per candidate baudrate, tried in the given order until one is answered, without the full bring-up done by connect.
+    * A lidar left scanning by a previous session is stopped first.
+    * The ports must not be opened elsewhere while they are probed.
+    * \param devices Serial port devices to probe, e.g. /dev/ttyUSB0, /dev/ttyUSB1
+    * \param baudrates Candidate baudrates, e.g. 115200, 256000, 1000000
+    * \param found Receives one entry per port with a lidar, in the order of devices
+    * \param timeoutInMs Time to wait for the answer of each request (in milliseconds)
+    * \return SL_RESULT_OK if at least one lidar answered, SL_RESULT_OPERATION_TIMEOUT otherwise
+    */
+    sl_result probeSerialLidars(const std::vector<std::string>& devices, const std::vector<sl_u32>& baudrates, std::vector<LidarProbeResult>& found, sl_u32 timeoutInMs = 100);
+
+    /**
+    * Dump the hot path trace recorded by every thread into a binary file
+    * Only available when the SDK is built with SL_LIDAR_ENABLE_TRACE (make TRACE=1), SL_RESULT_OPERATION_NOT_SUPPORT is returned otherwise
+    * \param path Path of the trace file
+    */
+    sl_result dumpTrace(const char* path);
+
+    /**
+    * Convert a trace file produced by dumpTrace into the Chrome trace event JSON format (chrome://tracing, Perfetto)
+    * \param tracePath Path of the trace file
+    * \param jsonPath Path of the JSON file to write
+    */
+    sl_result convertTraceToJson(const char* tracePath, const char* jsonPath);
 }
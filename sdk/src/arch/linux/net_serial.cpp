@@ -47,6 +47,9 @@
 #include "hal/types.h"
 #include "arch/linux/net_serial.h"
 #include <sys/select.h>
+#include <sys/epoll.h>
+#include <linux/serial.h>
+#include <limits.h>
 
 #include <algorithm>
 //__GNUC__
@@ -221,12 +224,93 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
             break;
 
     } while (0);
+
+    if ((flags & FLAG_LOW_LATENCY) && !_openLowLatency()) {
+        close();
+        return false;
+    }
+
+    // without kernel support, the port keeps the regular receive path
+    if (flags & FLAG_IO_URING) _openRing();
     
     return true;
 }
 
+// Tune the port for latency, only the event driven wait is mandatory, the rest depends on the driver and the permissions
+bool raw_serial::_openLowLatency()
+{
+    // let the tty layer push every received chunk to the reader without deferring it to a work queue
+    struct serial_struct serinfo;
+    if (ioctl(serial_fd, TIOCGSERIAL, &serinfo) == 0) {
+        serinfo.flags |= ASYNC_LOW_LATENCY;
+        ioctl(serial_fd, TIOCSSERIAL, &serinfo);
+    }
+
+    // FTDI style adapters only flush a partial USB packet when their latency timer expires, 16 ms by default
+    char devPath[PATH_MAX];
+    if (realpath(_portName, devPath)) {
+        const char * ttyName = strrchr(devPath, '/');
+        ttyName = ttyName ? ttyName + 1 : devPath;
+
+        char timerPath[PATH_MAX + 64];
+        snprintf(timerPath, sizeof(timerPath), "/sys/bus/usb-serial/devices/%s/latency_timer", ttyName);
+        FILE * timer = fopen(timerPath, "r+");
+        if (timer) {
+            int latency = 0;
+            if (fscanf(timer, "%d", &latency) == 1 && latency > 1) {
+                rewind(timer);
+                fprintf(timer, "1");
+            }
+            fclose(timer);
+        }
+    }
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd == -1) return false;
+
+    // edge triggered: woken up by each new chunk of data, not by the bytes already waiting for the missing ones
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = serial_fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, serial_fd, &ev) == -1) return false;
+
+    if (_selfpipe[0] != -1) {
+        ev.events = EPOLLIN;
+        ev.data.fd = _selfpipe[0];
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _selfpipe[0], &ev) == -1) return false;
+    }
+    return true;
+}
+
+// The multishot read needs an empty port to fail with EAGAIN, with VMIN at 0 the read returns nothing instead,
+// taken by the kernel for the end of the file
+bool raw_serial::_openRing()
+{
+#if !defined(__GNUC__)
+    struct termios tio;
+    if (tcgetattr(serial_fd, &tio)) return false;
+    tio.c_cc[VMIN] = 1;
+    if (tcsetattr(serial_fd, TCSANOW, &tio)) return false;
+    if (_uring.start(serial_fd, UringReceiver::MODE_READ, _selfpipe[0])) return true;
+    tio.c_cc[VMIN] = 0;
+    tcsetattr(serial_fd, TCSANOW, &tio);
+#else
+    struct termios2 tio;
+    if (ioctl(serial_fd, TCGETS2, &tio)) return false;
+    tio.c_cc[VMIN] = 1;
+    if (ioctl(serial_fd, TCSETS2, &tio)) return false;
+    if (_uring.start(serial_fd, UringReceiver::MODE_READ, _selfpipe[0])) return true;
+    tio.c_cc[VMIN] = 0;
+    ioctl(serial_fd, TCSETS2, &tio);
+#endif
+    return false;
+}
+
 void raw_serial::close()
 {
+    _uring.stop();
+
     if (serial_fd != -1)
         ::close(serial_fd);
     serial_fd = -1;
@@ -239,6 +323,10 @@ void raw_serial::close()
 
     _selfpipe[0] = _selfpipe[1] = -1;
 
+    if (_epoll_fd != -1)
+        ::close(_epoll_fd);
+    _epoll_fd = -1;
+
     _operation_aborted = false;
     _is_serial_opened = false;
 }
@@ -269,6 +357,11 @@ int raw_serial::senddata(const unsigned char * data, size_t size)
 int raw_serial::recvdata(unsigned char * data, size_t size)
 {
     if (!isOpened()) return 0;
+
+    if (_uring.isActive()) {
+        required_rx_cnt = _uring.read(data, size);
+        return (int)required_rx_cnt;
+    }
     
     int ans = ::read(serial_fd, data, size);
     
@@ -281,6 +374,7 @@ int raw_serial::recvdata(unsigned char * data, size_t size)
 void raw_serial::flush( _u32 flags)
 {
     tcflush(serial_fd,TCIFLUSH); 
+    _uring.discard();
 }
 
 int raw_serial::waitforsent(_u32 timeout, size_t * returned_size)
@@ -303,6 +397,9 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
     if (returned_size==NULL) returned_size=(size_t *)&length;
     *returned_size = 0;
 
+    if (_uring.isActive()) return _waitfordataRing(data_count, timeout, returned_size);
+    if (_epoll_fd != -1) return _waitfordataLowLatency(data_count, timeout, returned_size);
+
     int max_fd;
     fd_set input_set;
     struct timeval timeout_val;
@@ -320,6 +417,8 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
     timeout_val.tv_sec = timeout / 1000;
     timeout_val.tv_usec = (timeout % 1000) * 1000;
 
+    if (_operation_aborted) return ANS_TIMEOUT;
+
     if ( isOpened() )
     {
         if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
@@ -375,6 +474,8 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
             else 
             {
                 int remain_timeout = timeout_val.tv_sec*1000000 + timeout_val.tv_usec;
+                // the timeout expired with only part of the bytes received, e.g. a zero timeout polling
+                if (!remain_timeout) return ANS_TIMEOUT;
                 int expect_remain_time = (data_count - *returned_size)*1000000*8/_baudrate;
                 if (remain_timeout > expect_remain_time)
                     usleep(expect_remain_time);
@@ -386,13 +487,90 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
     return ANS_DEV_ERR;
 }
 
+int raw_serial::_waitfordataLowLatency(size_t data_count, _u32 timeout, size_t * returned_size)
+{
+    if (_operation_aborted) return ANS_TIMEOUT;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    _u64 deadline = (_u64)now.tv_sec * 1000 + now.tv_nsec / 1000000 + timeout;
+
+    while ( isOpened() )
+    {
+        if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
+        if (*returned_size >= data_count) return 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        _u64 currentTs = (_u64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+        if (currentTs >= deadline) break;
+
+        struct epoll_event events[2];
+        int n = epoll_wait(_epoll_fd, events, 2, (int)std::min<_u64>(deadline - currentTs, INT_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            *returned_size = 0;
+            return ANS_DEV_ERR;
+        }
+
+        for (int pos = 0; pos < n; ++pos) {
+            if (events[pos].data.fd == _selfpipe[0]) {
+                // require aborting the current operation, treat as timeout
+                int ch;
+                while (::read(_selfpipe[0], &ch, 1) > 0);
+                *returned_size = 0;
+                return ANS_TIMEOUT;
+            }
+        }
+    }
+
+    if (!isOpened()) return ANS_DEV_ERR;
+    *returned_size = 0;
+    return ANS_TIMEOUT;
+}
+
+// The multishot read takes the data out of the tty as soon as it comes in, the wait is for the buffered count
+int raw_serial::_waitfordataRing(size_t data_count, _u32 timeout, size_t * returned_size)
+{
+    if (_operation_aborted) return ANS_TIMEOUT;
+
+    _u32 startTs = getms();
+    while ( isOpened() )
+    {
+        _uring.poll();
+        *returned_size = _uring.bufferedBytes();
+        if (*returned_size >= data_count) return 0;
+        if (_uring.isClosed() || _uring.hasFailed()) break;
+
+        _u32 waitTime = getms() - startTs;
+        if (waitTime >= timeout) {
+            *returned_size = 0;
+            return ANS_TIMEOUT;
+        }
+
+        u_result ans = _uring.waitforData(timeout - waitTime);
+        if (ans == RESULT_OPERATION_TIMEOUT && (_operation_aborted || getms() - startTs >= timeout)) {
+            if (_operation_aborted) {
+                // require aborting the current operation, treat as timeout
+                int ch;
+                while (::read(_selfpipe[0], &ch, 1) > 0);
+            }
+            *returned_size = 0;
+            return ANS_TIMEOUT;
+        }
+        if (IS_FAIL(ans) && ans != RESULT_OPERATION_TIMEOUT) break;
+    }
+
+    *returned_size = 0;
+    return ANS_DEV_ERR;
+}
+
 size_t raw_serial::rxqueue_count()
 {
     if  ( !isOpened() ) return 0;
     size_t remaining;
     
     if (::ioctl(serial_fd, FIONREAD, &remaining) == -1) return 0;
-    return remaining;
+    return remaining + _uring.bufferedBytes();
 }
 
 void raw_serial::setDTR()
@@ -418,6 +596,7 @@ void raw_serial::_init()
     required_tx_cnt = required_rx_cnt = 0;
     _operation_aborted = false;
     _selfpipe[0] = _selfpipe[1] = -1;
+    _epoll_fd = -1;
 }
 
 void raw_serial::cancelOperation()
@@ -428,6 +607,26 @@ void raw_serial::cancelOperation()
     ::write(_selfpipe[1], "x", 1);
 }
 
+bool raw_serial::isRingReceiveActive()
+{
+    return _uring.isActive();
+}
+
+int raw_serial::getPollHandle()
+{
+    if (!isOpened()) return -1;
+    return _uring.isActive() ? _uring.pollHandle() : serial_fd;
+}
+
+void raw_serial::resumeOperation()
+{
+    if (_selfpipe[0] != -1) {
+        int ch;
+        while (::read(_selfpipe[0], &ch, 1) > 0);
+    }
+    _operation_aborted = false;
+}
+
 _u32 raw_serial::getTermBaudBitmap(_u32 baud)
 {
 #define BAUD_CONV( _baud_) case _baud_:  return B##_baud_ 
@@ -35,6 +35,7 @@
 #pragma once
 
 #include "hal/abs_rxtx.h"
+#include "arch/linux/uring_rx.h"
 
 namespace rp{ namespace arch{ namespace net{
 
@@ -69,11 +70,23 @@ public:
     _u32 getTermBaudBitmap(_u32 baud);
 
     virtual void cancelOperation();
+    virtual void resumeOperation();
+
+    virtual bool isRingReceiveActive();
+    virtual int  getPollHandle();
 
 protected:
     bool open(const char * portname, uint32_t baudrate, uint32_t flags = 0);
     void _init();
 
+    // FLAG_LOW_LATENCY support
+    bool _openLowLatency();
+    int  _waitfordataLowLatency(size_t data_count, _u32 timeout, size_t * returned_size);
+
+    // FLAG_IO_URING support
+    bool _openRing();
+    int  _waitfordataRing(size_t data_count, _u32 timeout, size_t * returned_size);
+
     char _portName[200];
     uint32_t _baudrate;
     uint32_t _flags;
@@ -85,6 +98,10 @@ protected:
 
     int    _selfpipe[2];
     bool   _operation_aborted;
+
+    int    _epoll_fd;
+
+    UringReceiver _uring;
 };
 
 }}}
@@ -9,12 +9,15 @@
 
 #include "sdkcommon.h"
 #include "../../hal/socket.h"
+#include "arch/linux/uring_rx.h"
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <algorithm>
+#include <atomic>
 
 namespace rp{ namespace net {
 
@@ -347,6 +350,97 @@ namespace rp { namespace arch { namespace net{
 
 using namespace rp::net;
 
+// Self-pipe waking up a thread blocked in waitforData, see SocketBase::cancelWait
+class WaitCanceller
+{
+public:
+    WaitCanceller()
+        : _cancelled(false)
+    {
+        if (pipe(_pipe) == -1) {
+            _pipe[0] = _pipe[1] = -1;
+            return;
+        }
+        fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL) | O_NONBLOCK);
+        fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL) | O_NONBLOCK);
+    }
+
+    ~WaitCanceller()
+    {
+        if (_pipe[0] != -1) ::close(_pipe[0]);
+        if (_pipe[1] != -1) ::close(_pipe[1]);
+    }
+
+    void cancel()
+    {
+        _cancelled = true;
+        if (_pipe[1] == -1) return;
+        ssize_t ans = ::write(_pipe[1], "x", 1);
+        (void)ans;
+    }
+
+    void resume()
+    {
+        char buffer[16];
+        if (_pipe[0] != -1) {
+            while (::read(_pipe[0], buffer, sizeof(buffer)) > 0);
+        }
+        _cancelled = false;
+    }
+
+    bool isCancelled() const
+    {
+        return _cancelled;
+    }
+
+    // add the pipe to the read set of a select call, returns the highest fd
+    int addToSet(fd_set& rdset, int maxfd) const
+    {
+        if (_pipe[0] == -1) return maxfd;
+        FD_SET(_pipe[0], &rdset);
+        return _pipe[0] > maxfd ? _pipe[0] : maxfd;
+    }
+
+    bool isSet(const fd_set& rdset) const
+    {
+        return _pipe[0] != -1 && FD_ISSET(_pipe[0], &rdset);
+    }
+
+    int readFd() const
+    {
+        return _pipe[0];
+    }
+
+private:
+    std::atomic<bool> _cancelled;   // written by the stopping thread, read by the waiting one
+    int  _pipe[2];
+};
+
+static u_result _waitforDataCancellable(int socketFd, const WaitCanceller& canceller, _u32 timeout)
+{
+    if (canceller.isCancelled()) return RESULT_OPERATION_TIMEOUT;
+
+    fd_set rdset;
+    FD_ZERO(&rdset);
+    FD_SET(socketFd, &rdset);
+    int maxfd = canceller.addToSet(rdset, socketFd);
+
+    timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    int ans = ::select(maxfd+1, &rdset, NULL, NULL, &tv);
+
+    if (ans < 0) {
+        delay(0); //relax cpu
+        return RESULT_OPERATION_FAIL;
+    }
+    if (ans == 0 || canceller.isSet(rdset)) {
+        // timeout, or the wait was cancelled by another thread
+        return RESULT_OPERATION_TIMEOUT;
+    }
+    return RESULT_OK;
+}
+
 class _single_thread StreamSocketImpl : public StreamSocket
 {
 public:
@@ -364,6 +458,7 @@ public:
 
     virtual ~StreamSocketImpl() 
     {
+        _uring.stop();
         close(_socket_fd);
     }
 
@@ -488,6 +583,11 @@ public:
 
     virtual u_result recv(void *buf, size_t len, size_t & recv_len)
     {
+        if (_uring.isActive()) {
+            if (!_uring.bufferedBytes()) _uring.waitforData(DEFAULT_SOCKET_TIMEOUT);
+            return _recvFromRing(buf, len, recv_len);
+        }
+
         size_t ans = ::recv( _socket_fd, buf, len, 0);
         if (ans == (size_t)-1) {
             recv_len = 0;  
@@ -510,26 +610,37 @@ public:
         }
     }
 
-#if 0
     virtual u_result recvNoWait(void *buf, size_t len, size_t & recv_len)
     {
-        size_t ans = ::recv( _socket_fd, buf, len, MSG_DONTWAIT);
-        if (ans == (size_t)-1) {
-            recv_len = 0;  
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                return RESULT_OK; 
-            } else {
-                return RESULT_OPERATION_FAIL;
-            }
-
+        if (_uring.isActive()) {
+            _uring.poll();
+            return _recvFromRing(buf, len, recv_len);
+        }
 
-        } else {
-            recv_len = ans;
-            return RESULT_OK;
+        ssize_t ans = ::recv( _socket_fd, buf, len, MSG_DONTWAIT);
+        if (ans < 0) {
+            recv_len = 0;
+            switch (errno) {
+                case EAGAIN:
+#if EWOULDBLOCK!=EAGAIN
+                case EWOULDBLOCK:
+#endif
+                case EINTR:
+                    return RESULT_OPERATION_TIMEOUT;
+                default:
+                    return RESULT_OPERATION_FAIL;
+            }
         }
+        recv_len = (size_t)ans;
+        return RESULT_OK;
+    }
 
+    virtual u_result setReceiveBufferSize(size_t size)
+    {
+        int bufSize = (int)size;
+        if (::setsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize))) return RESULT_OPERATION_FAIL;
+        return RESULT_OK;
     }
-#endif
 
     virtual u_result getPeerAddress(SocketAddress & peerAddr)
     {
@@ -603,30 +714,45 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        if (_uring.isActive()) {
+            if (_canceller.isCancelled()) return RESULT_OPERATION_TIMEOUT;
+            return _uring.waitforData(timeout);
+        }
+        return _waitforDataCancellable(_socket_fd, _canceller, timeout);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual void cancelWait()
+    {
+        _canceller.cancel();
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual void resumeWait()
+    {
+        _canceller.resume();
+    }
+
+    virtual u_result enableRingReceive()
+    {
+        return _uring.start(_socket_fd, UringReceiver::MODE_RECV, _canceller.readFd()) ? RESULT_OK : RESULT_OPERATION_NOT_SUPPORT;
+    }
+
+    virtual int getPollHandle()
+    {
+        return _uring.isActive() ? _uring.pollHandle() : _socket_fd;
     }
 
 protected:
+    // same results as a receive without waiting on the socket
+    u_result _recvFromRing(void *buf, size_t len, size_t & recv_len)
+    {
+        recv_len = _uring.read(buf, len);
+        if (recv_len || _uring.isClosed()) return RESULT_OK;
+        return _uring.hasFailed() ? RESULT_OPERATION_FAIL : RESULT_OPERATION_TIMEOUT;
+    }
+
     int  _socket_fd;
+    WaitCanceller _canceller;
+    UringReceiver _uring;
 
 
 };
@@ -642,11 +768,16 @@ public:
         assert(fd>=0);
         int bool_true = 1;
         ::setsockopt( _socket_fd, SOL_SOCKET, SO_REUSEADDR | SO_BROADCAST , (char *)&bool_true, sizeof(bool_true) );
+        // attach the count of datagrams dropped by the socket to each received one, see recvBatch
+        ::setsockopt( _socket_fd, SOL_SOCKET, SO_RXQ_OVFL, (char *)&bool_true, sizeof(bool_true) );
+        // and the time the kernel received it
+        ::setsockopt( _socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, (char *)&bool_true, sizeof(bool_true) );
         setTimeout(DEFAULT_SOCKET_TIMEOUT, SOCKET_DIR_BOTH);
     }
 
     virtual ~DGramSocketImpl() 
     {
+        _uring.stop();
         close(_socket_fd);
     }
 
@@ -729,26 +860,21 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        if (_uring.isActive()) {
+            if (_canceller.isCancelled()) return RESULT_OPERATION_TIMEOUT;
+            return _uring.waitforData(timeout);
+        }
+        return _waitforDataCancellable(_socket_fd, _canceller, timeout);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual void cancelWait()
+    {
+        _canceller.cancel();
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual void resumeWait()
+    {
+        _canceller.resume();
     }
 
     virtual u_result sendTo(const SocketAddress & target, const void * buffer, size_t len)
@@ -790,6 +916,8 @@ public:
     
     virtual u_result clearRxCache()
     {
+        _uring.discard();
+
         timeval tv;
         tv.tv_sec = 0;
         tv.tv_usec = 0;
@@ -810,6 +938,23 @@ public:
 
     virtual u_result recvFrom(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr)
     {
+        if (_uring.isActive()) {
+            UringReceiver::Chunk chunk;
+            const sockaddr_storage * source = NULL;
+            recv_len = 0;
+            _uring.poll();
+            if (!_uring.frontChunk(chunk, &source)) {
+                u_result ans = _uring.waitforData(DEFAULT_SOCKET_TIMEOUT);
+                if (IS_FAIL(ans)) return ans;
+                if (!_uring.frontChunk(chunk, &source)) return RESULT_OPERATION_TIMEOUT;
+            }
+            recv_len = std::min(chunk.len, len);
+            memcpy(buf, chunk.data, recv_len);
+            if (sourceAddr && source) memcpy(const_cast<void *>(sourceAddr->getPlatformData()), source, sizeof(sockaddr_storage));
+            _uring.popChunk();
+            return RESULT_OK;
+        }
+
         struct sockaddr * addr = (sourceAddr?reinterpret_cast<struct sockaddr *>(const_cast<void *>(sourceAddr->getPlatformData())):NULL);
         size_t source_addr_size = (sourceAddr?sizeof(sockaddr_storage):0);
 
@@ -833,6 +978,87 @@ public:
 
     }
 
+    virtual u_result recvBatch(Datagram * datagrams, size_t count, size_t & received)
+    {
+        if (_uring.isActive()) {
+            UringReceiver::Chunk chunk;
+            received = 0;
+            _uring.poll();
+            while (received < count && _uring.frontChunk(chunk)) {
+                Datagram & dgram = datagrams[received];
+                dgram.recv_len = std::min(chunk.len, dgram.len);
+                memcpy(dgram.buf, chunk.data, dgram.recv_len);
+                dgram.truncated = chunk.truncated || chunk.len > dgram.len;
+                dgram.drops = chunk.drops;
+                dgram.timestamp_us = chunk.timestamp_us;
+                _uring.popChunk();
+                ++received;
+            }
+            return (!received && _uring.hasFailed()) ? RESULT_OPERATION_FAIL : RESULT_OK;
+        }
+
+        enum {
+            MAX_BATCH = 64,
+        };
+        struct mmsghdr msgs[MAX_BATCH];
+        struct iovec iovs[MAX_BATCH];
+        union {
+            char buf[CMSG_SPACE(sizeof(_u32)) + CMSG_SPACE(sizeof(struct timespec))];
+            struct cmsghdr align;
+        } controls[MAX_BATCH];
+
+        received = 0;
+        if (count > MAX_BATCH) count = MAX_BATCH;
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (size_t pos = 0; pos < count; ++pos) {
+            iovs[pos].iov_base = datagrams[pos].buf;
+            iovs[pos].iov_len = datagrams[pos].len;
+            msgs[pos].msg_hdr.msg_iov = &iovs[pos];
+            msgs[pos].msg_hdr.msg_iovlen = 1;
+            msgs[pos].msg_hdr.msg_control = controls[pos].buf;
+            msgs[pos].msg_hdr.msg_controllen = sizeof(controls[pos].buf);
+        }
+
+        int ans = ::recvmmsg(_socket_fd, msgs, (unsigned int)count, MSG_DONTWAIT, NULL);
+        if (ans == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return RESULT_OK;
+            return RESULT_OPERATION_FAIL;
+        }
+
+        // the kernel stamps the datagrams with the realtime clock, the callers work with the monotonic one
+        struct timespec realNow, monoNow;
+        clock_gettime(CLOCK_REALTIME, &realNow);
+        clock_gettime(CLOCK_MONOTONIC, &monoNow);
+        _s64 realToMonoNs = ((_s64)monoNow.tv_sec - realNow.tv_sec) * 1000000000LL + (monoNow.tv_nsec - realNow.tv_nsec);
+
+        for (int pos = 0; pos < ans; ++pos) {
+            Datagram & dgram = datagrams[pos];
+            dgram.recv_len = msgs[pos].msg_len;
+            dgram.truncated = (msgs[pos].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+            dgram.drops = 0;
+            dgram.timestamp_us = 0;
+            for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msgs[pos].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[pos].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    memcpy(&dgram.drops, CMSG_DATA(cmsg), sizeof(dgram.drops));
+                } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec stamp;
+                    memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                    _s64 monoNs = (_s64)stamp.tv_sec * 1000000000LL + stamp.tv_nsec + realToMonoNs;
+                    if (monoNs > 0) dgram.timestamp_us = (_u64)(monoNs / 1000);
+                }
+            }
+        }
+        received = ans;
+        return RESULT_OK;
+    }
+
+    virtual u_result setReceiveBufferSize(size_t size)
+    {
+        int bufSize = (int)size;
+        if (::setsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize))) return RESULT_OPERATION_FAIL;
+        return RESULT_OK;
+    }
+
 #if 0
     virtual u_result recvFromNoWait(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr)
     {
@@ -858,9 +1084,21 @@ public:
 
     }
 #endif
+
+    virtual u_result enableRingReceive()
+    {
+        return _uring.start(_socket_fd, UringReceiver::MODE_RECVMSG, _canceller.readFd()) ? RESULT_OK : RESULT_OPERATION_NOT_SUPPORT;
+    }
+
+    virtual int getPollHandle()
+    {
+        return _uring.isActive() ? _uring.pollHandle() : _socket_fd;
+    }
     
 protected:
     int  _socket_fd;
+    WaitCanceller _canceller;
+    UringReceiver _uring;
 
 };
 
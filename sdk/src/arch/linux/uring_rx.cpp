@@ -0,0 +1,558 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include "arch/linux/arch_linux.h"
+#include "arch/linux/uring_rx.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <algorithm>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// provided buffer rings and multishot receives are the minimum, older headers build the fallback only
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define SL_HAS_IO_URING 1
+#endif
+
+namespace rp{ namespace arch{ namespace net{
+
+#ifdef SL_HAS_IO_URING
+
+namespace {
+
+enum {
+    // not in the uapi headers older than Linux 6.7
+    URING_OP_READ_MULTISHOT = 49,
+
+    URING_SQ_ENTRIES = 8,
+    URING_CQ_ENTRIES = 128,
+    URING_BUFFER_GROUP = 0,
+    URING_STOP_TIMEOUT = 100,
+
+    TAG_RECEIVE = 1,
+    TAG_CANCEL  = 2,
+    TAG_IGNORE  = 3,
+};
+
+static int _uringSetup(unsigned entries, struct io_uring_params * params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int _uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void * arg, size_t argSize)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int _uringRegister(int ringFd, unsigned opcode, void * arg, unsigned nrArgs)
+{
+    return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+// the kernel stamps the datagrams with the realtime clock, the callers work with the monotonic one
+static _u64 _realtimeToMonotonicUs(const struct timespec & stamp)
+{
+    struct timespec realNow, monoNow;
+    clock_gettime(CLOCK_REALTIME, &realNow);
+    clock_gettime(CLOCK_MONOTONIC, &monoNow);
+    _s64 realToMonoNs = ((_s64)monoNow.tv_sec - realNow.tv_sec) * 1000000000LL + (monoNow.tv_nsec - realNow.tv_nsec);
+    _s64 monoNs = (_s64)stamp.tv_sec * 1000000000LL + stamp.tv_nsec + realToMonoNs;
+    return monoNs > 0 ? (_u64)(monoNs / 1000) : 0;
+}
+
+}
+
+UringReceiver::UringReceiver()
+    : _ring_fd(-1)
+    , _ring_ptr(NULL)
+    , _sqes_ptr(NULL)
+    , _buf_ring_ptr(NULL)
+    , _buffers(NULL)
+{
+    _release();
+}
+
+UringReceiver::~UringReceiver()
+{
+    stop();
+}
+
+bool UringReceiver::start(int fd, Mode mode, int cancelFd)
+{
+    stop();
+    _fd = fd;
+    _mode = mode;
+    _cancel_fd = cancelFd;
+
+    if (!_setup() || !_arm()) {
+        stop();
+        return false;
+    }
+    _armCancel();
+    if (_enter(0, 0) < 0) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void UringReceiver::stop()
+{
+    if (_ring_fd != -1) {
+        // the kernel must be done with the buffers before they are freed
+        _stopping = true;
+        _cancelRequests();
+    }
+    _release();
+}
+
+void UringReceiver::_cancelRequests()
+{
+    if (!_rx_armed && !_cancel_armed) return;
+
+    struct io_uring_sqe * sqe = _getSqe();
+    if (sqe) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = TAG_RECEIVE;
+        sqe->user_data = TAG_IGNORE;
+        _commitSqe();
+    }
+    sqe = _getSqe();
+    if (sqe) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = TAG_CANCEL;
+        sqe->user_data = TAG_IGNORE;
+        _commitSqe();
+    }
+
+    _u32 startTs = getms();
+    while ((_rx_armed || _cancel_armed) && getms() - startTs < URING_STOP_TIMEOUT) {
+        if (_enter(1, 10) < 0 && errno != ETIME && errno != EINTR) break;
+        _reap();
+    }
+}
+
+bool UringReceiver::_setup()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+
+    _ring_fd = _uringSetup(URING_SQ_ENTRIES, &params);
+    if (_ring_fd < 0) {
+        _ring_fd = -1;
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) return false;
+
+    // the multishot receives of the sockets came along with the zero copy sends
+    union {
+        struct io_uring_probe probe;
+        _u8 buffer[sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)];
+    } probe;
+    memset(&probe, 0, sizeof(probe));
+    if (_uringRegister(_ring_fd, IORING_REGISTER_PROBE, &probe, 256) < 0) return false;
+
+    int neededOps[2] = { IORING_OP_SEND_ZC, IORING_OP_RECV };
+    if (_mode == MODE_READ) neededOps[1] = URING_OP_READ_MULTISHOT;
+    if (_mode == MODE_RECVMSG) neededOps[1] = IORING_OP_RECVMSG;
+    for (size_t pos = 0; pos < 2; ++pos) {
+        int op = neededOps[pos];
+        if (op > probe.probe.last_op || !(probe.probe.ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(_u32);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    _ring_size = std::max(sqSize, cqSize);
+    _ring_ptr = mmap(NULL, _ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+    if (_ring_ptr == MAP_FAILED) {
+        _ring_ptr = NULL;
+        return false;
+    }
+    _sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes_ptr = mmap(NULL, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+    if (_sqes_ptr == MAP_FAILED) {
+        _sqes_ptr = NULL;
+        return false;
+    }
+
+    _u8 * ring = (_u8 *)_ring_ptr;
+    _sq_entries = params.sq_entries;
+    _sq_head = (_u32 *)(ring + params.sq_off.head);
+    _sq_tail = (_u32 *)(ring + params.sq_off.tail);
+    _sq_mask = (_u32 *)(ring + params.sq_off.ring_mask);
+    _sq_array = (_u32 *)(ring + params.sq_off.array);
+    _cq_head = (_u32 *)(ring + params.cq_off.head);
+    _cq_tail = (_u32 *)(ring + params.cq_off.tail);
+    _cq_mask = (_u32 *)(ring + params.cq_off.ring_mask);
+    _cqes = ring + params.cq_off.cqes;
+
+    // the buffer ring has to be page aligned
+    _buf_ring_size = BUFFER_COUNT * sizeof(struct io_uring_buf);
+    _buf_ring_ptr = mmap(NULL, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (_buf_ring_ptr == MAP_FAILED) {
+        _buf_ring_ptr = NULL;
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (_u64)(uintptr_t)_buf_ring_ptr;
+    reg.ring_entries = BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (_uringRegister(_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+
+    _buffers = new _u8[BUFFER_COUNT * BUFFER_SIZE];
+    for (size_t bid = 0; bid < BUFFER_COUNT; ++bid) _recycle((_u16)bid);
+
+    memset(&_msg, 0, sizeof(_msg));
+    _msg.msg_namelen = sizeof(struct sockaddr_storage);
+    _msg.msg_controllen = RECVMSG_CONTROL_SIZE;
+    return true;
+}
+
+void UringReceiver::_release()
+{
+    if (_ring_fd != -1) ::close(_ring_fd);
+    if (_ring_ptr) munmap(_ring_ptr, _ring_size);
+    if (_sqes_ptr) munmap(_sqes_ptr, _sqes_size);
+    if (_buf_ring_ptr) munmap(_buf_ring_ptr, _buf_ring_size);
+    delete [] _buffers;
+
+    _ring_fd = -1;
+    _fd = -1;
+    _cancel_fd = -1;
+    _mode = MODE_READ;
+    _ring_ptr = NULL;
+    _ring_size = 0;
+    _sqes_ptr = NULL;
+    _sqes_size = 0;
+    _buf_ring_ptr = NULL;
+    _buf_ring_size = 0;
+    _sq_entries = 0;
+    _sq_head = _sq_tail = _sq_mask = _sq_array = NULL;
+    _cq_head = _cq_tail = _cq_mask = NULL;
+    _cqes = NULL;
+    _sq_pending = 0;
+    _buf_tail = 0;
+    _buffers = NULL;
+    _pending_head = 0;
+    _pending_count = 0;
+    _buffered_bytes = 0;
+    _rx_armed = false;
+    _cancel_armed = false;
+    _cancel_fired = false;
+    _closed = false;
+    _failed = false;
+    _stopping = false;
+}
+
+struct io_uring_sqe * UringReceiver::_getSqe()
+{
+    _u32 head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    _u32 tail = *_sq_tail;
+    if (tail - head >= _sq_entries) return NULL;
+
+    _u32 index = tail & *_sq_mask;
+    struct io_uring_sqe * sqe = (struct io_uring_sqe *)_sqes_ptr + index;
+    memset(sqe, 0, sizeof(*sqe));
+    _sq_array[index] = index;
+    return sqe;
+}
+
+void UringReceiver::_commitSqe()
+{
+    __atomic_store_n(_sq_tail, *_sq_tail + 1, __ATOMIC_RELEASE);
+    ++_sq_pending;
+}
+
+bool UringReceiver::_arm()
+{
+    struct io_uring_sqe * sqe = _getSqe();
+    if (!sqe) return false;
+
+    sqe->fd = _fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = TAG_RECEIVE;
+    switch (_mode) {
+    case MODE_READ:
+        sqe->opcode = URING_OP_READ_MULTISHOT;
+        break;
+    case MODE_RECV:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        break;
+    case MODE_RECVMSG:
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->addr = (_u64)(uintptr_t)&_msg;
+        sqe->len = 1;
+        break;
+    }
+    _commitSqe();
+    _rx_armed = true;
+    return true;
+}
+
+bool UringReceiver::_armCancel()
+{
+    if (_cancel_fd == -1) return false;
+    struct io_uring_sqe * sqe = _getSqe();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = _cancel_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = TAG_CANCEL;
+    _commitSqe();
+    _cancel_armed = true;
+    return true;
+}
+
+void UringReceiver::_recycle(_u16 bid)
+{
+    // io_uring_buf_ring is not used directly: its flexible array member picks up a one byte
+    // offset in C++. The ring tail overlays the resv field of the first entry.
+    struct io_uring_buf * bufs = (struct io_uring_buf *)_buf_ring_ptr;
+    struct io_uring_buf * buf = &bufs[_buf_tail & (BUFFER_COUNT - 1)];
+    buf->addr = (_u64)(uintptr_t)(_buffers + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = bid;
+    ++_buf_tail;
+    __atomic_store_n(&bufs[0].resv, _buf_tail, __ATOMIC_RELEASE);
+}
+
+int UringReceiver::_enter(_u32 waitCount, _u32 timeout)
+{
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000LL;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (_u64)(uintptr_t)&ts;
+
+    int ans = _uringEnter(_ring_fd, _sq_pending, waitCount, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ans > 0) _sq_pending -= std::min<_u32>(ans, _sq_pending);
+    return ans;
+}
+
+void UringReceiver::_reap()
+{
+    _u32 head = *_cq_head;
+    _u32 tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe * cqe = (const struct io_uring_cqe *)_cqes + (head & *_cq_mask);
+        _onCompletion(cqe->user_data, cqe->res, cqe->flags);
+        ++head;
+    }
+    __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+}
+
+void UringReceiver::_onCompletion(_u64 userData, _s32 res, _u32 flags)
+{
+    if (userData == TAG_CANCEL) {
+        _cancel_fired = true;
+        if (!(flags & IORING_CQE_F_MORE)) _cancel_armed = false;
+        return;
+    }
+    if (userData != TAG_RECEIVE) return;
+    if (!(flags & IORING_CQE_F_MORE)) _rx_armed = false;
+
+    if (!(flags & IORING_CQE_F_BUFFER)) {
+        if (res == 0) {
+            _closed = true;
+        } else if (res < 0 && res != -ENOBUFS && res != -ECANCELED && res != -EINTR && res != -EAGAIN) {
+            _failed = true;
+        }
+        return;
+    }
+
+    _u16 bid = (_u16)(flags >> IORING_CQE_BUFFER_SHIFT);
+    if (res <= 0) {
+        _recycle(bid);
+        if (res == 0) _closed = true;
+        return;
+    }
+
+    Pending & chunk = _pending[(_pending_head + _pending_count) % BUFFER_COUNT];
+    chunk.bid = bid;
+    chunk.offset = 0;
+    chunk.len = (size_t)res;
+    chunk.truncated = false;
+    chunk.drops = 0;
+    chunk.timestamp_us = getus();
+
+    if (_mode == MODE_RECVMSG) {
+        _u8 * buf = _buffers + (size_t)bid * BUFFER_SIZE;
+        const struct io_uring_recvmsg_out * out = (const struct io_uring_recvmsg_out *)buf;
+        size_t header = sizeof(*out) + _msg.msg_namelen + _msg.msg_controllen;
+        if ((size_t)res < header) {
+            _recycle(bid);
+            return;
+        }
+        chunk.offset = header;
+        chunk.len = (size_t)res - header;
+        chunk.truncated = (out->flags & MSG_TRUNC) || out->payloadlen > chunk.len;
+
+        struct msghdr view;
+        memset(&view, 0, sizeof(view));
+        view.msg_control = buf + sizeof(*out) + _msg.msg_namelen;
+        view.msg_controllen = out->controllen;
+        for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&view); cmsg; cmsg = CMSG_NXTHDR(&view, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                memcpy(&chunk.drops, CMSG_DATA(cmsg), sizeof(chunk.drops));
+            } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec stamp;
+                memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                _u64 timestamp = _realtimeToMonotonicUs(stamp);
+                if (timestamp) chunk.timestamp_us = timestamp;
+            }
+        }
+    }
+
+    ++_pending_count;
+    _buffered_bytes += chunk.len;
+}
+
+void UringReceiver::poll()
+{
+    if (_ring_fd == -1) return;
+    _reap();
+    if (_stopping) return;
+
+    // a multishot receive ends when the buffers run out, it is armed again once one of them is back
+    if (!_rx_armed && !_closed && !_failed && _pending_count < BUFFER_COUNT) _arm();
+    if (!_cancel_armed) _armCancel();
+    if (_sq_pending) _enter(0, 0);
+}
+
+u_result UringReceiver::waitforData(_u32 timeout)
+{
+    if (_ring_fd == -1) return RESULT_OPERATION_FAIL;
+
+    _u32 startTs = getms();
+    bool entered = false;
+    _cancel_fired = false;
+    for (;;) {
+        poll();
+        if (_pending_count || _closed) return RESULT_OK;
+        if (_failed) return RESULT_OPERATION_FAIL;
+        if (_cancel_fired) return RESULT_OPERATION_TIMEOUT;
+
+        _u32 waitTime = getms() - startTs;
+        if (waitTime > timeout) return RESULT_OPERATION_TIMEOUT;
+        _u32 remain = timeout - waitTime;
+        if (entered && !remain) return RESULT_OPERATION_TIMEOUT;
+
+        // a single call submits the pending requests, waits and collects the completions
+        if (_enter(remain ? 1 : 0, remain) < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return RESULT_OPERATION_FAIL;
+        }
+        entered = true;
+    }
+}
+
+size_t UringReceiver::read(void * buf, size_t len)
+{
+    size_t copied = 0;
+    while (copied < len && _pending_count) {
+        Pending & chunk = _pending[_pending_head];
+        size_t size = std::min(chunk.len, len - copied);
+        memcpy((_u8 *)buf + copied, _buffers + (size_t)chunk.bid * BUFFER_SIZE + chunk.offset, size);
+        copied += size;
+        chunk.offset += size;
+        chunk.len -= size;
+        _buffered_bytes -= size;
+        if (!chunk.len) popChunk();
+    }
+    return copied;
+}
+
+bool UringReceiver::frontChunk(Chunk & chunk, const struct sockaddr_storage ** source)
+{
+    if (!_pending_count) return false;
+    const Pending & pending = _pending[_pending_head];
+    const _u8 * buf = _buffers + (size_t)pending.bid * BUFFER_SIZE;
+    chunk.data = buf + pending.offset;
+    chunk.len = pending.len;
+    chunk.truncated = pending.truncated;
+    chunk.drops = pending.drops;
+    chunk.timestamp_us = pending.timestamp_us;
+    if (source) {
+        const struct io_uring_recvmsg_out * out = (const struct io_uring_recvmsg_out *)buf;
+        *source = (_mode == MODE_RECVMSG && out->namelen) ? (const struct sockaddr_storage *)(buf + sizeof(*out)) : NULL;
+    }
+    return true;
+}
+
+void UringReceiver::popChunk()
+{
+    if (!_pending_count) return;
+    Pending & chunk = _pending[_pending_head];
+    _buffered_bytes -= chunk.len;
+    _recycle(chunk.bid);
+    _pending_head = (_pending_head + 1) % BUFFER_COUNT;
+    --_pending_count;
+}
+
+void UringReceiver::discard()
+{
+    poll();
+    while (_pending_count) popChunk();
+}
+
+#else
+
+UringReceiver::UringReceiver() : _ring_fd(-1), _buffered_bytes(0), _closed(false), _failed(false) {}
+UringReceiver::~UringReceiver() {}
+bool UringReceiver::start(int fd, Mode mode, int cancelFd) { return false; }
+void UringReceiver::stop() {}
+u_result UringReceiver::waitforData(_u32 timeout) { return RESULT_OPERATION_NOT_SUPPORT; }
+void UringReceiver::poll() {}
+size_t UringReceiver::read(void * buf, size_t len) { return 0; }
+bool UringReceiver::frontChunk(Chunk & chunk, const struct sockaddr_storage ** source) { return false; }
+void UringReceiver::popChunk() {}
+void UringReceiver::discard() {}
+
+#endif
+
+}}}
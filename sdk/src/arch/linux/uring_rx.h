@@ -0,0 +1,169 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#pragma once
+
+#include "hal/types.h"
+#include <sys/socket.h>
+
+struct io_uring_sqe;
+
+namespace rp{ namespace arch{ namespace net{
+
+// Receive path of a file descriptor on io_uring
+// A multishot read (or recv, recvmsg) stays outstanding on the descriptor and the kernel fills a ring of
+// provided buffers with the incoming data. Waiting costs one io_uring_enter, whatever the count of chunks
+// completed meanwhile, and the reads are served from the buffers without any system call.
+// Only one thread may wait and read, the wait is woken up by the cancel descriptor given to start().
+class UringReceiver
+{
+public:
+    enum Mode {
+        MODE_READ    = 0,   // character devices, e.g. the serial ports (Linux 6.7 and later)
+        MODE_RECV    = 1,   // stream sockets (Linux 6.0 and later)
+        MODE_RECVMSG = 2,   // datagram sockets, one buffer per datagram along with its ancillary data (Linux 6.0 and later)
+    };
+
+    enum {
+        BUFFER_COUNT = 32,  // power of 2, as required by the provided buffer ring
+        BUFFER_SIZE  = 4096 + 256,
+        RECVMSG_CONTROL_SIZE = 64,
+    };
+
+    // A received chunk of data, a whole datagram for MODE_RECVMSG
+    struct Chunk {
+        const _u8 * data;
+        size_t      len;
+        bool        truncated;      // MODE_RECVMSG: the datagram did not fit in the buffer
+        _u32        drops;          // MODE_RECVMSG: datagrams dropped by the socket since its creation (SO_RXQ_OVFL)
+        _u64        timestamp_us;   // receive time on the clock of getus(), from the kernel when the socket has SO_TIMESTAMPNS
+    };
+
+    UringReceiver();
+    ~UringReceiver();
+
+    // Returns false when the kernel lacks one of the needed features, the caller keeps its regular receive path
+    bool start(int fd, Mode mode, int cancelFd = -1);
+    void stop();
+
+    bool isActive() const { return _ring_fd != -1; }
+
+    // The ring descriptor is readable once completions are posted, e.g. new data received
+    int pollHandle() const { return _ring_fd; }
+
+    // Wait until some data is buffered or the end of the stream is reached.
+    // Returns RESULT_OPERATION_TIMEOUT on timeout or once woken up by the cancel descriptor.
+    u_result waitforData(_u32 timeout);
+
+    // Collect the completions already posted by the kernel, without any system call
+    void poll();
+
+    size_t bufferedBytes() const { return _buffered_bytes; }
+
+    // The peer has closed the stream (MODE_RECV), or the receive failed with an error
+    bool isClosed() const { return _closed; }
+    bool hasFailed() const { return _failed; }
+
+    // Copy up to len bytes of the buffered stream
+    size_t read(void * buf, size_t len);
+
+    // Datagram access for MODE_RECVMSG, the source address is stored in the buffer as well
+    bool frontChunk(Chunk & chunk, const struct sockaddr_storage ** source = NULL);
+    void popChunk();
+
+    // Drop all the buffered data
+    void discard();
+
+private:
+    struct Pending {
+        _u16    bid;
+        size_t  offset;
+        size_t  len;
+        bool    truncated;
+        _u32    drops;
+        _u64    timestamp_us;
+    };
+
+    bool _setup();
+    bool _arm();
+    bool _armCancel();
+    void _recycle(_u16 bid);
+    int  _enter(_u32 waitCount, _u32 timeout);
+    struct io_uring_sqe * _getSqe();
+    void _commitSqe();
+    void _reap();
+    void _onCompletion(_u64 userData, _s32 res, _u32 flags);
+    void _cancelRequests();
+    void _release();
+
+    int         _ring_fd;
+    int         _fd;
+    int         _cancel_fd;
+    Mode        _mode;
+
+    // rings shared with the kernel
+    void *      _ring_ptr;
+    size_t      _ring_size;
+    void *      _sqes_ptr;
+    size_t      _sqes_size;
+    void *      _buf_ring_ptr;
+    size_t      _buf_ring_size;
+
+    _u32        _sq_entries;
+    _u32 *      _sq_head;
+    _u32 *      _sq_tail;
+    _u32 *      _sq_mask;
+    _u32 *      _sq_array;
+    _u32 *      _cq_head;
+    _u32 *      _cq_tail;
+    _u32 *      _cq_mask;
+    void *      _cqes;
+    _u32        _sq_pending;
+    _u16        _buf_tail;
+
+    _u8 *       _buffers;
+    struct msghdr _msg;
+
+    Pending     _pending[BUFFER_COUNT];
+    size_t      _pending_head;
+    size_t      _pending_count;
+    size_t      _buffered_bytes;
+
+    bool        _rx_armed;
+    bool        _cancel_armed;
+    bool        _cancel_fired;
+    bool        _closed;
+    bool        _failed;
+    bool        _stopping;
+};
+
+}}}
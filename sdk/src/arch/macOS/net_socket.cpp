@@ -15,6 +15,7 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <atomic>
 
 namespace rp{ namespace net {
 
@@ -313,6 +314,92 @@ namespace rp { namespace arch { namespace net{
 
 using namespace rp::net;
 
+// Self-pipe waking up a thread blocked in waitforData, see SocketBase::cancelWait
+class WaitCanceller
+{
+public:
+    WaitCanceller()
+        : _cancelled(false)
+    {
+        if (pipe(_pipe) == -1) {
+            _pipe[0] = _pipe[1] = -1;
+            return;
+        }
+        fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL) | O_NONBLOCK);
+        fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL) | O_NONBLOCK);
+    }
+
+    ~WaitCanceller()
+    {
+        if (_pipe[0] != -1) ::close(_pipe[0]);
+        if (_pipe[1] != -1) ::close(_pipe[1]);
+    }
+
+    void cancel()
+    {
+        _cancelled = true;
+        if (_pipe[1] == -1) return;
+        ssize_t ans = ::write(_pipe[1], "x", 1);
+        (void)ans;
+    }
+
+    void resume()
+    {
+        char buffer[16];
+        if (_pipe[0] != -1) {
+            while (::read(_pipe[0], buffer, sizeof(buffer)) > 0);
+        }
+        _cancelled = false;
+    }
+
+    bool isCancelled() const
+    {
+        return _cancelled;
+    }
+
+    // add the pipe to the read set of a select call, returns the highest fd
+    int addToSet(fd_set& rdset, int maxfd) const
+    {
+        if (_pipe[0] == -1) return maxfd;
+        FD_SET(_pipe[0], &rdset);
+        return _pipe[0] > maxfd ? _pipe[0] : maxfd;
+    }
+
+    bool isSet(const fd_set& rdset) const
+    {
+        return _pipe[0] != -1 && FD_ISSET(_pipe[0], &rdset);
+    }
+
+private:
+    std::atomic<bool> _cancelled;   // written by the stopping thread, read by the waiting one
+    int  _pipe[2];
+};
+
+static u_result _waitforDataCancellable(int socketFd, const WaitCanceller& canceller, _u32 timeout)
+{
+    if (canceller.isCancelled()) return RESULT_OPERATION_TIMEOUT;
+
+    fd_set rdset;
+    FD_ZERO(&rdset);
+    FD_SET(socketFd, &rdset);
+    int maxfd = canceller.addToSet(rdset, socketFd);
+
+    timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    int ans = ::select(maxfd+1, &rdset, NULL, NULL, &tv);
+
+    if (ans < 0) {
+        delay(0); //relax cpu
+        return RESULT_OPERATION_FAIL;
+    }
+    if (ans == 0 || canceller.isSet(rdset)) {
+        // timeout, or the wait was cancelled by another thread
+        return RESULT_OPERATION_TIMEOUT;
+    }
+    return RESULT_OK;
+}
+
 class _single_thread StreamSocketImpl : public StreamSocket
 {
 public:
@@ -570,30 +657,22 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        return _waitforDataCancellable(_socket_fd, _canceller, timeout);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual void cancelWait()
+    {
+        _canceller.cancel();
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual void resumeWait()
+    {
+        _canceller.resume();
     }
 
 protected:
     int  _socket_fd;
+    WaitCanceller _canceller;
 
 
 };
@@ -696,26 +775,17 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        return _waitforDataCancellable(_socket_fd, _canceller, timeout);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual void cancelWait()
+    {
+        _canceller.cancel();
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual void resumeWait()
+    {
+        _canceller.resume();
     }
 
     virtual u_result sendTo(const SocketAddress & target, const void * buffer, size_t len)
@@ -807,6 +877,7 @@ public:
     
 protected:
     int  _socket_fd;
+    WaitCanceller _canceller;
 
 };
 
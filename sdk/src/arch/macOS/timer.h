@@ -46,7 +46,6 @@ static inline void delay(_word_size_t ms){
         usleep(ms*1000);
 }
 
-// TODO: the highest timer interface should be clock_gettime
 namespace rp{ namespace arch{
 
 _u64 rp_getus();
@@ -55,3 +54,4 @@ _u32 rp_getms();
 }}
 
 #define getms() rp::arch::rp_getms()
+#define getus() rp::arch::rp_getus()
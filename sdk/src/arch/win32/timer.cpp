@@ -54,6 +54,14 @@ _u32 getHDTimer()
     return (_u32)(current.QuadPart/_current_freq.QuadPart);
 }
 
+_u64 getHDTimer_us()
+{
+    LARGE_INTEGER current;
+    QueryPerformanceCounter(&current);
+
+    return (_u64)(current.QuadPart*1000/_current_freq.QuadPart);
+}
+
 BEGIN_STATIC_CODE(timer_cailb)
 {
     HPtimer_reset();
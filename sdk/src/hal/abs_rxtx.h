@@ -47,6 +47,14 @@ public:
         ANS_DEV_ERR = -2,
     };
 
+    // flags of bind
+    enum{
+        // event driven waits with the lowest latency the port can offer, see sl::SERIAL_PORT_FLAG_LOW_LATENCY
+        FLAG_LOW_LATENCY = 0x1,
+        // receive through io_uring where the kernel supports it, see sl::SERIAL_PORT_FLAG_IO_URING
+        FLAG_IO_URING = 0x2,
+    };
+
     static serial_rxtx * CreateRxTx();
     static void ReleaseRxTx( serial_rxtx * );
 
@@ -71,7 +79,15 @@ public:
 
     virtual void setDTR() = 0;
     virtual void clearDTR() = 0;
+    // cancelOperation makes the pending and the following waitfordata calls return ANS_TIMEOUT until resumeOperation is called
     virtual void cancelOperation() {}
+    virtual void resumeOperation() {}
+
+    // The received data is served from the io_uring buffers, recvdata makes no system call
+    virtual bool isRingReceiveActive() { return false; }
+
+    // Descriptor to poll for the incoming data, the io_uring one while the ring receive is active. -1 if there is none
+    virtual int getPollHandle() { return -1; }
 
     virtual bool isOpened()
     {
@@ -0,0 +1,125 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace rp{ namespace hal{
+
+/**
+ * Manual reset event the event loop of the application can poll: its descriptor is readable while it is set
+ * An eventfd on Linux, a pipe on the other POSIX systems, not available on Windows. The descriptor is only
+ * created by open(), set() and reset() do nothing before. The caller serializes the calls.
+ */
+class PollableEvent
+{
+public:
+    PollableEvent()
+        : _is_signalled(false)
+    {
+        _fd[0] = _fd[1] = -1;
+    }
+
+    ~PollableEvent()
+    {
+        release();
+    }
+
+    // Returns false if the platform has no such descriptor
+    bool open()
+    {
+        if (_fd[0] != -1) return true;
+#if defined(__linux__)
+        _fd[0] = _fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        return _fd[0] != -1;
+#elif !defined(_WIN32)
+        if (pipe(_fd) == -1) {
+            _fd[0] = _fd[1] = -1;
+            return false;
+        }
+        for (int pos = 0; pos < 2; ++pos) {
+            fcntl(_fd[pos], F_SETFL, fcntl(_fd[pos], F_GETFL) | O_NONBLOCK);
+            fcntl(_fd[pos], F_SETFD, FD_CLOEXEC);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // -1 until opened
+    int getHandle() const
+    {
+        return _fd[0];
+    }
+
+    void set(bool isSignal = true)
+    {
+        if (_fd[0] == -1 || isSignal == _is_signalled) return;
+        _is_signalled = isSignal;
+#if !defined(_WIN32)
+        if (isSignal) {
+            _u64 value = 1;
+            ssize_t ans = ::write(_fd[1], &value, sizeof(value));
+            (void)ans;
+        }
+        else {
+            // drain the descriptor so it is no longer readable
+            _u64 value[8];
+            while (::read(_fd[0], value, sizeof(value)) > 0);
+        }
+#endif
+    }
+
+protected:
+    void release()
+    {
+#if !defined(_WIN32)
+        if (_fd[0] != -1) ::close(_fd[0]);
+        if (_fd[1] != -1 && _fd[1] != _fd[0]) ::close(_fd[1]);
+#endif
+        _fd[0] = _fd[1] = -1;
+    }
+
+    int     _fd[2];     // read and write ends, the same eventfd on Linux
+    bool    _is_signalled;
+};
+}}
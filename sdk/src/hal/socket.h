@@ -90,6 +90,21 @@ public:
 
     virtual u_result waitforSent(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT) = 0;
     virtual u_result waitforData(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT)  = 0;
+
+    // Make the pending and the following waitforData calls fail immediately, until resumeWait is called
+    // Can be called from any thread, the platforms without support keep waiting until the timeout.
+    virtual void cancelWait() {}
+    virtual void resumeWait() {}
+
+    // Size of the receive buffer of the socket (SO_RCVBUF) in bytes
+    virtual u_result setReceiveBufferSize(size_t size) { return RESULT_OPERATION_NOT_SUPPORT; }
+
+    // Keep a multishot receive outstanding on io_uring (Linux) and serve the receives from its buffers, once connected.
+    // Returns RESULT_OPERATION_NOT_SUPPORT when the platform or the kernel lacks support, the socket is then unchanged.
+    virtual u_result enableRingReceive() { return RESULT_OPERATION_NOT_SUPPORT; }
+
+    // Descriptor to poll for the incoming data, the io_uring one while the ring receive is active. -1 if there is none
+    virtual int getPollHandle() { return -1; }
 protected:
     SocketBase() {} 
 };
@@ -114,6 +129,15 @@ public:
     virtual u_result send(const void * buffer, size_t len) = 0;
     
     virtual u_result recv(void *buf, size_t len, size_t & recv_len) = 0;
+
+    // Receive what the socket already holds, up to len bytes, without blocking
+    // Returns RESULT_OPERATION_TIMEOUT when nothing is pending, RESULT_OK with a zero recv_len once the peer has closed.
+    virtual u_result recvNoWait(void *buf, size_t len, size_t & recv_len)
+    {
+        recv_len = 0;
+        if (waitforData(0) != RESULT_OK) return RESULT_OPERATION_TIMEOUT;
+        return recv(buf, len, recv_len);
+    }
     
     virtual u_result getPeerAddress(SocketAddress & ) = 0;
 
@@ -133,6 +157,17 @@ class _single_thread DGramSocket: public SocketBase
 
 public:
 
+    // One datagram of recvBatch
+    struct Datagram {
+        void *  buf;
+        size_t  len;
+        // filled by recvBatch
+        size_t  recv_len;
+        bool    truncated;      // the datagram was longer than len, its tail is lost
+        _u32    drops;          // datagrams dropped by the socket since its creation, 0 if the platform does not tell
+        _u64    timestamp_us;   // time the datagram was received, on the clock of getus(), 0 if the platform does not tell
+    };
+
     static DGramSocket * CreateSocket(socket_family_t family = SOCKET_FAMILY_INET);
         
     virtual u_result setPairAddress(const SocketAddress* pairAddress) = 0;
@@ -141,6 +176,23 @@ public:
    
     virtual u_result recvFrom(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr = NULL) = 0;
     virtual u_result clearRxCache() = 0;
+
+    // Receive the datagrams already queued by the socket, up to count of them, without blocking
+    // The platforms without a batched receive get one recvFrom per datagram, with no truncation nor drop detection.
+    virtual u_result recvBatch(Datagram * datagrams, size_t count, size_t & received)
+    {
+        received = 0;
+        while (received < count && waitforData(0) == RESULT_OK) {
+            Datagram & dgram = datagrams[received];
+            u_result ans = recvFrom(dgram.buf, dgram.len, dgram.recv_len);
+            if (IS_FAIL(ans)) return received ? RESULT_OK : ans;
+            dgram.truncated = false;
+            dgram.drops = 0;
+            dgram.timestamp_us = 0;
+            ++received;
+        }
+        return RESULT_OK;
+    }
     
 protected:
     virtual ~DGramSocket() {} // use dispose();
@@ -38,9 +38,15 @@
 #include "hal/locker.h"
 #include "hal/socket.h"
 #include "hal/event.h"
+#include "hal/pollable_event.h"
 #include "sl_lidar_driver.h"
 #include "sl_crc.h" 
+#include "sl_lidar_stats.h"
+#include "sl_lidar_profile_cache.h"
+#include "sl_lidar_trace.h"
+#include "sl_lidar_reactor.h"
 #include <algorithm>
+#include <math.h>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -207,7 +213,87 @@ namespace sl {
         return SL_RESULT_OK;
     }
 
-    class SlamtecLidarDriver :public ILidarDriver
+    // A request without answer handed over to the capture thread, which owns the channel while scanning
+    // It lives on the stack of the requesting thread until the capture thread has written it or it was withdrawn.
+    struct PendingRequest
+    {
+        sl_u16              cmd;
+        const void*         payload;
+        size_t              payload_size;
+        sl_result           result;
+        bool                done;
+        PendingRequest*     next;
+        rp::hal::Event      done_evt;
+
+        PendingRequest(sl_u16 requestCmd, const void* requestPayload, size_t requestPayloadSize)
+            : cmd(requestCmd), payload(requestPayload), payload_size(requestPayloadSize)
+            , result(SL_RESULT_OPERATION_TIMEOUT), done(false), next(NULL)
+        {}
+    };
+
+    struct SafetyZoneRange
+    {
+        // distance range (in q2 millimeters) covered by the zone, empty if far_q2 is 0
+        sl_u32 near_q2;
+        sl_u32 far_q2;
+    };
+
+    // Precompute the distance range covered by a safety zone along the center ray of each angular bin
+    static void buildSafetyZoneRanges(const LidarSafetyZone& zone, SafetyZoneRange* ranges, size_t binCount)
+    {
+        for (size_t bin = 0; bin < binCount; ++bin) {
+            float angle = (bin + 0.5f) * 360.f / binCount;
+            ranges[bin].near_q2 = 0;
+            ranges[bin].far_q2 = 0;
+
+            if (zone.type == SafetyZoneSector) {
+                bool inside;
+                if (zone.start_angle <= zone.end_angle)
+                    inside = (angle >= zone.start_angle && angle < zone.end_angle);
+                else
+                    inside = (angle >= zone.start_angle || angle < zone.end_angle);
+
+                if (inside) {
+                    ranges[bin].near_q2 = (sl_u32)(zone.min_distance * 4);
+                    ranges[bin].far_q2 = (sl_u32)(zone.max_distance * 4);
+                }
+            }
+            else {
+                // intersect the ray with every edge of the polygon, the zone covers the ray
+                // from its first entry to its last exit (exact for star-shaped polygons)
+                float rad = angle * 3.1415926f / 180.f;
+                float dx = cosf(rad);
+                float dy = sinf(rad);
+                float nearest = -1, farthest = -1;
+                int crossings = 0;
+
+                for (size_t pos = 0; pos < zone.vertex_count; ++pos) {
+                    size_t next = (pos + 1) % zone.vertex_count;
+                    float ax = zone.vertex_x[pos], ay = zone.vertex_y[pos];
+                    float ex = zone.vertex_x[next] - ax, ey = zone.vertex_y[next] - ay;
+
+                    float denom = dx * ey - dy * ex;
+                    if (fabsf(denom) < 1e-6f) continue; // parallel to the edge
+
+                    float t = (ax * ey - ay * ex) / denom;
+                    float u = (ax * dy - ay * dx) / denom;
+                    if (t < 0 || u < 0 || u >= 1) continue;
+
+                    ++crossings;
+                    if (nearest < 0 || t < nearest) nearest = t;
+                    if (t > farthest) farthest = t;
+                }
+
+                if (crossings) {
+                    // odd crossings: the lidar itself is inside the polygon
+                    ranges[bin].near_q2 = (crossings & 1) ? 0 : (sl_u32)(nearest * 4);
+                    ranges[bin].far_q2 = (sl_u32)(farthest * 4);
+                }
+            }
+        }
+    }
+
+    class SlamtecLidarDriver :public ILidarDriver, public internal::IReactorClient
     {
     public:
         enum {
@@ -224,6 +310,66 @@ namespace sl {
             TOF_LIDAR_MINUM_MAJOR_ID = 6,
         };
 
+        enum {
+            MAX_SECTOR_SPAN = 180,
+        };
+
+        enum {
+            SAFETY_ZONE_BIN_SHIFT = 6,
+            SAFETY_ZONE_BINS = (65536 >> SAFETY_ZONE_BIN_SHIFT), // angle_z_q14 covers 360 degree in 65536 steps
+        };
+
+        enum {
+            // GET_LIDAR_CONF requests written back-to-back before waiting for the first answer
+            CONF_PIPELINE_DEPTH = 4,
+            // the payload size of a request is sent in a single byte
+            MAX_CMD_PAYLOAD_SIZE = 255,
+        };
+
+        enum {
+            // USB-serial bridges may hold received bytes for up to 16ms before passing them on
+            STOP_DRAIN_QUIET_TIME = 20,
+            STOP_DRAIN_MAX_TIME = 100,
+        };
+
+        enum {
+            // the measurement stream is considered alive while capsules keep arriving within this duration (in ms)
+            HEALTH_STREAM_ALIVE_TIME = 1000,
+        };
+
+        enum {
+            // stall timeout in capsule intervals, and its lower bound (in ms) covering the latency of USB serial bridges
+            DEFAULT_STALL_INTERVAL_MULTIPLE = 8,
+            DEFAULT_STALL_MIN_TIMEOUT = 20,
+        };
+
+        enum {
+            // a negotiated baudrate measured further than this from the requested one is rejected (in percent)
+            BAUD_MAX_BPS_ERROR = 5,
+            // scan burst measuring the loss rate at a candidate baudrate, and the time left to the motor to spin up before it (in ms)
+            BAUD_BURST_TIME = 1000,
+            BAUD_SPINUP_TIMEOUT = 3000,
+        };
+
+        enum {
+            // first reconnection delay of the link supervision, doubled after each failed attempt (in ms)
+            LINK_MIN_BACKOFF = 100,
+            // a reopened channel answering slower than this (in ms) is considered still down
+            LINK_PROBE_TIMEOUT = 500,
+        };
+
+        typedef sl_result (SlamtecLidarDriver::*CaptureJob)();
+
+        // One frame of the measurement stream, whatever the answer type of the scan
+        union CaptureFrame
+        {
+            sl_lidar_response_measurement_node_t                        node;
+            sl_lidar_response_capsule_measurement_nodes_t               capsule;
+            sl_lidar_response_hq_capsule_measurement_nodes_t            hq_capsule;
+            sl_lidar_response_ultra_capsule_measurement_nodes_t         ultra_capsule;
+            sl_lidar_response_ultra_dense_capsule_measurement_nodes_t   ultra_dense_capsule;
+        };
+
     public:
         SlamtecLidarDriver()
             : _channel(NULL)
@@ -234,7 +380,90 @@ namespace sl {
             , _cached_sampleduration_express(LEGACY_SAMPLE_DURATION)
             , _cached_scan_node_hq_count(0)
             , _cached_scan_node_hq_count_for_interval_retrieve(0)
-        {}
+            , _scan_accum_count(0)
+            , _scan_accum_total(0)
+            , _scan_accum_valid(0)
+            , _scan_accum_quality(0)
+            , _scan_accum_first_ts(0)
+            , _scan_accum_last_ts(0)
+            , _frame_arrival_us(0)
+            , _frame_pos(0)
+            , _frame_ts(0)
+            , _scan_checksum_errors(0)
+            , _scan_dropped_nodes(0)
+            , _scan_sequence(0)
+            , _sector_conf_span(0)
+            , _sector_span(0)
+            , _sector_sequence(0)
+            , _sector_accum_count(0)
+            , _sector_accum_index(-1)
+            , _sector_accum_complete(false)
+            , _cached_sector_node_hq_count(0)
+            , _profile_dirty(false)
+            , _listener(NULL)
+            , _safety_zone_mask(0)
+            , _safety_intruded_mask(0)
+            , _safety_hit_rotation_mask(0)
+            , _is_previous_capsuledataRdy(false)
+            , _predictive_decode_conf(false)
+            , _predictive_decode(false)
+            , _predicted_diffAngle_q8(0)
+            , _predicted_end_q8(-1)
+            , _cmd_guard_until_us(0)
+            , _conf_pipeline_disabled(false)
+            , _health_query_valid(false)
+            , _health_query_us(0)
+            , _dev_status_valid(false)
+            , _dev_status(0)
+            , _dev_status_us(0)
+            , _last_capsule_us(0)
+            , _scan_interruption_allowed(false)
+            , _request_head(NULL)
+            , _request_tail(NULL)
+            , _captureIdleEvt(false, true)
+            , _capture_job(NULL)
+            , _capture_busy(false)
+            , _capture_quit(false)
+            , _capture_reactor(NULL)
+            , _attached_reactor(NULL)
+            , _scan_job(NULL)
+            , _reactor_discard(false)
+            , _reactor_wait_start_us(0)
+            , _reactor_node_count(0)
+            , _scan_us_per_sample(LEGACY_SAMPLE_DURATION)
+            , _stall_interval_multiple(DEFAULT_STALL_INTERVAL_MULTIPLE)
+            , _stall_min_timeout(DEFAULT_STALL_MIN_TIMEOUT)
+            , _watchdog_last_capsule_us(0)
+            , _scan_cmd(SL_LIDAR_CMD_SCAN)
+            , _scan_ans_type(SL_LIDAR_ANS_TYPE_MEASUREMENT)
+            , _scan_link_downtime_ms(0)
+            , _motor_cmd(0)
+            , _auto_reconnect(false)
+            , _link_loss_timeout(0)
+            , _link_max_backoff(LINK_MIN_BACKOFF)
+        {
+            memset(&_health_query, 0, sizeof(_health_query));
+            memset(&_watchdog, 0, sizeof(_watchdog));
+            memset(&_scan_req, 0, sizeof(_scan_req));
+            memset(&_motor_payload, 0, sizeof(_motor_payload));
+            memset(&_cached_scan_header, 0, sizeof(_cached_scan_header));
+            memset(&_cached_sector, 0, sizeof(_cached_sector));
+            memset(_safety_zone_bin_mask, 0, sizeof(_safety_zone_bin_mask));
+            memset(_safety_hit_run, 0, sizeof(_safety_hit_run));
+            memset(_safety_clear_rotations, 0, sizeof(_safety_clear_rotations));
+        }
+
+        ~SlamtecLidarDriver()
+        {
+            _stopCapture();
+            _storeDeviceProfile();
+            {
+                rp::hal::AutoLocker l(_capture_lock);
+                _capture_quit = true;
+            }
+            _captureJobEvt.set();
+            _cachethread.join();
+        }
 
         sl_result connect(IChannel* channel)
         {
@@ -254,16 +483,44 @@ namespace sl {
             }
      
             _isConnected = true;
+            _conf_pipeline_disabled = false;
+            _resetDeviceProfile();
+            _loadDeviceProfile();
+            _resetHealthStatus();
 
             ans =checkMotorCtrlSupport(_isSupportingMotorCtrl,500);
             return SL_RESULT_OK;
         
         }
 
+        // Single device info request on a channel, without the bring-up done by connect (see probeSerialLidars)
+        sl_result probeDeviceInfo(IChannel* channel, sl_lidar_response_device_info_t& devinfo, sl_u32 timeout)
+        {
+            if (!channel->open()) return SL_RESULT_OPERATION_FAIL;
+
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            {
+                rp::hal::AutoLocker l(_lock);
+                _channel = channel;
+                // the lidar ignores any other request while it is scanning
+                ans = _sendCommand(SL_LIDAR_CMD_STOP);
+                if (ans) {
+                    _drainUntilQuiet(STOP_DRAIN_QUIET_TIME, STOP_DRAIN_MAX_TIME);
+                    ans = _sendCommand(SL_LIDAR_CMD_GET_DEVICE_INFO);
+                }
+                if (ans) ans = _waitResponse(devinfo, SL_LIDAR_ANS_TYPE_DEVINFO, timeout);
+                _channel = NULL;
+            }
+            channel->close();
+            return ans;
+        }
+
         void disconnect()
         {
             if (_isConnected)
                 _channel->close();
+            _storeDeviceProfile();
+            _resetDeviceProfile();
         }
 
         bool isConnected()
@@ -274,6 +531,8 @@ namespace sl {
         sl_result reset(sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
+            // the lidar stops measuring on reset, the capture thread would only wait for data in vain
+            if (_isScanning) _disableDataGrabbing();
             {
                 rp::hal::AutoLocker l(_lock);
                 ans = _sendCommand(SL_LIDAR_CMD_RESET);
@@ -281,59 +540,97 @@ namespace sl {
                     return ans;
                 }
             }
+            _resetDeviceProfile();
             return SL_RESULT_OK;
         }
 
         sl_result getAllSupportedScanModes(std::vector<LidarScanMode>& outModes, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.scan_modes_valid) {
+                    outModes.insert(outModes.end(), _profile.scan_modes.begin(), _profile.scan_modes.end());
+                    return SL_RESULT_OK;
+                }
+            }
+
             bool confProtocolSupported = false;
             ans = checkSupportConfigCommands(confProtocolSupported);
             if (!ans) return SL_RESULT_INVALID_DATA;
 
+            std::vector<LidarScanMode> modes;
             if (confProtocolSupported) {
                 // 1. get scan mode count
                 sl_u16 modeCount;
                 ans = getScanModeCount(modeCount);
                 if (!ans) return ans;
-                // 2. for loop to get all fields of each scan mode
+                // 2. query all fields of all scan modes in one batch
+                std::vector<LidarConfQuery> queries;
                 for (sl_u16 i = 0; i < modeCount; i++) {
+                    queries.push_back(LidarConfQuery(SL_LIDAR_CONF_SCAN_MODE_US_PER_SAMPLE, i));
+                    queries.push_back(LidarConfQuery(SL_LIDAR_CONF_SCAN_MODE_MAX_DISTANCE, i));
+                    queries.push_back(LidarConfQuery(SL_LIDAR_CONF_SCAN_MODE_ANS_TYPE, i));
+                    queries.push_back(LidarConfQuery(SL_LIDAR_CONF_SCAN_MODE_NAME, i));
+                }
+                if (!queries.empty()) {
+                    ans = getLidarConfBatch(&queries[0], queries.size(), timeoutInMs);
+                    if (!ans) return ans;
+                }
+
+                for (sl_u16 i = 0; i < modeCount; i++) {
+                    const LidarConfQuery* modeQueries = &queries[i * 4];
                     LidarScanMode scanModeInfoTmp;
                     memset(&scanModeInfoTmp, 0, sizeof(scanModeInfoTmp));
                     scanModeInfoTmp.id = i;
-                    ans = getLidarSampleDuration(scanModeInfoTmp.us_per_sample, i);
+                    ans = _decodeConfQ8(modeQueries[0].answer, modeQueries[0].answer_size, scanModeInfoTmp.us_per_sample);
                     if (!ans) return ans;
-                    ans = getMaxDistance(scanModeInfoTmp.max_distance, i);
+                    ans = _decodeConfQ8(modeQueries[1].answer, modeQueries[1].answer_size, scanModeInfoTmp.max_distance);
                     if (!ans) return ans;
-                    ans = getScanModeAnsType(scanModeInfoTmp.ans_type, i);
+                    ans = _decodeConfAnsType(modeQueries[2].answer, modeQueries[2].answer_size, scanModeInfoTmp.ans_type);
                     if (!ans) return ans;
-                    ans = getScanModeName(scanModeInfoTmp.scan_mode, i);
+                    ans = _decodeConfModeName(modeQueries[3].answer, modeQueries[3].answer_size, scanModeInfoTmp.scan_mode);
                     if (!ans) return ans;
-                    outModes.push_back(scanModeInfoTmp);
+                    modes.push_back(scanModeInfoTmp);
 
                 }
-                return ans;
             }
 
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.scan_modes = modes;
+                _profile.scan_modes_valid = true;
+                _profile_dirty = true;
+            }
+            outModes.insert(outModes.end(), modes.begin(), modes.end());
             return ans;        
         }
 
         sl_result getTypicalScanMode(sl_u16& outMode, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> answer;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.typical_mode_valid) {
+                    outMode = _profile.typical_mode;
+                    return SL_RESULT_OK;
+                }
+            }
+
             bool lidarSupportConfigCmds = false;
             ans = checkSupportConfigCommands(lidarSupportConfigCmds);
             if (!ans) return ans;
 
             if (lidarSupportConfigCmds) {
-                ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_TYPICAL, answer, std::vector<sl_u8>(), timeoutInMs);
+                ans = _getLidarConfValue(SL_LIDAR_CONF_SCAN_MODE_TYPICAL, outMode, 0, timeoutInMs);
                 if (!ans) return ans;
-                if (answer.size() < sizeof(sl_u16)) {
-                    return SL_RESULT_INVALID_DATA;
+
+                {
+                    rp::hal::AutoLocker l(_profile_lock);
+                    _profile.typical_mode = outMode;
+                    _profile.typical_mode_valid = true;
+                    _profile_dirty = true;
                 }
-                const sl_u16 *p_answer = reinterpret_cast<const sl_u16*>(&answer[0]);
-                outMode = *p_answer;
                 return ans;
             }
             //old version of triangle lidar
@@ -364,14 +661,7 @@ namespace sl {
             // 'useTypicalScan' is false, just use normal scan mode
             if (ifSupportLidarConf) {
                 if (outUsedScanMode) {
-                    outUsedScanMode->id = SL_LIDAR_CONF_SCAN_COMMAND_STD;
-                    ans = getLidarSampleDuration(outUsedScanMode->us_per_sample, outUsedScanMode->id);
-                    if (!ans) return ans;
-                    ans = getMaxDistance(outUsedScanMode->max_distance, outUsedScanMode->id);
-                    if (!ans) return ans;
-                    ans = getScanModeAnsType(outUsedScanMode->ans_type, outUsedScanMode->id);
-                    if (!ans) return ans;
-                    ans = getScanModeName(outUsedScanMode->scan_mode, outUsedScanMode->id);
+                    ans = _getScanModeInfo(SL_LIDAR_CONF_SCAN_COMMAND_STD, *outUsedScanMode);
                     if (!ans) return ans;
                 }
             }
@@ -387,30 +677,24 @@ namespace sl {
 
             stop(); //force the previous operation to stop
             setMotorSpeed();
+            _scan_us_per_sample = _cached_sampleduration_std;
             {
                 rp::hal::AutoLocker l(_lock);
-                ans = _sendCommand(force ? SL_LIDAR_CMD_FORCE_SCAN : SL_LIDAR_CMD_SCAN);
-                if (!ans) return ans;
-                // waiting for confirmation
-                sl_lidar_ans_header_t response_header;
-                ans = _waitResponseHeader(&response_header, timeout);
-                if (!ans) return ans;
+                _scan_cmd = force ? SL_LIDAR_CMD_FORCE_SCAN : SL_LIDAR_CMD_SCAN;
+                _scan_ans_type = SL_LIDAR_ANS_TYPE_MEASUREMENT;
 
-                // verify whether we got a correct header
-                if (response_header.type != SL_LIDAR_ANS_TYPE_MEASUREMENT) {
-                    return SL_RESULT_INVALID_DATA;
-                }
-
-                sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
-                if (header_size < sizeof(sl_lidar_response_measurement_node_t)) {
-                    return SL_RESULT_INVALID_DATA;
-                }
+                CaptureJob job;
+                ans = _requestScan(job, timeout);
+                if (!ans) return ans;
                 _isScanning = true;
-                _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheScanData);
-                if (_cachethread.getHandle() == 0) {
-                    return SL_RESULT_OPERATION_FAIL;
+                ans = _startCapture(job);
+                if (!ans) {
+                    _isScanning = false;
+                    return ans;
                 }
             }
+            // the bring-up is over, the device profile is complete
+            _storeDeviceProfile();
             return SL_RESULT_OK;
         }
 
@@ -426,30 +710,23 @@ namespace sl {
             if (!ans) return SL_RESULT_INVALID_DATA;
 
 
-            if (outUsedScanMode) {
-                outUsedScanMode->id = scanMode;
-                if (ifSupportLidarConf) {
-                    ans = getLidarSampleDuration(outUsedScanMode->us_per_sample, outUsedScanMode->id);
-                    if (!ans) return SL_RESULT_INVALID_DATA;
-
-                    ans = getMaxDistance(outUsedScanMode->max_distance, outUsedScanMode->id);
-                    if (!ans) return SL_RESULT_INVALID_DATA;
-
-                    ans = getScanModeAnsType(outUsedScanMode->ans_type, outUsedScanMode->id);
-                    if (!ans) return SL_RESULT_INVALID_DATA;
-
-                    ans = getScanModeName(outUsedScanMode->scan_mode, outUsedScanMode->id);
-                    if (!ans) return SL_RESULT_INVALID_DATA;
-
-
-                }
+            LidarScanMode scanModeInfo;
+            if (ifSupportLidarConf) {
+                ans = _getScanModeInfo(scanMode, scanModeInfo);
+                if (!ans) return SL_RESULT_INVALID_DATA;
+            }
 
+            if (outUsedScanMode) {
+                if (ifSupportLidarConf)
+                    *outUsedScanMode = scanModeInfo;
+                else
+                    outUsedScanMode->id = scanMode;
             }
 
             //get scan answer type to specify how to wait data
             sl_u8 scanAnsType = 0;
             if (ifSupportLidarConf) {
-                getScanModeAnsType(scanAnsType, scanMode);
+                scanAnsType = scanModeInfo.ans_type;
             }
             else {
                 scanAnsType = SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
@@ -459,6 +736,7 @@ namespace sl {
                     return startScan(force, false, 0, outUsedScanMode);
                 }
             }
+            _scan_us_per_sample = ifSupportLidarConf ? scanModeInfo.us_per_sample : _cached_sampleduration_express;
             {
                 rp::hal::AutoLocker l(_lock);
 
@@ -472,70 +750,22 @@ namespace sl {
                     scanReq.working_mode = sl_u8(scanMode);
 
                 scanReq.working_flags = options;
-				delay(5);
-                ans = _sendCommand(SL_LIDAR_CMD_EXPRESS_SCAN, &scanReq, sizeof(scanReq));
-                if (!ans) { 
-                    ans = _sendCommand(SL_LIDAR_CMD_EXPRESS_SCAN, &scanReq, sizeof(scanReq));
-                    if (!ans)
-                        return SL_RESULT_INVALID_DATA; 
-                }
-     
+                _scan_cmd = SL_LIDAR_CMD_EXPRESS_SCAN;
+                _scan_req = scanReq;
+                _scan_ans_type = scanAnsType;
 
-                // waiting for confirmation
-                sl_lidar_ans_header_t response_header;
-                ans = _waitResponseHeader(&response_header, timeout);
+                CaptureJob job;
+                ans = _requestScan(job, timeout);
                 if (!ans) return ans;
-
-                // verify whether we got a correct header
-                if (response_header.type != scanAnsType) {
-                    return SL_RESULT_INVALID_DATA;
-                }
-
-                sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
-
-                if (scanAnsType == SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED) {
-                    if (header_size < sizeof(sl_lidar_response_capsule_measurement_nodes_t)) {
-                        return SL_RESULT_INVALID_DATA;
-                    }
-                    _cached_capsule_flag = NORMAL_CAPSULE;
-                    _isScanning = true;
-                    _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheCapsuledScanData);
-                }
-                else if (scanAnsType == SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED) {
-                    if (header_size < sizeof(sl_lidar_response_capsule_measurement_nodes_t)) {
-                        return SL_RESULT_INVALID_DATA;
-                    }
-                    _cached_capsule_flag = DENSE_CAPSULE;
-                    _isScanning = true;
-                    _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheCapsuledScanData);
-                }
-                else if (scanAnsType == SL_LIDAR_ANS_TYPE_MEASUREMENT_HQ) {
-                    if (header_size < sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t)) {
-                        return SL_RESULT_INVALID_DATA;
-                    }
-                    _isScanning = true;
-                    _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheHqScanData);
-                }
-                else if (scanAnsType == SL_LIDAR_ANS_TYPE_MEASUREMENTT_ULTRA_DENSE_CAPSULED) {
-                    if (header_size < sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t)) {
-                        return SL_RESULT_INVALID_DATA;
-                    }
-                    _isScanning = true;
-                    _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheUltraDenseCapsuledScanData);
-                    
-                }
-                else {
-                    if (header_size < sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t)) {
-                        return SL_RESULT_INVALID_DATA;
-                    }
-                    _isScanning = true;
-                    _cachethread = CLASS_THREAD(SlamtecLidarDriver, _cacheUltraCapsuledScanData);
-                }
-
-                if (_cachethread.getHandle() == 0) {
-                    return SL_RESULT_OPERATION_FAIL;
+                _isScanning = true;
+                ans = _startCapture(job);
+                if (!ans) {
+                    _isScanning = false;
+                    return ans;
                 }
             }
+            // the bring-up is over, the device profile is complete
+            _storeDeviceProfile();
             return SL_RESULT_OK;
 
         }
@@ -543,14 +773,15 @@ namespace sl {
         sl_result stop(sl_u32 timeout = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
+            bool wasScanning = _isScanning;
             _disableDataGrabbing();
 
             {
                 rp::hal::AutoLocker l(_lock);
                 ans = _sendCommand(SL_LIDAR_CMD_STOP);
                 if (!ans) return ans;
+                if (wasScanning) _drainUntilQuiet(STOP_DRAIN_QUIET_TIME, STOP_DRAIN_MAX_TIME);
             }
-            delay(100);
 
             if(_isSupportingMotorCtrl == MotorCtrlSupportPwm)
                 setMotorSpeed(0);
@@ -560,7 +791,39 @@ namespace sl {
        
         sl_result grabScanDataHq(sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
-            switch (_dataEvt.wait(timeout))
+            unsigned long waitResult = _dataEvt.wait(timeout);
+            SL_TRACE_INSTANT(TRACE_GRAB_WAKEUP, waitResult);
+            switch (waitResult)
+            {
+            case rp::hal::Event::EVENT_TIMEOUT:
+                count = 0;
+                return SL_RESULT_OPERATION_TIMEOUT;
+            case rp::hal::Event::EVENT_OK:
+            {
+                if (_cached_scan_node_hq_count == 0) return SL_RESULT_OPERATION_TIMEOUT; //consider as timeout
+
+                rp::hal::AutoLocker l(_lock);
+
+                size_t size_to_copy = std::min(count, _cached_scan_node_hq_count);
+                memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(sl_lidar_response_measurement_node_hq_t));
+
+                count = size_to_copy;
+                _cached_scan_node_hq_count = 0;
+                _updateReadyEvt();
+            }
+            return SL_RESULT_OK;
+
+            default:
+                count = 0;
+                return SL_RESULT_OPERATION_FAIL;
+            }
+        }
+
+        sl_result grabScanDataHqWithHeader(LidarScanHeader& header, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            unsigned long waitResult = _dataEvt.wait(timeout);
+            SL_TRACE_INSTANT(TRACE_GRAB_WAKEUP, waitResult);
+            switch (waitResult)
             {
             case rp::hal::Event::EVENT_TIMEOUT:
                 count = 0;
@@ -574,8 +837,10 @@ namespace sl {
                 size_t size_to_copy = std::min(count, _cached_scan_node_hq_count);
                 memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(sl_lidar_response_measurement_node_hq_t));
 
+                header = _cached_scan_header;
                 count = size_to_copy;
                 _cached_scan_node_hq_count = 0;
+                _updateReadyEvt();
             }
             return SL_RESULT_OK;
 
@@ -588,21 +853,45 @@ namespace sl {
         sl_result getDeviceInfo(sl_lidar_response_device_info_t& info, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
-            _disableDataGrabbing();
-			delay(20);
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.devinfo_valid) {
+                    info = _profile.devinfo;
+                    return SL_RESULT_OK;
+                }
+            }
+
+            ans = _prepareActiveRequest();
+            if (!ans) return ans;
             {
                 rp::hal::AutoLocker l(_lock);
                 ans = _sendCommand(SL_LIDAR_CMD_GET_DEVICE_INFO);
                 if (!ans) return ans;
-                return _waitResponse(info, SL_LIDAR_ANS_TYPE_DEVINFO);
-            }           
+                ans = _waitResponse(info, SL_LIDAR_ANS_TYPE_DEVINFO, timeout);
+                if (!ans) return ans;
+            }
+
+            rp::hal::AutoLocker l(_profile_lock);
+            _profile.devinfo = info;
+            _profile.devinfo_valid = true;
+            _profile_dirty = true;
+            return SL_RESULT_OK;
         }
 
         sl_result checkMotorCtrlSupport(MotorCtrlSupport & support, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
             support = MotorCtrlSupportNone;
-            _disableDataGrabbing();
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.motor_ctrl_valid) {
+                    support = _profile.motor_ctrl;
+                    return SL_RESULT_OK;
+                }
+            }
+
+            ans = _prepareActiveRequest();
+            if (!ans) return ans;
             {
                 sl_lidar_response_device_info_t devInfo;
                 ans = getDeviceInfo(devInfo, 500);
@@ -610,7 +899,6 @@ namespace sl {
                 sl_u8 majorId = devInfo.model >> 4;
                 if (majorId >= TOF_LIDAR_MINUM_MAJOR_ID) {
                         support = MotorCtrlSupportRpm;
-                        return ans;
                 }
                 else if(majorId >= A2A3_LIDAR_MINUM_MAJOR_ID){
 
@@ -622,13 +910,20 @@ namespace sl {
 
                     sl_lidar_response_acc_board_flag_t acc_board_flag;
                     ans = _waitResponse(acc_board_flag, SL_LIDAR_ANS_TYPE_ACC_BOARD_FLAG);
+                    if (!ans) return ans;
                     if (acc_board_flag.support_flag & SL_LIDAR_RESP_ACC_BOARD_FLAG_MOTOR_CTRL_SUPPORT_MASK) {
                         support = MotorCtrlSupportPwm;
                     }
-                    return ans;
                 }
 
             }
+
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.motor_ctrl = support;
+                _profile.motor_ctrl_valid = true;
+                _profile_dirty = true;
+            }
             return SL_RESULT_OK;
 
         }
@@ -649,13 +944,25 @@ namespace sl {
         sl_result getLidarIpConf(sl_lidar_ip_conf_t& conf, sl_u32 timeout)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> reserve(2);
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.ip_conf_valid) {
+                    conf = _profile.ip_conf;
+                    return SL_RESULT_OK;
+                }
+            }
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t len = sizeof(answer);
+            ans = getLidarConf(SL_LIDAR_CONF_LIDAR_STATIC_IP_ADDR, answer, len, 0, timeout);
+            if (!ans) return ans;
+            memcpy(&conf, answer, std::min(len, sizeof(conf)));
 
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_LIDAR_STATIC_IP_ADDR, answer, reserve, timeout);
-            int len = answer.size();
-            if (0 == len) return SL_RESULT_INVALID_DATA;
-            memcpy(&conf, &answer[0], len);
+            if (len >= sizeof(conf)) {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.ip_conf = conf;
+                _profile.ip_conf_valid = true;
+                _profile_dirty = true;
+            }
             return ans;
         }
        
@@ -666,31 +973,95 @@ namespace sl {
             if (!isConnected()) 
                 return SL_RESULT_OPERATION_FAIL;
 
+            if (_isScanning && !_scan_interruption_allowed) {
+                // serve the last known health rather than stopping the measurement stream
+                LidarHealthStatus status;
+                getHealthStatus(status);
+                if (status.health_source == HealthSourceNone) return SL_RESULT_OPERATION_NOT_SUPPORT;
+                health = status.health;
+                return SL_RESULT_OK;
+            }
+
             _disableDataGrabbing();
 
             {
                 rp::hal::AutoLocker l(_lock);
                 ans = _sendCommand(SL_LIDAR_CMD_GET_DEVICE_HEALTH);
                 if (!ans) return ans;
-                delay(50);
                 ans = _waitResponse(health, SL_LIDAR_ANS_TYPE_DEVHEALTH);
-                
+                if (!ans) return ans;
             }
+
+            rp::hal::AutoLocker l(_health_lock);
+            _health_query = health;
+            _health_query_us = getus();
+            _health_query_valid = true;
             return ans;
             
         }
 
+        sl_result getHealthStatus(LidarHealthStatus& status)
+        {
+            sl_u64 now = getus();
+            memset(&status, 0, sizeof(status));
+
+            status.is_scanning = _isScanning;
+            sl_u64 lastCapsuleUs = _last_capsule_us.load(std::memory_order_relaxed);
+            status.capsule_received = (lastCapsuleUs != 0);
+            if (status.capsule_received) status.last_capsule_age_ms = _elapsedMs(lastCapsuleUs, now);
+
+            {
+                rp::hal::AutoLocker l(_health_lock);
+                status.query_valid = _health_query_valid;
+                if (_health_query_valid) {
+                    status.query_health = _health_query;
+                    status.query_age_ms = _elapsedMs(_health_query_us, now);
+                }
+                status.dev_status_valid = _dev_status_valid;
+                if (_dev_status_valid) {
+                    status.dev_status = _dev_status;
+                    status.dev_status_age_ms = _elapsedMs(_dev_status_us, now);
+                }
+            }
+
+            bool streamAlive = status.is_scanning && status.capsule_received && status.last_capsule_age_ms <= HEALTH_STREAM_ALIVE_TIME;
+            if (streamAlive && status.dev_status_valid && status.dev_status_age_ms <= HEALTH_STREAM_ALIVE_TIME) {
+                status.health.status = status.dev_status ? SL_LIDAR_STATUS_WARNING : SL_LIDAR_STATUS_OK;
+                status.health.error_code = status.dev_status;
+                status.health_source = HealthSourceStream;
+                status.health_age_ms = status.dev_status_age_ms;
+            }
+            else if (status.query_valid) {
+                status.health = status.query_health;
+                status.health_source = HealthSourceQuery;
+                status.health_age_ms = status.query_age_ms;
+            }
+            else if (streamAlive) {
+                // the lidar stops measuring in self-protection mode
+                status.health.status = SL_LIDAR_STATUS_OK;
+                status.health.error_code = 0;
+                status.health_source = HealthSourceStream;
+                status.health_age_ms = status.last_capsule_age_ms;
+            }
+            return SL_RESULT_OK;
+        }
+
+        sl_result setScanInterruptionAllowed(bool allow)
+        {
+            _scan_interruption_allowed = allow;
+            return SL_RESULT_OK;
+        }
+
 		sl_result getDeviceMacAddr(sl_u8* macAddrArray, sl_u32 timeoutInMs)
 		{
 			Result<nullptr_t> ans = SL_RESULT_OK;
 
-			std::vector<sl_u8> answer;
-			ans = getLidarConf(SL_LIDAR_CONF_LIDAR_MAC_ADDR, answer, std::vector<sl_u8>(), timeoutInMs);
+			sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+			size_t len = sizeof(answer);
+			ans = getLidarConf(SL_LIDAR_CONF_LIDAR_MAC_ADDR, answer, len, 0, timeoutInMs);
 			if (!ans) return ans;
 
-			int len = answer.size();
-			if (0 == len) return SL_RESULT_INVALID_DATA;
-			memcpy(macAddrArray, &answer[0], len);
+			memcpy(macAddrArray, answer, len);
 			return ans;
 		}
 
@@ -716,76 +1087,355 @@ namespace sl {
 
             return SL_RESULT_OK;
         }
-        sl_result setMotorSpeed(sl_u16 speed = DEFAULT_MOTOR_SPEED)
+
+        sl_result setSectorPublishMode(float sectorSpan)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            
-            if(speed == DEFAULT_MOTOR_SPEED){
-                sl_lidar_response_desired_rot_speed_t desired_speed;
-                ans = getDesiredSpeed(desired_speed);
-                if (!ans) return ans;
-                if(_isSupportingMotorCtrl == MotorCtrlSupportPwm)
-                    speed = desired_speed.pwm_ref;
-                else
-                    speed = desired_speed.rpm;
-            }
-            switch (_isSupportingMotorCtrl)
-            {
-            case MotorCtrlSupportNone:
-                if (_channel->getChannelType() == CHANNEL_TYPE_SERIALPORT) {
-                    ISerialPortChannel* serialChanel = (ISerialPortChannel*)_channel;
-                    if (!speed) {
-                        serialChanel->setDTR(true);
-                    }else{
-                        serialChanel->setDTR(false);
-                    }
-                }
-                break;
-            case MotorCtrlSupportPwm:
-                sl_lidar_payload_motor_pwm_t motor_pwm;
-                motor_pwm.pwm_value = speed;
-                ans = _sendCommand(SL_LIDAR_CMD_SET_MOTOR_PWM, (const sl_u8 *)&motor_pwm, sizeof(motor_pwm));
-                if (!ans) return ans;
-                break;
-            case MotorCtrlSupportRpm:
-                sl_lidar_payload_motor_pwm_t motor_rpm;
-                motor_rpm.pwm_value = speed;
-                ans = _sendCommand(SL_LIDAR_CMD_HQ_MOTOR_SPEED_CTRL, (const sl_u8 *)&motor_rpm, sizeof(motor_rpm));
-                if (!ans) return ans;
-                break;
-            }
+            if (sectorSpan < 0 || sectorSpan > MAX_SECTOR_SPAN)
+                return SL_RESULT_INVALID_DATA;
+
+            rp::hal::AutoLocker l(_lock);
+            _sector_conf_span = sectorSpan;
             return SL_RESULT_OK;
         }
 
-        sl_result getMotorInfo(LidarMotorInfo &motorInfo, sl_u32 timeoutInMs)
+        sl_result setPredictiveCapsuleDecode(bool enable)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
             rp::hal::AutoLocker l(_lock);
+            _predictive_decode_conf = enable;
+            return SL_RESULT_OK;
+        }
+
+        sl_result setDeviceProfileCache(const char* cacheDir)
+        {
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile_cache_dir = cacheDir ? cacheDir : "";
+                _profile_dirty = true;
+            }
+            // persist what this connection already learned
+            _storeDeviceProfile();
+            return SL_RESULT_OK;
+        }
+
+        sl_result setAutoReconnect(bool enable, sl_u32 linkLossTimeoutMs, sl_u32 maxBackoffMs)
+        {
+            if (maxBackoffMs < LINK_MIN_BACKOFF) maxBackoffMs = LINK_MIN_BACKOFF;
+            _link_loss_timeout = linkLossTimeoutMs;
+            _link_max_backoff = maxBackoffMs;
+            _auto_reconnect = enable;
+            return SL_RESULT_OK;
+        }
+
+        sl_result setStallDetection(float intervalMultiple, sl_u32 minTimeoutMs)
+        {
+            if (intervalMultiple < 0) return SL_RESULT_INVALID_DATA;
+
+            rp::hal::AutoLocker l(_watchdog_lock);
+            _stall_interval_multiple = intervalMultiple;
+            _stall_min_timeout = minTimeoutMs;
+            return SL_RESULT_OK;
+        }
+
+        sl_result getWatchdogState(LidarWatchdogState& state)
+        {
+            rp::hal::AutoLocker l(_watchdog_lock);
+            state = _watchdog;
+            return SL_RESULT_OK;
+        }
+
+        sl_result getStats(LidarDriverStats& stats)
+        {
+            _stats.snapshot(stats);
+            return SL_RESULT_OK;
+        }
+
+        sl_result getStatsText(std::string& text)
+        {
+            LidarDriverStats driverStats;
+            ChannelStats channelStats;
+            _stats.snapshot(driverStats);
+
+            bool hasChannelStats = (_channel && SL_IS_OK(_channel->getStats(channelStats)));
+            text = internal::formatPrometheusStats(driverStats, hasChannelStats ? &channelStats : NULL);
+            return SL_RESULT_OK;
+        }
+
+        sl_result setEventListener(ILidarEventListener* listener)
+        {
+            rp::hal::AutoLocker l(_listener_lock);
+            _listener = listener;
+            return SL_RESULT_OK;
+        }
+
+        // The callbacks are invoked on the returned pointer once _listener_lock is released, so that they can change the listener
+        ILidarEventListener* _currentListener()
+        {
+            rp::hal::AutoLocker l(_listener_lock);
+            return _listener;
+        }
+
+        sl_result setCaptureReactor(ILidarReactor* reactor)
+        {
+            internal::LidarReactor* lidarReactor = NULL;
+            if (reactor) {
+                // only the reactors of createLidarReactor can drive the capture
+                lidarReactor = dynamic_cast<internal::LidarReactor*>(reactor);
+                if (!lidarReactor) return SL_RESULT_INVALID_DATA;
+            }
+            rp::hal::AutoLocker l(_capture_lock);
+            _capture_reactor = lidarReactor;
+            return SL_RESULT_OK;
+        }
+
+        sl_result setSafetyZone(int zoneId, const LidarSafetyZone& zone)
+        {
+            if (zoneId < 0 || zoneId >= MAX_SAFETY_ZONES)
+                return SL_RESULT_INVALID_DATA;
+
+            switch (zone.type) {
+            case SafetyZoneSector:
+                if (zone.start_angle < 0 || zone.start_angle > 360 || zone.end_angle < 0 || zone.end_angle > 360)
+                    return SL_RESULT_INVALID_DATA;
+                if (zone.min_distance < 0 || zone.max_distance <= zone.min_distance)
+                    return SL_RESULT_INVALID_DATA;
+                break;
+            case SafetyZonePolygon:
+                if (zone.vertex_count < 3 || zone.vertex_count > LidarSafetyZone::MAX_VERTICES)
+                    return SL_RESULT_INVALID_DATA;
+                break;
+            default:
+                return SL_RESULT_INVALID_DATA;
+            }
+
+            rp::hal::AutoLocker l(_safety_lock);
+            sl_u32 zoneBit = (1 << zoneId);
+            _safety_zones[zoneId] = zone;
+            buildSafetyZoneRanges(zone, _safety_zone_ranges[zoneId], SAFETY_ZONE_BINS);
+            for (size_t bin = 0; bin < SAFETY_ZONE_BINS; ++bin) {
+                if (_safety_zone_ranges[zoneId][bin].far_q2)
+                    _safety_zone_bin_mask[bin] |= zoneBit;
+                else
+                    _safety_zone_bin_mask[bin] &= ~zoneBit;
+            }
+            _safety_zone_mask |= zoneBit;
+
+            // the replaced zone starts over in the released state
+            _safety_intruded_mask &= ~zoneBit;
+            _safety_hit_rotation_mask &= ~zoneBit;
+            _safety_hit_run[zoneId] = 0;
+            _safety_clear_rotations[zoneId] = 0;
+            return SL_RESULT_OK;
+        }
+
+        sl_result clearSafetyZone(int zoneId)
+        {
+            if (zoneId < 0 || zoneId >= MAX_SAFETY_ZONES)
+                return SL_RESULT_INVALID_DATA;
+
+            rp::hal::AutoLocker l(_safety_lock);
+            sl_u32 zoneBit = (1 << zoneId);
+            for (size_t bin = 0; bin < SAFETY_ZONE_BINS; ++bin) {
+                _safety_zone_bin_mask[bin] &= ~zoneBit;
+            }
+            _safety_zone_mask &= ~zoneBit;
+            _safety_intruded_mask &= ~zoneBit;
+            _safety_hit_rotation_mask &= ~zoneBit;
+            return SL_RESULT_OK;
+        }
+
+        sl_result getSafetyZoneState(sl_u32& intrudedMask)
+        {
+            rp::hal::AutoLocker l(_safety_lock);
+            intrudedMask = _safety_intruded_mask;
+            return SL_RESULT_OK;
+        }
+
+        sl_result waitSafetyZoneStateChange(sl_u32& intrudedMask, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            switch (_safetyEvt.wait(timeout))
+            {
+            case rp::hal::Event::EVENT_TIMEOUT:
+                return SL_RESULT_OPERATION_TIMEOUT;
+            case rp::hal::Event::EVENT_OK:
+                return getSafetyZoneState(intrudedMask);
+            default:
+                return SL_RESULT_OPERATION_FAIL;
+            }
+        }
+
+        sl_result grabScanSectorHq(LidarScanSector& sector, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            unsigned long waitResult = _sectorEvt.wait(timeout);
+            SL_TRACE_INSTANT(TRACE_GRAB_WAKEUP, waitResult);
+            switch (waitResult)
+            {
+            case rp::hal::Event::EVENT_TIMEOUT:
+                count = 0;
+                return SL_RESULT_OPERATION_TIMEOUT;
+            case rp::hal::Event::EVENT_OK:
             {
-                std::vector<sl_u8> answer;
+                rp::hal::AutoLocker l(_lock);
+                if (_cached_sector_node_hq_count == 0) {
+                    count = 0;
+                    return SL_RESULT_OPERATION_TIMEOUT; //consider as timeout
+                }
+
+                size_t size_to_copy = std::min(count, _cached_sector_node_hq_count);
+                memcpy(nodebuffer, _cached_sector_node_hq_buf, size_to_copy * sizeof(sl_lidar_response_measurement_node_hq_t));
+
+                sector = _cached_sector;
+                count = size_to_copy;
+                _cached_sector_node_hq_count = 0;
+                _updateReadyEvt();
+            }
+            return SL_RESULT_OK;
+
+            default:
+                count = 0;
+                return SL_RESULT_OPERATION_FAIL;
+            }
+        }
+
+        sl_result getScanReadyHandle(int& handle)
+        {
+            rp::hal::AutoLocker l(_lock);
+            if (!_readyEvt.open()) return SL_RESULT_OPERATION_NOT_SUPPORT;
+            _updateReadyEvt();
+            handle = _readyEvt.getHandle();
+            return SL_RESULT_OK;
+        }
+
+        sl_result tryGrabScanDataHq(LidarScanHeader& header, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count)
+        {
+            rp::hal::AutoLocker l(_lock);
+            if (_cached_scan_node_hq_count == 0) {
+                count = 0;
+                return SL_RESULT_OPERATION_TIMEOUT;
+            }
 
-			    ans = getLidarConf(RPLIDAR_CONF_MIN_ROT_FREQ, answer, std::vector<sl_u8>());
-			    if (!ans) return ans;
+            size_t size_to_copy = std::min(count, _cached_scan_node_hq_count);
+            memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(sl_lidar_response_measurement_node_hq_t));
 
-			    const sl_u16 *min_answer = reinterpret_cast<const sl_u16*>(&answer[0]);
-                motorInfo.min_speed = *min_answer;
+            header = _cached_scan_header;
+            count = size_to_copy;
+            _cached_scan_node_hq_count = 0;
+            // the scan is taken, a waiting grab would only wake up for nothing
+            _dataEvt.set(false);
+            _updateReadyEvt();
+            return SL_RESULT_OK;
+        }
 
+        sl_result tryGrabScanSectorHq(LidarScanSector& sector, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& count)
+        {
+            rp::hal::AutoLocker l(_lock);
+            if (_cached_sector_node_hq_count == 0) {
+                count = 0;
+                return SL_RESULT_OPERATION_TIMEOUT;
+            }
 
-                ans = getLidarConf(RPLIDAR_CONF_MAX_ROT_FREQ, answer, std::vector<sl_u8>());
-			    if (!ans) return ans;
+            size_t size_to_copy = std::min(count, _cached_sector_node_hq_count);
+            memcpy(nodebuffer, _cached_sector_node_hq_buf, size_to_copy * sizeof(sl_lidar_response_measurement_node_hq_t));
 
-			    const sl_u16 *max_answer = reinterpret_cast<const sl_u16*>(&answer[0]);
-                motorInfo.max_speed = *max_answer;
+            sector = _cached_sector;
+            count = size_to_copy;
+            _cached_sector_node_hq_count = 0;
+            _sectorEvt.set(false);
+            _updateReadyEvt();
+            return SL_RESULT_OK;
+        }
 
+        sl_result setMotorSpeed(sl_u16 speed = DEFAULT_MOTOR_SPEED)
+        {
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            
+            if(speed == DEFAULT_MOTOR_SPEED){
                 sl_lidar_response_desired_rot_speed_t desired_speed;
                 ans = getDesiredSpeed(desired_speed);
                 if (!ans) return ans;
+                if(_isSupportingMotorCtrl == MotorCtrlSupportPwm)
+                    speed = desired_speed.pwm_ref;
+                else
+                    speed = desired_speed.rpm;
+            }
+            switch (_isSupportingMotorCtrl)
+            {
+            case MotorCtrlSupportNone:
+                if (_channel->getChannelType() == CHANNEL_TYPE_SERIALPORT) {
+                    ISerialPortChannel* serialChanel = (ISerialPortChannel*)_channel;
+                    if (!speed) {
+                        serialChanel->setDTR(true);
+                    }else{
+                        serialChanel->setDTR(false);
+                    }
+                }
+                break;
+            case MotorCtrlSupportPwm:
+                sl_lidar_payload_motor_pwm_t motor_pwm;
+                motor_pwm.pwm_value = speed;
+                _motor_cmd = SL_LIDAR_CMD_SET_MOTOR_PWM;
+                _motor_payload = motor_pwm;
+                ans = _sendRequest(SL_LIDAR_CMD_SET_MOTOR_PWM, (const sl_u8 *)&motor_pwm, sizeof(motor_pwm));
+                if (!ans) return ans;
+                break;
+            case MotorCtrlSupportRpm:
+                sl_lidar_payload_motor_pwm_t motor_rpm;
+                motor_rpm.pwm_value = speed;
+                _motor_cmd = SL_LIDAR_CMD_HQ_MOTOR_SPEED_CTRL;
+                _motor_payload = motor_rpm;
+                ans = _sendRequest(SL_LIDAR_CMD_HQ_MOTOR_SPEED_CTRL, (const sl_u8 *)&motor_rpm, sizeof(motor_rpm));
+                if (!ans) return ans;
+                break;
+            }
+            return SL_RESULT_OK;
+        }
+
+        sl_result getMotorInfo(LidarMotorInfo &motorInfo, sl_u32 timeoutInMs)
+        {
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.motor_info_valid) {
+                    motorInfo = _profile.motor_info;
+                    return SL_RESULT_OK;
+                }
+            }
+            {
+                LidarConfQuery queries[] = {
+                    LidarConfQuery(RPLIDAR_CONF_MIN_ROT_FREQ),
+                    LidarConfQuery(RPLIDAR_CONF_MAX_ROT_FREQ),
+                    LidarConfQuery(SL_LIDAR_CONF_DESIRED_ROT_FREQ),
+                };
+                ans = getLidarConfBatch(queries, _countof(queries), timeoutInMs);
+                if (!ans) return ans;
+
+                if (queries[0].answer_size < sizeof(sl_u16)) return SL_RESULT_INVALID_DATA;
+                memcpy(&motorInfo.min_speed, queries[0].answer, sizeof(sl_u16));
+
+                if (queries[1].answer_size < sizeof(sl_u16)) return SL_RESULT_INVALID_DATA;
+                memcpy(&motorInfo.max_speed, queries[1].answer, sizeof(sl_u16));
+
+                sl_lidar_response_desired_rot_speed_t desired_speed;
+                if (queries[2].answer_size < sizeof(desired_speed)) return SL_RESULT_INVALID_DATA;
+                memcpy(&desired_speed, queries[2].answer, sizeof(desired_speed));
+                {
+                    rp::hal::AutoLocker l(_profile_lock);
+                    _profile.desired_speed = desired_speed;
+                    _profile.desired_speed_valid = true;
+                }
+                motorInfo.motorCtrlSupport = _isSupportingMotorCtrl;
                 if(motorInfo.motorCtrlSupport == MotorCtrlSupportPwm)
                     motorInfo.desired_speed = desired_speed.pwm_ref;
                 else
                     motorInfo.desired_speed = desired_speed.rpm;
 
             }
+
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.motor_info = motorInfo;
+                _profile.motor_info_valid = true;
+                _profile_dirty = true;
+            }
             return SL_RESULT_OK;
         }
 
@@ -798,65 +1448,85 @@ namespace sl {
         sl_result getDesiredSpeed(sl_lidar_response_desired_rot_speed_t & motorSpeed, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_DESIRED_ROT_FREQ, answer, std::vector<sl_u8>(), timeoutInMs);
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.desired_speed_valid) {
+                    motorSpeed = _profile.desired_speed;
+                    return SL_RESULT_OK;
+                }
+            }
 
+            ans = _getLidarConfValue(SL_LIDAR_CONF_DESIRED_ROT_FREQ, motorSpeed, 0, timeoutInMs);
             if (!ans) return ans;
 
-            const sl_lidar_response_desired_rot_speed_t *p_answer = reinterpret_cast<const sl_lidar_response_desired_rot_speed_t*>(&answer[0]);
-            motorSpeed = *p_answer;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.desired_speed = motorSpeed;
+                _profile.desired_speed_valid = true;
+                _profile_dirty = true;
+            }
             return SL_RESULT_OK;
         }
 
         sl_result checkSupportConfigCommands(bool& outSupport, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
             Result<nullptr_t> ans = SL_RESULT_OK;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.conf_support_valid) {
+                    outSupport = _profile.conf_support;
+                    return SL_RESULT_OK;
+                }
+            }
+
             sl_lidar_response_device_info_t devinfo;
             ans = getDeviceInfo(devinfo, timeoutInMs);
             if (!ans) return ans;
 
             sl_u16 modecount;
             ans = getScanModeCount(modecount, 250);
-            if ((sl_result)ans == SL_RESULT_OK)
+            bool support = ((sl_result)ans == SL_RESULT_OK);
+            if (support)
                 outSupport = true;
 
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.conf_support = support;
+                _profile.conf_support_valid = true;
+                _profile_dirty = true;
+            }
             return SL_RESULT_OK;
         }
 
         sl_result getScanModeCount(sl_u16& modeCount, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_COUNT, answer, std::vector<sl_u8>(), timeoutInMs);
-
-            if (!ans) return ans;
-
-            const sl_u16 *p_answer = reinterpret_cast<const sl_u16*>(&answer[0]);
-            modeCount = *p_answer;
-            return SL_RESULT_OK;
+            return _getLidarConfValue(SL_LIDAR_CONF_SCAN_MODE_COUNT, modeCount, 0, timeoutInMs);
         }
 
 		sl_result setLidarConf(sl_u32 type, const void* payload, size_t payloadSize, sl_u32 timeout)
 		{
 			if (type < 0x00010000 || type >0x0001FFFF)
 				return SL_RESULT_INVALID_DATA;
-			std::vector<sl_u8> requestPkt;
-			requestPkt.resize(sizeof(sl_lidar_payload_set_scan_conf_t) + payloadSize);
 			if (!payload) payloadSize = 0;
-			sl_lidar_payload_set_scan_conf_t* query = reinterpret_cast<sl_lidar_payload_set_scan_conf_t*>(&requestPkt[0]);
+			if (sizeof(sl_lidar_payload_set_scan_conf_t) + payloadSize > MAX_CMD_PAYLOAD_SIZE)
+				return SL_RESULT_INVALID_DATA;
+
+			sl_u8 requestPkt[MAX_CMD_PAYLOAD_SIZE];
+			size_t requestSize = sizeof(sl_lidar_payload_set_scan_conf_t) + payloadSize;
+			sl_lidar_payload_set_scan_conf_t* query = reinterpret_cast<sl_lidar_payload_set_scan_conf_t*>(requestPkt);
 
 			query->type = type;
 
 			if (payloadSize)
 				memcpy(&query[1], payload, payloadSize);
 
-			sl_result ans;
+			sl_result ans = _prepareActiveRequest();
+			if (IS_FAIL(ans)) return ans;
 			{
 				rp::hal::AutoLocker l(_lock);
-				if (IS_FAIL(ans = _sendCommand(SL_LIDAR_CMD_SET_LIDAR_CONF, &requestPkt[0], requestPkt.size()))) {//
+				if (IS_FAIL(ans = _sendCommand(SL_LIDAR_CMD_SET_LIDAR_CONF, requestPkt, requestSize))) {//
 					return ans;
 				}
-				delay(20);
 				// waiting for confirmation
 				sl_lidar_ans_header_t response_header;
 				if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
@@ -873,13 +1543,14 @@ namespace sl {
 				if (!_channel->waitForData(header_size, timeout)) {
 					return SL_RESULT_OPERATION_TIMEOUT;
 				}
-				delay(100);
 				struct _sl_lidar_response_set_lidar_conf {
 					sl_u32 type;
 					sl_u32 result;
 				} answer;
 
 				_channel->read(reinterpret_cast<sl_u8*>(&answer), header_size);
+				// the configuration changed, the cached capabilities may be stale
+				if (IS_OK(answer.result)) _dropDeviceProfile();
 				return answer.result;
     
 			}
@@ -889,341 +1560,1232 @@ namespace sl {
         sl_result getLidarConf(sl_u32 type, std::vector<sl_u8> &outputBuf, const std::vector<sl_u8> &reserve = std::vector<sl_u8>(), sl_u32 timeout = DEFAULT_TIMEOUT)
         {
             sl_lidar_payload_get_scan_conf_t query;
+            memset(&query, 0, sizeof(query));
             query.type = type;
-            int sizeVec = reserve.size();
+            size_t sizeVec = reserve.size();
 
-            int maxLen = sizeof(query.reserved) / sizeof(query.reserved[0]);
+            size_t maxLen = sizeof(query.reserved) / sizeof(query.reserved[0]);
             if (sizeVec > maxLen) sizeVec = maxLen;
 
             if (sizeVec > 0)
-                memcpy(query.reserved, &reserve[0], reserve.size());
+                memcpy(query.reserved, &reserve[0], sizeVec);
+
+            sl_u8 answer[MAX_CMD_PAYLOAD_SIZE];
+            size_t size = sizeof(answer);
+            sl_result ans = _getLidarConf(query, answer, size, timeout);
+            if (IS_FAIL(ans)) return ans;
+            outputBuf.assign(answer, answer + size);
+            return SL_RESULT_OK;
+        }
+
+        /// Allocation free variant of getLidarConf
+        ///
+        /// \param outputBuf     Buffer receiving the answer
+        /// \param size          Capacity of outputBuf on input, length of the answer on return
+        /// \param param         Parameter of the request, the scan mode id for the per-mode configurations
+        ///
+        /// The interface will return SL_RESULT_INSUFFICIENT_MEMORY if the answer does not fit in outputBuf.
+        sl_result getLidarConf(sl_u32 type, void* outputBuf, size_t& size, sl_u16 param = 0, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            sl_lidar_payload_get_scan_conf_t query;
+            memset(&query, 0, sizeof(query));
+            query.type = type;
+            memcpy(query.reserved, &param, sizeof(param));
+            return _getLidarConf(query, outputBuf, size, timeout);
+        }
+
+        sl_result getLidarConfBatch(LidarConfQuery* queries, size_t count, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            for (size_t pos = 0; pos < count; ++pos) {
+                queries[pos].result = SL_RESULT_OPERATION_TIMEOUT;
+                queries[pos].answer_size = 0;
+            }
+            if (!count) return SL_RESULT_OK;
+            return _getLidarConfPipelined(queries, count, timeout);
+        }
 
+        sl_result getLidarSampleDuration(float& sampleDurationRes, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        {
             Result<nullptr_t> ans = SL_RESULT_OK;
-            { 
-                rp::hal::AutoLocker l(_lock);
-                ans = _sendCommand(SL_LIDAR_CMD_GET_LIDAR_CONF, &query, sizeof(query));
-                if (!ans) return ans;
-				delay(50);
-                // waiting for confirmation
-                sl_lidar_ans_header_t response_header;
-                ans = _waitResponseHeader(&response_header, timeout);
-                if (!ans)return ans;
-
-                // verify whether we got a correct header
-                if (response_header.type != SL_LIDAR_ANS_TYPE_GET_LIDAR_CONF) {
-                    return SL_RESULT_INVALID_DATA;
-                }
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t size = sizeof(answer);
+            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_US_PER_SAMPLE, answer, size, scanModeID, timeoutInMs);
 
-                sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
-                if (header_size < sizeof(type)) {
-                    return SL_RESULT_INVALID_DATA;
-                }
-				//delay(100);
-                if (!_channel->waitForData(header_size, timeout)) {
-                    return SL_RESULT_OPERATION_TIMEOUT;
-                }
+            if (!ans) return ans;
+            return _decodeConfQ8(answer, size, sampleDurationRes);
+        }
+
+        sl_result getMaxDistance(float &maxDistance, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        {
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t size = sizeof(answer);
+            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_MAX_DISTANCE, answer, size, scanModeID, timeoutInMs);
+            if (!ans) return ans;
+            return _decodeConfQ8(answer, size, maxDistance);
+        }
+
+        sl_result getScanModeAnsType(sl_u8 &ansType, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        {
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t size = sizeof(answer);
+            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_ANS_TYPE, answer, size, scanModeID, timeoutInMs);
+            if (!ans) return ans;
+            return _decodeConfAnsType(answer, size, ansType);
+        }
+
+        sl_result getScanModeName(char* modeName, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        {
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t size = sizeof(answer);
+            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_NAME, answer, size, scanModeID, timeoutInMs);
+            if (!ans) return ans;
+            return _decodeConfModeName(answer, size, modeName);
+        }
+
+        sl_result negotiateSerialBaudRate(sl_u32 requiredBaudRate, sl_u32 * baudRateDetected)
+        {
+            // ask the LIDAR to stop working first...
+            stop();
+            _channel->flush();
+
+            // wait for a while
+            delay(10);
+            _channel->clearReadCache();
+
+            // sending magic byte to let the target LIDAR start baudrate measurement
+            // More than 100 bytes per second datarate is required to trigger the measurements
+            {
+                
+
+                sl_u8 magicByteSeq[16];
+
+                memset(magicByteSeq, SL_LIDAR_AUTOBAUD_MAGICBYTE, sizeof(magicByteSeq));
+
+                sl_u64 startTS = getms();
+
+                while (getms() - startTS < 1500 ) //lasting for 1.5sec
+                {
+                    if (_channel->write(magicByteSeq, sizeof(magicByteSeq)) < 0)
+                    {
+                        return SL_RESULT_OPERATION_FAIL;
+                    }
+                    
+                    size_t dataCountGot;
+                    if (_channel->waitForData(1, 1, &dataCountGot)) {
+                        //got reply, stop
+                        break;
+                    }
+                }
+            }
+
+            // getback the bps measured
+            _u32 bpsDetected = 0;
+            size_t dataCountGot;
+            if (_channel->waitForData(4, 500, &dataCountGot)) {
+                //got reply, stop
+                _channel->read(&bpsDetected, 4);
+                if (baudRateDetected) *baudRateDetected = bpsDetected;
+
+
+                // send a confirmation to the LIDAR, otherwise, the previous baudrate will be reverted back
+                sl_lidar_payload_new_bps_confirmation_t confirmation;
+                confirmation.flag = 0x5F5F;
+                confirmation.required_bps = requiredBaudRate;
+                confirmation.param = 0;
+                if (SL_IS_FAIL(_sendCommand(RPLIDAR_CMD_NEW_BAUDRATE_CONFIRM, &confirmation, sizeof(confirmation))))
+                    return RESULT_OPERATION_FAIL;
+
+
+                return RESULT_OK;
+            } 
+            
+            return RESULT_OPERATION_TIMEOUT;
+        }
+
+        sl_result negotiateBestSerialBaudRate(const std::vector<sl_u32>& candidates, float lossBudget, LidarBaudRateNegotiation* result)
+        {
+            if (!isConnected()) return SL_RESULT_OPERATION_FAIL;
+            ISerialPortChannel* serial = dynamic_cast<ISerialPortChannel*>(_channel);
+            if (!serial || !serial->getBaudRate()) return SL_RESULT_OPERATION_NOT_SUPPORT;
+
+            LidarBaudRateNegotiation best;
+            memset(&best, 0, sizeof(best));
+            best.baudrate = serial->getBaudRate();
+
+            std::vector<sl_u32> rates(candidates);
+            std::sort(rates.begin(), rates.end());
+
+            sl_u32 recorded = 0;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.link_baudrate_valid) recorded = _profile.link_baudrate;
+            }
+
+            LidarBaudRateNegotiation step;
+            bool settled = false;
+            if (recorded > best.baudrate && std::find(rates.begin(), rates.end(), recorded) != rates.end()) {
+                if (IS_OK(_tryBaudRateStep(serial, recorded, lossBudget, step))) {
+                    step.from_record = true;
+                    best = step;
+                    settled = true;
+                }
+            }
+
+            for (size_t pos = 0; pos < rates.size() && !settled; ++pos) {
+                if (rates[pos] <= best.baudrate) continue;
+                if (IS_OK(_tryBaudRateStep(serial, rates[pos], lossBudget, step))) {
+                    best = step;
+                    continue;
+                }
+                // the bps error only depends on the clock divider of this rate, but a link losing capsules
+                // or failing at this rate will not do better at a higher one
+                if (step.bps_error <= BAUD_MAX_BPS_ERROR || !step.detected_bps) break;
+            }
+
+            if (serial->getBaudRate() != best.baudrate) {
+                sl_u32 detected;
+                sl_result ans = _switchSerialBaudRate(serial, best.baudrate, detected);
+                if (IS_FAIL(ans)) return ans;
+            }
+
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile.link_baudrate_valid = true;
+                _profile.link_baudrate = best.baudrate;
+                _profile_dirty = true;
+            }
+
+            if (result) *result = best;
+            return SL_RESULT_OK;
+        }
+
+    private:
+
+        // Reopen the serial channel at the given baudrate and move the lidar to it, checked by a device info round trip
+        sl_result _switchSerialBaudRate(ISerialPortChannel* serial, sl_u32 baudrate, sl_u32& detected)
+        {
+            stop();
+            serial->close();
+            if (!serial->setBaudRate(baudrate) || !serial->open()) return SL_RESULT_OPERATION_FAIL;
+
+            detected = 0;
+            sl_result ans = negotiateSerialBaudRate(baudrate, &detected);
+            if (IS_FAIL(ans)) return ans;
+
+            rp::hal::AutoLocker l(_lock);
+            _channel->flush();
+            _channel->clearReadCache();
+            sl_lidar_response_device_info_t devinfo;
+            ans = _sendCommand(SL_LIDAR_CMD_GET_DEVICE_INFO);
+            if (IS_FAIL(ans)) return ans;
+            return _waitResponse(devinfo, SL_LIDAR_ANS_TYPE_DEVINFO, 500);
+        }
+
+        // One step of negotiateBestSerialBaudRate: switch to the baudrate and measure the link quality with a scan burst
+        sl_result _tryBaudRateStep(ISerialPortChannel* serial, sl_u32 baudrate, float lossBudget, LidarBaudRateNegotiation& step)
+        {
+            memset(&step, 0, sizeof(step));
+            step.baudrate = baudrate;
+
+            sl_result ans = _switchSerialBaudRate(serial, baudrate, step.detected_bps);
+            if (IS_FAIL(ans)) return ans;
+            step.bps_error = fabs((float)step.detected_bps - (float)baudrate) * 100.0f / baudrate;
+            if (step.bps_error > BAUD_MAX_BPS_ERROR) return SL_RESULT_INVALID_DATA;
+
+            ans = startScan(false, true);
+            if (IS_FAIL(ans)) return ans;
+
+            // the burst starts with the first decoded capsule, once the motor is up to speed
+            LidarDriverStats before, after;
+            _stats.snapshot(before);
+            sl_u64 initialCapsules = before.capsules_decoded;
+            sl_u32 startTs = getms();
+            while (before.capsules_decoded == initialCapsules && getms() - startTs < BAUD_SPINUP_TIMEOUT) {
+                delay(10);
+                _stats.snapshot(before);
+            }
+            delay(BAUD_BURST_TIME);
+            _stats.snapshot(after);
+            stop();
+
+            sl_u64 decoded = after.capsules_decoded - before.capsules_decoded;
+            sl_u64 lost = (after.checksum_errors - before.checksum_errors) + (after.resyncs - before.resyncs);
+            if (!decoded) return SL_RESULT_OPERATION_TIMEOUT;
+            step.loss_rate = (float)lost / (float)(decoded + lost);
+            return step.loss_rate > lossBudget ? SL_RESULT_INVALID_DATA : SL_RESULT_OK;
+        }
+
+        void _resetDeviceProfile()
+        {
+            rp::hal::AutoLocker l(_profile_lock);
+            _profile.reset();
+            _profile_dirty = false;
+        }
+
+        void _dropDeviceProfile()
+        {
+            rp::hal::AutoLocker storeLock(_profile_store_lock);
+            std::string cacheDir;
+            sl_lidar_response_device_info_t devinfo;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile.devinfo_valid) cacheDir = _profile_cache_dir;
+                devinfo = _profile.devinfo;
+                _profile.reset();
+                _profile_dirty = false;
+            }
+            if (!cacheDir.empty()) internal::removeDeviceProfile(cacheDir, devinfo);
+        }
+
+        // Write what the queries learned since the last store, when the cache is enabled
+        // Called once per bring-up: when the scan has started, on disconnect and on destruction. The file is written
+        // after releasing _profile_lock, _profile_store_lock keeps the stores in order.
+        void _storeDeviceProfile()
+        {
+            rp::hal::AutoLocker storeLock(_profile_store_lock);
+            std::string path;
+            std::vector<sl_u8> content;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                if (_profile_cache_dir.empty() || !_profile_dirty) return;
+                _profile_dirty = false;
+                if (!internal::encodeDeviceProfile(_profile, content)) return;
+                path = internal::getDeviceProfilePath(_profile_cache_dir, _profile.devinfo);
+            }
+            internal::writeDeviceProfile(path, content);
+        }
+
+        // With the cache enabled, the device info is the only query needed to restore the whole profile
+        void _loadDeviceProfile()
+        {
+            std::string cacheDir;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                cacheDir = _profile_cache_dir;
+            }
+            if (cacheDir.empty()) return;
+
+            sl_lidar_response_device_info_t devinfo;
+            if (IS_FAIL(getDeviceInfo(devinfo, 500))) return;
+
+            internal::DeviceProfile cached;
+            if (internal::loadDeviceProfile(cacheDir, devinfo, cached)) {
+                rp::hal::AutoLocker l(_profile_lock);
+                _profile = cached;
+            }
+        }
+
+        sl_result _getScanModeInfo(sl_u16 scanModeId, LidarScanMode& scanMode)
+        {
+            std::vector<LidarScanMode> modes;
+            sl_result ans = getAllSupportedScanModes(modes);
+            if (IS_FAIL(ans)) return ans;
+
+            for (size_t pos = 0; pos < modes.size(); ++pos) {
+                if (modes[pos].id == scanModeId) {
+                    scanMode = modes[pos];
+                    return SL_RESULT_OK;
+                }
+            }
+            return SL_RESULT_INVALID_DATA;
+        }
+        
+        // Minimum time the firmware needs after a request before it accepts the next one
+        static sl_u32 _getCommandGuardTime(sl_u16 cmd)
+        {
+            switch (cmd) {
+            case SL_LIDAR_CMD_STOP:
+                return 1000;
+            case SL_LIDAR_CMD_RESET:
+                return 2000;
+            case SL_LIDAR_CMD_SET_MOTOR_PWM:
+            case SL_LIDAR_CMD_HQ_MOTOR_SPEED_CTRL:
+                // the motor controller applies the new setpoint before handling a scan request
+                return 5000;
+            default:
+                return 0;
+            }
+        }
+
+        void _waitCommandGuard()
+        {
+            sl_u64 currentTs = getus();
+            if (currentTs < _cmd_guard_until_us) {
+                delay((sl_u32)((_cmd_guard_until_us - currentTs + 999) / 1000));
+            }
+        }
+
+        // Discard the bytes still in flight (e.g. the nodes queued before a STOP) until the line stays idle for quietTime
+        void _drainUntilQuiet(sl_u32 quietTime, sl_u32 maxTime)
+        {
+            sl_u8 drainBuffer[256];
+            sl_u32 startTs = getms();
+            size_t recvSize;
+
+            while (getms() - startTs < maxTime) {
+                if (!_channel->waitForData(1, quietTime, &recvSize)) break;
+                if (!recvSize) break;
+                if (recvSize > sizeof(drainBuffer)) recvSize = sizeof(drainBuffer);
+                _channel->read(drainBuffer, recvSize);
+            }
+        }
+
+        // Send a request without answer. While scanning, the channel is owned by the capture thread: the request is
+        // queued and written by that thread between two capsules, so the stream is neither flushed nor interleaved.
+        sl_result _sendRequest(sl_u16 cmd, const void * payload, size_t payloadsize, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            PendingRequest request(cmd, payload, payloadsize);
+            bool queued = false;
+            {
+                rp::hal::AutoLocker l(_request_lock);
+                if (_isScanning) {
+                    if (_request_tail) _request_tail->next = &request;
+                    else _request_head = &request;
+                    _request_tail = &request;
+                    queued = true;
+                }
+            }
+            if (!queued) {
+                return _sendCommand(cmd, payload, payloadsize);
+            }
+
+            request.done_evt.wait(timeout);
+
+            // the capture thread signals under _request_lock, the request must not leave the stack before it has released it
+            rp::hal::AutoLocker l(_request_lock);
+            if (!request.done) {
+                _withdrawRequest(&request);
+            }
+            return request.result;
+        }
+
+        void _withdrawRequest(PendingRequest* request)
+        {
+            PendingRequest* prev = NULL;
+            for (PendingRequest* pos = _request_head; pos; prev = pos, pos = pos->next) {
+                if (pos != request) continue;
+                if (prev) prev->next = pos->next;
+                else _request_head = pos->next;
+                if (_request_tail == pos) _request_tail = prev;
+                return;
+            }
+        }
+
+        // Write the queued requests, called by the capture thread between two capsules and once the capture thread is stopped
+        void _serviceRequests()
+        {
+            rp::hal::AutoLocker l(_request_lock);
+            while (_request_head) {
+                PendingRequest* request = _request_head;
+                _request_head = request->next;
+                if (!_request_head) _request_tail = NULL;
+
+                // the stream must not be flushed while scanning, _writeCommand arms the guard time of the next request
+                _waitCommandGuard();
+                request->result = _writeCommand(request->cmd, request->payload, request->payload_size);
+                request->done = true;
+                request->done_evt.set();
+            }
+        }
+
+        sl_result  _sendCommand(sl_u16 cmd, const void * payload = NULL, size_t payloadsize = 0 )
+        {
+            _waitCommandGuard();
+			_channel->flush();
+            return _writeCommand(cmd, payload, payloadsize);
+        }
+
+        // Write a request without discarding the pending input, the caller is responsible for the guard time
+        sl_result  _writeCommand(sl_u16 cmd, const void * payload = NULL, size_t payloadsize = 0 )
+        {
+            sl_u8 checksum = 0;
+            sl_u32 guardTime = _getCommandGuardTime(cmd);
+            sl_u8 packet[2 + 1 + MAX_CMD_PAYLOAD_SIZE + 1];
+            size_t packetSize = 0;
+
+            if (payloadsize > MAX_CMD_PAYLOAD_SIZE) {
+                return SL_RESULT_INVALID_DATA;
+            }
+
+            if (payloadsize && payload) {
+                cmd |= SL_LIDAR_CMDFLAG_HAS_PAYLOAD;
+            }
+            packet[packetSize++] = SL_LIDAR_CMD_SYNC_BYTE;
+            packet[packetSize++] = (sl_u8)cmd;
+			
+            if (cmd & SL_LIDAR_CMDFLAG_HAS_PAYLOAD) {
+                checksum ^= SL_LIDAR_CMD_SYNC_BYTE;
+                checksum ^= (sl_u8)cmd;
+                checksum ^= (payloadsize & 0xFF);
+
+                // send size
+                packet[packetSize++] = (sl_u8)payloadsize;
+                // calc checksum
+                for (size_t pos = 0; pos < payloadsize; ++pos) {
+                    checksum ^= ((const sl_u8 *)payload)[pos];
+                    packet[packetSize++] = ((const sl_u8 *)payload)[pos];
+                }
+                packet[packetSize++] = checksum;
+  
+            }
+            _channel->write(packet, packetSize);
+            _cmd_guard_until_us = getus() + guardTime;
+            return SL_RESULT_OK;
+        }
+
+        sl_result _waitResponseHeader(sl_lidar_ans_header_t * header, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            int  recvPos = 0;
+            sl_u32 startTs = getms();
+            sl_u8  recvBuffer[sizeof(sl_lidar_ans_header_t)];
+            sl_u8  *headerBuffer = reinterpret_cast<sl_u8 *>(header);
+            sl_u32 waitTime;
+
+            while ((waitTime = getms() - startTs) <= timeout) {
+                size_t remainSize = sizeof(sl_lidar_ans_header_t) - recvPos;
+                size_t recvSize;
+
+                bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
+                if (!ans) return SL_RESULT_OPERATION_TIMEOUT;
+
+                if (recvSize > remainSize) recvSize = remainSize;
+
+                recvSize = _channel->read(recvBuffer, recvSize);
+
+                for (size_t pos = 0; pos < recvSize; ++pos) {
+                    sl_u8 currentByte = recvBuffer[pos];
+                    switch (recvPos) {
+                    case 0:
+                        if (currentByte != SL_LIDAR_ANS_SYNC_BYTE1) {
+                            continue;
+                        }
+
+                        break;
+                    case 1:
+                        if (currentByte != SL_LIDAR_ANS_SYNC_BYTE2) {
+                            recvPos = 0;
+                            continue;
+                        }
+                        break;
+                    }
+                    headerBuffer[recvPos++] = currentByte;
+
+                    if (recvPos == sizeof(sl_lidar_ans_header_t)) {
+                        return SL_RESULT_OK;
+                    }
+                }
+            }
+
+            return SL_RESULT_OPERATION_TIMEOUT;
+        }
+
+        // Send a GET_LIDAR_CONF request and wait for its answer
+        sl_result _getLidarConf(const sl_lidar_payload_get_scan_conf_t& query, void* outputBuf, size_t& size, sl_u32 timeout)
+        {
+            Result<nullptr_t> ans = _prepareActiveRequest();
+            if (!ans) return ans;
+            {
+                rp::hal::AutoLocker l(_lock);
+                ans = _sendCommand(SL_LIDAR_CMD_GET_LIDAR_CONF, &query, sizeof(query));
+                if (!ans) return ans;
+
+                sl_u32 replyType;
+                ans = _waitLidarConfResponse(replyType, outputBuf, size, timeout);
+                if (!ans) return ans;
+
+                //check if returned type is same as asked type
+                if (replyType != query.type) {
+                    return SL_RESULT_INVALID_DATA;
+                }
+            }
+            return SL_RESULT_OK;
+        }
+
+        template <typename T>
+        sl_result _getLidarConfValue(sl_u32 type, T& value, sl_u16 param, sl_u32 timeout)
+        {
+            sl_u8 answer[LidarConfQuery::MAX_ANSWER_SIZE];
+            size_t size = sizeof(answer);
+            sl_result ans = getLidarConf(type, answer, size, param, timeout);
+            if (IS_FAIL(ans)) return ans;
+            if (size < sizeof(T)) return SL_RESULT_INVALID_DATA;
+            memcpy(&value, answer, sizeof(T));
+            return SL_RESULT_OK;
+        }
+
+        // Wait for a GET_LIDAR_CONF answer, the payload is returned without the leading configuration type
+        // size is the capacity of payload on input, the bytes which do not fit are discarded to keep the stream in sync
+        // typeRead tells whether replyType was read, so that a failed answer can still be matched to its request.
+        sl_result _waitLidarConfResponse(sl_u32& replyType, void* payload, size_t& size, sl_u32 timeout, bool* typeRead = NULL)
+        {
+            if (typeRead) *typeRead = false;
+
+            sl_lidar_ans_header_t response_header;
+            Result<nullptr_t> ans = _waitResponseHeader(&response_header, timeout);
+            if (!ans) return ans;
+
+            // verify whether we got a correct header
+            if (response_header.type != SL_LIDAR_ANS_TYPE_GET_LIDAR_CONF) {
+                return SL_RESULT_INVALID_DATA;
+            }
+
+            sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
+            if (!_channel->waitForData(header_size, timeout)) {
+                return SL_RESULT_OPERATION_TIMEOUT;
+            }
+
+            //do consistency check, an empty configuration is not a valid answer
+            if (header_size <= sizeof(replyType)) {
+                sl_u8 shortAnswer[sizeof(replyType)];
+                _channel->read(shortAnswer, header_size);
+                if (header_size == sizeof(replyType)) {
+                    memcpy(&replyType, shortAnswer, sizeof(replyType));
+                    if (typeRead) *typeRead = true;
+                }
+                size = 0;
+                return SL_RESULT_INVALID_DATA;
+            }
+
+            _channel->read(reinterpret_cast<sl_u8 *>(&replyType), sizeof(replyType));
+            if (typeRead) *typeRead = true;
+            size_t payloadSize = header_size - sizeof(replyType);
+            size_t copySize = std::min(payloadSize, size);
+            _channel->read(payload, copySize);
+
+            sl_u8 discardBuffer[32];
+            for (size_t remain = payloadSize - copySize; remain; ) {
+                size_t chunk = std::min(remain, sizeof(discardBuffer));
+                _channel->read(discardBuffer, chunk);
+                remain -= chunk;
+            }
+
+            size = copySize;
+            return (copySize == payloadSize) ? SL_RESULT_OK : SL_RESULT_INSUFFICIENT_MEMORY;
+        }
+
+        // The answers only carry the configuration type. Two requests of the same type are never in flight together,
+        // so each answer maps to exactly one request even if the firmware drops one of them.
+        // Pipelining is only given up on when the firmware shows it cannot keep up with back-to-back requests: an answer
+        // overtaking older requests, or a silence after some requests of the batch were answered in order. The requests
+        // left behind are then sent again one at a time. An error answer, or a request which still gets no answer when it
+        // is alone in flight, is the result of that request.
+        // A request left behind may still be answered late, and that answer would be taken for the one of the next request
+        // of the same type. So once a request is left behind, the answers still expected are collected, the late ones are
+        // drained, and the rest of the batch is sent one request at a time.
+        sl_result _getLidarConfPipelined(LidarConfQuery* queries, size_t count, sl_u32 timeout)
+        {
+            sl_result ans = _prepareActiveRequest();
+            if (IS_FAIL(ans)) return ans;
+
+            rp::hal::AutoLocker l(_lock);
+            size_t inflight[CONF_PIPELINE_DEPTH];
+            size_t inflightCount = 0;
+            size_t resend[CONF_PIPELINE_DEPTH];     // requests left behind by the firmware, sent before the others
+            size_t resendCount = 0;
+            size_t sent = 0;
+            bool answered = false;
+            bool serial = _conf_pipeline_disabled;
+            bool drainLate = false;                 // some answers may still arrive for requests left behind
+
+            _waitCommandGuard();
+            _channel->flush();
+
+            while (sent < count || resendCount || inflightCount) {
+                if (drainLate && !inflightCount) {
+                    // a late answer comes at least a timeout after its request, wait as long for the line to fall silent
+                    _drainUntilQuiet(timeout, 2 * timeout);
+                    drainLate = false;
+                }
+
+                size_t depth = (serial || drainLate) ? 1 : (size_t)CONF_PIPELINE_DEPTH;
+                while (!drainLate && (sent < count || resendCount) && inflightCount < depth) {
+                    size_t next = resendCount ? resend[0] : sent;
+                    bool typeInflight = false;
+                    for (size_t pos = 0; pos < inflightCount; ++pos) {
+                        if (queries[inflight[pos]].type == queries[next].type) typeInflight = true;
+                    }
+                    if (typeInflight) break;
+
+                    sl_lidar_payload_get_scan_conf_t query;
+                    memset(&query, 0, sizeof(query));
+                    query.type = queries[next].type;
+                    memcpy(query.reserved, &queries[next].param, sizeof(queries[next].param));
+                    sl_result ans = _writeCommand(SL_LIDAR_CMD_GET_LIDAR_CONF, &query, sizeof(query));
+                    if (IS_FAIL(ans)) return ans;
+                    inflight[inflightCount++] = next;
+                    if (resendCount) {
+                        for (size_t pos = 0; pos + 1 < resendCount; ++pos) resend[pos] = resend[pos + 1];
+                        --resendCount;
+                    } else {
+                        ++sent;
+                    }
+                }
+
+                sl_u32 replyType = 0;
+                bool typeRead = false;
+                sl_u8 payload[LidarConfQuery::MAX_ANSWER_SIZE];
+                size_t payloadSize = sizeof(payload);
+                sl_result ans = _waitLidarConfResponse(replyType, payload, payloadSize, timeout, &typeRead);
+
+                if (ans == SL_RESULT_OPERATION_TIMEOUT) {
+                    // the lidar does not answer at all, the remaining requests would only wait as long
+                    if (!answered) return ans;
+                    if (depth > 1 || inflightCount > 1) {
+                        _conf_pipeline_disabled = true;
+                        for (size_t pos = 0; pos < inflightCount; ++pos) resend[resendCount++] = inflight[pos];
+                    }
+                    // otherwise the request keeps the timeout as its result
+                    inflightCount = 0;
+                    serial = true;
+                    drainLate = true;
+                    continue;
+                }
+                // the answer stream cannot be trusted any more
+                if (!typeRead) return ans;
+
+                size_t pos = 0;
+                while (pos < inflightCount && queries[inflight[pos]].type != replyType) ++pos;
+                // late answer of a request which already timed out
+                if (pos == inflightCount) continue;
+
+                if (pos) {
+                    // the firmware dropped or reordered the older requests
+                    _conf_pipeline_disabled = true;
+                    for (size_t skipped = 0; skipped < pos; ++skipped) resend[resendCount++] = inflight[skipped];
+                    serial = true;
+                    drainLate = true;
+                }
+
+                LidarConfQuery& query = queries[inflight[pos]];
+                memcpy(query.answer, payload, payloadSize);
+                query.answer_size = payloadSize;
+                query.result = ans;
+                answered = true;
+                for (size_t dst = 0, src = pos + 1; src < inflightCount; ++dst, ++src) inflight[dst] = inflight[src];
+                inflightCount -= pos + 1;
+            }
+
+            for (size_t pos = 0; pos < count; ++pos) {
+                if (IS_FAIL(queries[pos].result)) return queries[pos].result;
+            }
+            return SL_RESULT_OK;
+        }
+
+        static sl_result _decodeConfQ8(const sl_u8* answer, size_t size, float& value)
+        {
+            if (size < sizeof(sl_u32)){
+                return SL_RESULT_INVALID_DATA;
+            }
+            sl_u32 result;
+            memcpy(&result, answer, sizeof(result));
+            value = (float)(result >> 8);
+            return SL_RESULT_OK;
+        }
+
+        static sl_result _decodeConfAnsType(const sl_u8* answer, size_t size, sl_u8& ansType)
+        {
+            if (size < sizeof(sl_u8)){
+                return SL_RESULT_INVALID_DATA;
+            }
+            ansType = answer[0];
+            return SL_RESULT_OK;
+        }
+
+        static sl_result _decodeConfModeName(const sl_u8* answer, size_t size, char* modeName)
+        {
+            const size_t maxLen = sizeof(((LidarScanMode*)0)->scan_mode);
+            if (0 == size) return SL_RESULT_INVALID_DATA;
+            if (size > maxLen - 1) size = maxLen - 1;
+            memcpy(modeName, answer, size);
+            modeName[size] = 0;
+            return SL_RESULT_OK;
+        }
+
+        template <typename T>
+        sl_result _waitResponse(T &payload ,sl_u8 ansType, sl_u32 timeout = DEFAULT_TIMEOUT)
+        {
+            sl_lidar_ans_header_t response_header;
+            Result<nullptr_t> ans = SL_RESULT_OK;
+            //delay(100);
+            ans = _waitResponseHeader(&response_header, timeout);
+            if (!ans) 
+                return ans;
+            // verify whether we got a correct header
+            if (response_header.type != ansType) {
+                return SL_RESULT_INVALID_DATA;
+            }
+           // delay(50);
+            sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
+            if (header_size < sizeof(T)) {
+                return SL_RESULT_INVALID_DATA;
+            }
+            if (!_channel->waitForData(header_size, timeout)) {
+                return SL_RESULT_OPERATION_TIMEOUT;
+            }
+            _channel->read(reinterpret_cast<sl_u8 *>(&payload), sizeof(T));
+            return SL_RESULT_OK;
+        }
+
+        // Requests share the channel with the measurement stream, they can only be sent once the scan is stopped
+        sl_result _prepareActiveRequest()
+        {
+            if (_isScanning && !_scan_interruption_allowed) return SL_RESULT_OPERATION_NOT_SUPPORT;
+            _disableDataGrabbing();
+            return SL_RESULT_OK;
+        }
+
+        void _resetHealthStatus()
+        {
+            rp::hal::AutoLocker l(_health_lock);
+            _health_query_valid = false;
+            _dev_status_valid = false;
+            _last_capsule_us.store(0, std::memory_order_relaxed);
+        }
+
+        // Called by the capture thread for every Ultra Dense capsule
+        void _recordDeviceStatus(sl_u16 devStatus)
+        {
+            rp::hal::AutoLocker l(_health_lock);
+            _dev_status = devStatus;
+            _dev_status_us = getus();
+            _dev_status_valid = true;
+        }
+
+        static sl_u32 _elapsedMs(sl_u64 fromUs, sl_u64 toUs)
+        {
+            return toUs > fromUs ? (sl_u32)((toUs - fromUs) / 1000) : 0;
+        }
+
+        void _disableDataGrabbing()
+        {
+            _clearRxDataCache();
+            _isScanning = false;
+            _stopCapture();
+            // the requests queued while the capture thread was stopping
+            _serviceRequests();
+        }
+
+        // Send the scan request held in _scan_cmd/_scan_req and check its answer, _lock must be held
+        // The capture loop matching the answer type is returned in job.
+        sl_result _requestScan(CaptureJob& job, sl_u32 timeout)
+        {
+            const void* payload = (_scan_cmd == SL_LIDAR_CMD_EXPRESS_SCAN) ? &_scan_req : NULL;
+            size_t payloadSize = payload ? sizeof(_scan_req) : 0;
+            Result<nullptr_t> ans = _sendCommand(_scan_cmd, payload, payloadSize);
+            if (!ans) {
+                ans = _sendCommand(_scan_cmd, payload, payloadSize);
+                if (!ans)
+                    return SL_RESULT_INVALID_DATA;
+            }
+
+            // waiting for confirmation
+            sl_lidar_ans_header_t response_header;
+            ans = _waitResponseHeader(&response_header, timeout);
+            if (!ans) return ans;
+
+            // verify whether we got a correct header
+            if (response_header.type != _scan_ans_type) {
+                return SL_RESULT_INVALID_DATA;
+            }
+
+            sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
+            size_t minSize;
+            switch (_scan_ans_type) {
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT:
+                minSize = sizeof(sl_lidar_response_measurement_node_t);
+                job = &SlamtecLidarDriver::_cacheScanData;
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+                minSize = sizeof(sl_lidar_response_capsule_measurement_nodes_t);
+                _cached_capsule_flag = NORMAL_CAPSULE;
+                job = &SlamtecLidarDriver::_cacheCapsuledScanData;
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+                minSize = sizeof(sl_lidar_response_capsule_measurement_nodes_t);
+                _cached_capsule_flag = DENSE_CAPSULE;
+                job = &SlamtecLidarDriver::_cacheCapsuledScanData;
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_HQ:
+                minSize = sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t);
+                job = &SlamtecLidarDriver::_cacheHqScanData;
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENTT_ULTRA_DENSE_CAPSULED:
+                minSize = sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t);
+                job = &SlamtecLidarDriver::_cacheUltraDenseCapsuledScanData;
+                break;
+            default:
+                minSize = sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t);
+                job = &SlamtecLidarDriver::_cacheUltraCapsuledScanData;
+                break;
+            }
+            if (header_size < minSize) {
+                return SL_RESULT_INVALID_DATA;
+            }
+            return SL_RESULT_OK;
+        }
 
-                std::vector<sl_u8> dataBuf;
-                dataBuf.resize(header_size);
-                _channel->read(reinterpret_cast<sl_u8 *>(&dataBuf[0]), header_size);
+        // Hard failure of the channel during a scan, the scan ends unless the link supervision takes over
+        sl_result _captureFailed()
+        {
+            if (!_auto_reconnect) _isScanning = false;
+            return SL_RESULT_OPERATION_FAIL;
+        }
 
-                //check if returned type is same as asked type
-                sl_u32 replyType = -1;
-                memcpy(&replyType, &dataBuf[0], sizeof(type));
-                if (replyType != type) {
-                    return SL_RESULT_INVALID_DATA;
-                }
+        // Runs on the capture worker once the link is lost: reopen the channel with backoff and restart the same scan
+        // Returns false when the scan has to end: supervision disabled, stop requested or another device answering.
+        bool _recoverLink()
+        {
+            if (!_auto_reconnect || !_isScanning) {
+                _isScanning = false;
+                return false;
+            }
 
-                //copy all the payload into &outputBuf
-                int payLoadLen = header_size - sizeof(type);
+            sl_u64 lostTs = getus();
+            if (ILidarEventListener* listener = _currentListener()) listener->onLinkLost();
 
-                //do consistency check
-                if (payLoadLen <= 0) {
-                    return SL_RESULT_INVALID_DATA;
+            sl_u32 backoff = LINK_MIN_BACKOFF;
+            while (_isScanning) {
+                bool opened;
+                {
+                    rp::hal::AutoLocker l(_capture_lock);
+                    if (!_isScanning) break;
+                    _channel->close();
+                    opened = _channel->open();
                 }
-                //copy all payLoadLen bytes to outputBuf
-                outputBuf.resize(payLoadLen);
-                memcpy(&outputBuf[0], &dataBuf[0] + sizeof(type), payLoadLen);
-
+                if (opened) {
+                    sl_result ans = _restartScan();
+                    if (IS_OK(ans)) {
+                        sl_u32 downtimeMs = (sl_u32)((getus() - lostTs) / 1000);
+                        _scan_link_downtime_ms = downtimeMs;
+                        if (ILidarEventListener* listener = _currentListener()) listener->onLinkRestored(downtimeMs);
+                        return true;
+                    }
+                    if (ans == SL_RESULT_OPERATION_NOT_SUPPORT) break;
+                }
+                _recoveryEvt.wait(backoff);
+                backoff = std::min(backoff * 2, _link_max_backoff);
             }
-
-            return SL_RESULT_OK;
+            _isScanning = false;
+            return false;
         }
 
-        sl_result getLidarSampleDuration(float& sampleDurationRes, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        // Restart the scan on the reopened channel, from the cached device profile and the last scan and motor requests
+        sl_result _restartScan()
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> reserve(2);
-            memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+            sl_lidar_response_device_info_t expectedInfo;
+            bool checkInfo;
+            {
+                rp::hal::AutoLocker l(_profile_lock);
+                checkInfo = _profile.devinfo_valid;
+                expectedInfo = _profile.devinfo;
+            }
 
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_US_PER_SAMPLE, answer, reserve, timeoutInMs);
+            rp::hal::AutoLocker l(_lock);
+            _channel->flush();
 
+            // the device may have been replaced while the link was down
+            sl_lidar_response_device_info_t devinfo;
+            Result<nullptr_t> ans = _sendCommand(SL_LIDAR_CMD_GET_DEVICE_INFO);
+            if (!ans) return ans;
+            ans = _waitResponse(devinfo, SL_LIDAR_ANS_TYPE_DEVINFO, LINK_PROBE_TIMEOUT);
             if (!ans) return ans;
+            if (checkInfo && memcmp(&devinfo, &expectedInfo, sizeof(devinfo)) != 0) {
+                return SL_RESULT_OPERATION_NOT_SUPPORT;
+            }
 
-            if (answer.size() < sizeof(sl_u32)){
-                return SL_RESULT_INVALID_DATA;
+            // a power cycled lidar lost its motor setpoint
+            if (_motor_cmd) {
+                ans = _sendCommand(_motor_cmd, &_motor_payload, sizeof(_motor_payload));
+                if (!ans) return ans;
             }
-            const sl_u32 *result = reinterpret_cast<const sl_u32*>(&answer[0]);
-            sampleDurationRes = (float)(*result >> 8);
-            return ans;
+
+            CaptureJob job;
+            return _requestScan(job, DEFAULT_TIMEOUT);
         }
 
-        sl_result getMaxDistance(float &maxDistance, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        // Hand the capture of the scan over to the reactor set by setCaptureReactor, or to the capture worker without one
+        sl_result _startCapture(CaptureJob job)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> reserve(2);
-            memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
-
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_MAX_DISTANCE, answer, reserve, timeoutInMs);
-            if (!ans) return ans;
- 
-            if (answer.size() < sizeof(sl_u32)){
-                return SL_RESULT_INVALID_DATA;
-            }
-            const sl_u32 *result = reinterpret_cast<const sl_u32*>(&answer[0]);
-            maxDistance = (float)(*result >> 8);
-            return ans;
+            _scan_job = job;
+            if (_attachReactor()) return SL_RESULT_OK;
+            return _startCaptureWorker(job);
         }
 
-        sl_result getScanModeAnsType(sl_u8 &ansType, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        // Hand a capture loop over to the capture worker, the worker thread is created by the first scan and reused afterwards
+        sl_result _startCaptureWorker(CaptureJob job)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> reserve(2);
-            memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+            if (!_spawnCaptureWorker()) return SL_RESULT_OPERATION_FAIL;
 
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_ANS_TYPE, answer, reserve, timeoutInMs);
-            if (!ans) return ans;
+            rp::hal::AutoLocker l(_capture_lock);
+            _postCaptureJob(job);
+            return SL_RESULT_OK;
+        }
 
-            if (answer.size() < sizeof(sl_u8)){
-                return SL_RESULT_INVALID_DATA;
+        bool _spawnCaptureWorker()
+        {
+            if (_cachethread.getHandle() == 0) {
+                _cachethread = CLASS_THREAD(SlamtecLidarDriver, _captureWorker);
             }
-            const sl_u8 *result = reinterpret_cast<const _u8*>(&answer[0]);
-            ansType = *result;
-            return ans;
-        
+            return _cachethread.getHandle() != 0;
         }
 
-        sl_result getScanModeName(char* modeName, sl_u16 scanModeID, sl_u32 timeoutInMs = DEFAULT_TIMEOUT)
+        // _capture_lock must be held
+        void _postCaptureJob(CaptureJob job)
         {
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            std::vector<sl_u8> reserve(2);
-            memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
-
-            std::vector<sl_u8> answer;
-            ans = getLidarConf(SL_LIDAR_CONF_SCAN_MODE_NAME, answer, reserve, timeoutInMs);
-            if (!ans) return ans;
-            int len = answer.size();
-            if (0 == len) return SL_RESULT_INVALID_DATA;
-            memcpy(modeName, &answer[0], len);
-            return ans;
+            _capture_job = job;
+            _capture_busy = true;
+            _captureIdleEvt.set(false);
+            _recoveryEvt.set(false);
+            _captureJobEvt.set();
         }
 
-        sl_result negotiateSerialBaudRate(sl_u32 requiredBaudRate, sl_u32 * baudRateDetected)
+        // Wait for the capture loop to return, the wait of the channel is cancelled so it does not last until its timeout
+        void _stopCapture()
         {
-            // ask the LIDAR to stop working first...
-            stop();
-            _channel->flush();
-
-            // wait for a while
-            delay(10);
-            _channel->clearReadCache();
-
-            // sending magic byte to let the target LIDAR start baudrate measurement
-            // More than 100 bytes per second datarate is required to trigger the measurements
+            // a step of the reactor may hand the capture over to the worker, the reactor goes first
+            _detachReactor();
             {
-                
-
-                sl_u8 magicByteSeq[16];
-
-                memset(magicByteSeq, SL_LIDAR_AUTOBAUD_MAGICBYTE, sizeof(magicByteSeq));
+                // serialized with the channel reopening done by _recoverLink
+                rp::hal::AutoLocker l(_capture_lock);
+                if (!_capture_busy) return;
+                if (_channel) _channel->cancelWait();
+            }
+            _recoveryEvt.set();
+            _captureIdleEvt.wait();
+            if (_channel) _channel->resumeWait();
+        }
 
-                sl_u64 startTS = getms();
+        sl_result _captureWorker()
+        {
+            while (true) {
+                _captureJobEvt.wait();
 
-                while (getms() - startTS < 1500 ) //lasting for 1.5sec
+                CaptureJob job;
                 {
-                    if (_channel->write(magicByteSeq, sizeof(magicByteSeq)) < 0)
-                    {
-                        return SL_RESULT_OPERATION_FAIL;
-                    }
-                    
-                    size_t dataCountGot;
-                    if (_channel->waitForData(1, 1, &dataCountGot)) {
-                        //got reply, stop
-                        break;
+                    rp::hal::AutoLocker l(_capture_lock);
+                    if (_capture_quit) break;
+                    job = _capture_job;
+                    _capture_job = NULL;
+                }
+                if (job) {
+                    while (IS_FAIL((this->*job)()) && _recoverLink()) {
+                        // the restarted scan goes back to the reactor, if any
+                        if (_attachReactor()) break;
+                        job = _scan_job;
                     }
                 }
-            }
-
-            // getback the bps measured
-            _u32 bpsDetected = 0;
-            size_t dataCountGot;
-            if (_channel->waitForData(4, 500, &dataCountGot)) {
-                //got reply, stop
-                _channel->read(&bpsDetected, 4);
-                if (baudRateDetected) *baudRateDetected = bpsDetected;
-
 
-                // send a confirmation to the LIDAR, otherwise, the previous baudrate will be reverted back
-                sl_lidar_payload_new_bps_confirmation_t confirmation;
-                confirmation.flag = 0x5F5F;
-                confirmation.required_bps = requiredBaudRate;
-                confirmation.param = 0;
-                if (SL_IS_FAIL(_sendCommand(RPLIDAR_CMD_NEW_BAUDRATE_CONFIRM, &confirmation, sizeof(confirmation))))
-                    return RESULT_OPERATION_FAIL;
+                rp::hal::AutoLocker l(_capture_lock);
+                if (!_capture_job) {
+                    _capture_busy = false;
+                    _captureIdleEvt.set();
+                }
+            }
+            return SL_RESULT_OK;
+        }
 
+        // Hand the scan over to the reactor set by setCaptureReactor, false without one or if it cannot poll the channel
+        bool _attachReactor()
+        {
+            rp::hal::AutoLocker l(_capture_lock);
+            if (!_capture_reactor || !_isScanning) return false;
+            int pollHandle = _channel->getPollHandle();
+            if (pollHandle < 0) return false;
+
+            // what the capture loop of the scan does before its first wait
+            _resetScanAccumulator();
+            _resetStallWatchdog(_samplesPerCaptureWait());
+            _reactor_discard = true;
+            _reactor_node_count = 0;
+            _reactor_wait_start_us = getus();
+
+            if (IS_FAIL(_capture_reactor->add(this, pollHandle))) return false;
+            _attached_reactor = _capture_reactor;
+            return true;
+        }
 
-                return RESULT_OK;
-            } 
-            
-            return RESULT_OPERATION_TIMEOUT;
+        // Take the scan out of its reactor, returns once no step of this driver runs anymore
+        void _detachReactor()
+        {
+            internal::LidarReactor* reactor;
+            {
+                rp::hal::AutoLocker l(_capture_lock);
+                reactor = _attached_reactor;
+                _attached_reactor = NULL;
+            }
+            if (reactor) reactor->remove(this);
         }
 
-    private:
-        
-        sl_result  _sendCommand(sl_u16 cmd, const void * payload = NULL, size_t payloadsize = 0 )
+        // Samples framed by each wait of the capture loop of the scan, as given to _resetStallWatchdog
+        size_t _samplesPerCaptureWait()
         {
-            sl_u8 checksum = 0;
+            switch (_scan_ans_type) {
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT:
+                return 256;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+                return 32;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+                return 40;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENTT_ULTRA_DENSE_CAPSULED:
+                return 64;
+            default:
+                return 96;
+            }
+        }
 
-            std::vector<sl_u8> cmd_packet;
-            cmd_packet.clear();
+        // Step of the scan on a reactor thread, the capture loop of the scan without its waits: frames and decodes
+        // what the channel received so far, reports the timeout of the wait once no frame came by the returned deadline
+        sl_u64 onReactorStep()
+        {
+            _serviceRequests();
 
-            if (payloadsize && payload) {
-                cmd |= SL_LIDAR_CMDFLAG_HAS_PAYLOAD;
+            bool framed = false;
+            while (_isScanning) {
+                sl_result ans = _reactorFrame();
+                // the rest of the frame has not arrived yet, the readiness of the channel resumes it
+                if (ans == SL_RESULT_OPERATION_TIMEOUT) break;
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, ans);
+                if (_reactor_discard && IS_OK(ans)) {
+                    // always discard the first data since it may be incomplete
+                    _reactor_discard = false;
+                    continue;
+                }
+                if (!_watchCaptureWait(ans)) return _reactorLinkLost();
+                if (IS_FAIL(ans)) {
+                    if (ans != SL_RESULT_INVALID_DATA) return _reactorLinkLost();
+                    // current data is invalid, do not use it.
+                    _countCaptureError(ans);
+                    continue;
+                }
+                framed = true;
+                _reactorDecode();
             }
-			_channel->flush();
-            cmd_packet.push_back(SL_LIDAR_CMD_SYNC_BYTE);
-            cmd_packet.push_back(cmd);
-			
-            if (cmd & SL_LIDAR_CMDFLAG_HAS_PAYLOAD) {
-                std::vector<sl_u8> payloadMsg;
-                checksum ^= SL_LIDAR_CMD_SYNC_BYTE;
-                checksum ^= cmd;
-                checksum ^= (payloadsize & 0xFF);
+            _flushReactorNodes();
+            if (!_isScanning) return 0;
 
-                // send size
-                sl_u8 sizebyte = payloadsize;
-                cmd_packet.push_back(sizebyte);
-                // calc checksum
-                for (size_t pos = 0; pos < payloadsize; ++pos) {
-                    checksum ^= ((sl_u8 *)payload)[pos];
-                    cmd_packet.push_back(((sl_u8 *)payload)[pos]);
-                }
-                cmd_packet.push_back(checksum);
-  
+            sl_u64 currentTs = getus();
+            sl_u64 waitTimeout = _captureWaitTimeout() * 1000ULL;
+            if (framed) {
+                _reactor_wait_start_us = currentTs;
             }
-            sl_u8 packet[1024];
-            for (sl_u32 pos = 0; pos < cmd_packet.size(); pos++) {
-                packet[pos] = cmd_packet[pos];
+            else if (currentTs >= _reactor_wait_start_us + waitTimeout) {
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, SL_RESULT_OPERATION_TIMEOUT);
+                if (!_watchCaptureWait(SL_RESULT_OPERATION_TIMEOUT)) return _reactorLinkLost();
+                _countCaptureError(SL_RESULT_OPERATION_TIMEOUT);
+                _reactor_wait_start_us = currentTs;
             }
-            _channel->write(packet, cmd_packet.size());
-            delay(1);
-            return SL_RESULT_OK;
+            return _reactor_wait_start_us + waitTimeout;
         }
 
-        sl_result _waitResponseHeader(sl_lidar_ans_header_t * header, sl_u32 timeout = DEFAULT_TIMEOUT)
+        // Frame what the channel received so far into _reactor_frame, TIMEOUT when the frame is still incomplete
+        sl_result _reactorFrame()
         {
-            int  recvPos = 0;
-            sl_u32 startTs = getms();
-            sl_u8  recvBuffer[sizeof(sl_lidar_ans_header_t)];
-            sl_u8  *headerBuffer = reinterpret_cast<sl_u8 *>(header);
-            sl_u32 waitTime;
-
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_ans_header_t) - recvPos;
-                size_t recvSize;
-
-                bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
-                if (!ans) return SL_RESULT_OPERATION_TIMEOUT;
-
-                if (recvSize > remainSize) recvSize = remainSize;
-
-                recvSize = _channel->read(recvBuffer, recvSize);
-
-                for (size_t pos = 0; pos < recvSize; ++pos) {
-                    sl_u8 currentByte = recvBuffer[pos];
-                    switch (recvPos) {
-                    case 0:
-                        if (currentByte != SL_LIDAR_ANS_SYNC_BYTE1) {
-                            continue;
-                        }
-
-                        break;
-                    case 1:
-                        if (currentByte != SL_LIDAR_ANS_SYNC_BYTE2) {
-                            recvPos = 0;
-                            continue;
-                        }
-                        break;
-                    }
-                    headerBuffer[recvPos++] = currentByte;
+            switch (_scan_ans_type) {
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT:
+                return _waitNode(&_reactor_frame.node, 0);
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+                return _waitCapsuledNode(_reactor_frame.capsule, 0);
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_HQ:
+                return _waitHqNode(_reactor_frame.hq_capsule, 0);
+            case SL_LIDAR_ANS_TYPE_MEASUREMENTT_ULTRA_DENSE_CAPSULED:
+                return _waitUltraDenseCapsuledNode(_reactor_frame.ultra_dense_capsule, 0);
+            default:
+                return _waitUltraCapsuledNode(_reactor_frame.ultra_capsule, 0);
+            }
+        }
 
-                    if (recvPos == sizeof(sl_lidar_ans_header_t)) {
-                        return SL_RESULT_OK;
-                    }
-                }
+        // Decode and publish the frame in _reactor_frame like the capture loop of the scan does
+        void _reactorDecode()
+        {
+            sl_lidar_response_measurement_node_hq_t local_buf[256];
+            size_t count = 0;
+            sl_u64 decodeStartTs = getus();
+            SL_TRACE_BEGIN(TRACE_DECODE);
+            switch (_scan_ans_type) {
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT:
+                // one node per frame, published by batches like the capture loop does
+                convert(_reactor_frame.node, _reactor_nodes[_reactor_node_count++]);
+                if (_reactor_node_count == _countof(_reactor_nodes)) _flushReactorNodes();
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_CAPSULED:
+                _capsuleToNormal(_reactor_frame.capsule, local_buf, count);
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED:
+                _dense_capsuleToNormal(_reactor_frame.capsule, local_buf, count);
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENT_HQ:
+                _HqToNormal(_reactor_frame.hq_capsule, local_buf, count);
+                break;
+            case SL_LIDAR_ANS_TYPE_MEASUREMENTT_ULTRA_DENSE_CAPSULED:
+                _recordDeviceStatus(_reactor_frame.ultra_dense_capsule.dev_status);
+                _ultra_dense_capsuleToNormal(_reactor_frame.ultra_dense_capsule, local_buf, count);
+                break;
+            default:
+                _ultraCapsuleToNormal(_reactor_frame.ultra_capsule, local_buf, count);
+                break;
             }
+            if (count) _publishScanNodes(local_buf, count);
+            _stats.observeDecodeTime(getus() - decodeStartTs);
+            SL_TRACE_END(TRACE_DECODE);
+        }
 
-            return SL_RESULT_OPERATION_TIMEOUT;
+        void _flushReactorNodes()
+        {
+            if (!_reactor_node_count) return;
+            _publishScanNodes(_reactor_nodes, _reactor_node_count);
+            _reactor_node_count = 0;
         }
 
-        template <typename T>
-        sl_result _waitResponse(T &payload ,sl_u8 ansType, sl_u32 timeout = DEFAULT_TIMEOUT)
+        // The link of the scan is lost during a step of the reactor, the recovery blocks so it runs on the capture worker
+        sl_u64 _reactorLinkLost()
         {
-            sl_lidar_ans_header_t response_header;
-            Result<nullptr_t> ans = SL_RESULT_OK;
-            //delay(100);
-            ans = _waitResponseHeader(&response_header, timeout);
-            if (!ans) 
-                return ans;
-            // verify whether we got a correct header
-            if (response_header.type != ansType) {
-                return SL_RESULT_INVALID_DATA;
-            }
-           // delay(50);
-            sl_u32 header_size = (response_header.size_q30_subtype & SL_LIDAR_ANS_HEADER_SIZE_MASK);
-            if (header_size < sizeof(T)) {
-                return SL_RESULT_INVALID_DATA;
-            }
-            if (!_channel->waitForData(header_size, timeout)) {
-                return SL_RESULT_OPERATION_TIMEOUT;
-            }
-            _channel->read(reinterpret_cast<sl_u8 *>(&payload), sizeof(T));
-            return SL_RESULT_OK;
+            _reactor_node_count = 0;
+            _captureFailed();
+            if (_isScanning && !_spawnCaptureWorker()) _isScanning = false;
+
+            rp::hal::AutoLocker l(_capture_lock);
+            // detached by _stopCapture meanwhile, which waits for this step to return
+            if (!_attached_reactor) return 0;
+            _attached_reactor = NULL;
+            if (_isScanning) _postCaptureJob(&SlamtecLidarDriver::_captureLinkLost);
+            return 0;
         }
 
-        void _disableDataGrabbing()
+        // Capture job of a scan whose link was lost in a reactor, fails right away so the worker recovers the link
+        sl_result _captureLinkLost()
         {
-            _clearRxDataCache();
-            _isScanning = false;
-            _cachethread.join();
+            return SL_RESULT_OPERATION_FAIL;
         }
         
 #define  MAX_SCAN_NODES  (8192)
         sl_result _waitNode(sl_lidar_response_measurement_node_t * node, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
-            int  recvPos = 0;
+            sl_u64 chunkTs = 0;
             sl_u32 startTs = getms();
             sl_u8  recvBuffer[sizeof(sl_lidar_response_measurement_node_t)];
-            sl_u8 *nodeBuffer = (sl_u8*)node;
-            sl_u32 waitTime;
+            sl_u8 *nodeBuffer = (sl_u8*)&_frame_buf;
+            sl_u32 waitTime = 0;
 
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_response_measurement_node_t) - recvPos;
+            // a zero timeout still frames the bytes already received
+            do {
+                size_t remainSize = sizeof(sl_lidar_response_measurement_node_t) - _frame_pos;
                 size_t recvSize;
 
                 bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
-                if (!ans) return SL_RESULT_OPERATION_FAIL;
+                if (!ans) return SL_RESULT_OPERATION_TIMEOUT;
 
                 if (recvSize > remainSize) recvSize = remainSize;
 
-                recvSize = _channel->read(recvBuffer, recvSize);
+                recvSize = _channel->readWithTimestamp(recvBuffer, recvSize, &chunkTs);
+                SL_TRACE_INSTANT(TRACE_BYTES_ARRIVED, recvSize);
 
                 for (size_t pos = 0; pos < recvSize; ++pos) {
                     sl_u8 currentByte = recvBuffer[pos];
-                    switch (recvPos) {
+                    switch (_frame_pos) {
                     case 0: // expect the sync bit and its reverse in this byte
                     {
                         sl_u8 tmp = (currentByte >> 1);
@@ -1242,19 +2804,24 @@ namespace sl {
                             // pass
                         }
                         else {
-                            recvPos = 0;
+                            _frame_pos = 0;
+                            internal::statAdd(_stats.resyncs);
                             continue;
                         }
                     }
                     break;
                     }
-                    nodeBuffer[recvPos++] = currentByte;
+                    if (!_frame_pos) _frame_ts = chunkTs;
+                    nodeBuffer[_frame_pos++] = currentByte;
 
-                    if (recvPos == sizeof(sl_lidar_response_measurement_node_t)) {
+                    if (_frame_pos == sizeof(sl_lidar_response_measurement_node_t)) {
+                        _frame_pos = 0;
+                        memcpy(node, nodeBuffer, sizeof(sl_lidar_response_measurement_node_t));
+                        _frame_arrival_us = _frame_ts;
                         return SL_RESULT_OK;
                     }
                 }
-            }
+            } while ((waitTime = getms() - startTs) <= timeout);
 
             return SL_RESULT_OPERATION_TIMEOUT;
         }
@@ -1288,50 +2855,39 @@ namespace sl {
         {
 
             sl_lidar_response_measurement_node_t      local_buf[256];
+            sl_lidar_response_measurement_node_hq_t   local_buf_hq[256];
             size_t                                   count = 256;
-            sl_lidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-            size_t                                   scan_count = 0;
             Result<nullptr_t>                        ans = SL_RESULT_OK;
-            memset(local_scan, 0, sizeof(local_scan));
+            _resetScanAccumulator();
+
+            _resetStallWatchdog(_countof(local_buf));
 
             _waitScanData(local_buf, count); // // always discard the first data since it may be incomplete
 
             while (_isScanning) {
-                ans = _waitScanData(local_buf, count);
+                _serviceRequests();
+                count = _countof(local_buf);
+                ans = _waitScanData(local_buf, count, _captureWaitTimeout());
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, (sl_result)ans);
+                if (!_watchCaptureWait(ans)) return _captureFailed();
    
                 if (!ans) {
                     if ((sl_result)ans != SL_RESULT_OPERATION_TIMEOUT) {
-                        _isScanning = false;
-                        return SL_RESULT_OPERATION_FAIL;
+                        return _captureFailed();
                     }
+                    // the nodes received before the timeout are incomplete, do not publish them
+                    _countCaptureError(ans);
+                    continue;
                 }
+                sl_u64 decodeStartTs = getus();
+                SL_TRACE_BEGIN(TRACE_DECODE);
 
                 for (size_t pos = 0; pos < count; ++pos) {
-                    if (local_buf[pos].sync_quality & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
-                        // only publish the data when it contains a full 360 degree scan 
-
-                        if ((local_scan[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                            _lock.lock();
-                            memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(sl_lidar_response_measurement_node_hq_t));
-                            _cached_scan_node_hq_count = scan_count;
-                            _dataEvt.set();
-                            _lock.unlock();
-                        }
-                        scan_count = 0;
-                    }
-
-                    sl_lidar_response_measurement_node_hq_t nodeHq;
-                    convert(local_buf[pos], nodeHq);
-                    local_scan[scan_count++] = nodeHq;
-                    if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-
-                    //for interval retrieve
-                    {
-                        rp::hal::AutoLocker l(_lock);
-                        _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = nodeHq;
-                        if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-                    }
+                    convert(local_buf[pos], local_buf_hq[pos]);
                 }
+                _publishScanNodes(local_buf_hq, count);
+                _stats.observeDecodeTime(getus() - decodeStartTs);
+                SL_TRACE_END(TRACE_DECODE);
             }
             _isScanning = false;
             return SL_RESULT_OK;
@@ -1452,24 +3008,26 @@ namespace sl {
 
         sl_result _waitCapsuledNode(sl_lidar_response_capsule_measurement_nodes_t & node, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
-            int  recvPos = 0;
+            sl_u64 chunkTs = 0;
             sl_u32 startTs = getms();
             sl_u8  recvBuffer[sizeof(sl_lidar_response_capsule_measurement_nodes_t)];
-            sl_u8 *nodeBuffer = (sl_u8*)&node;
-            sl_u32 waitTime;
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_response_capsule_measurement_nodes_t) - recvPos;
+            sl_u8 *nodeBuffer = (sl_u8*)&_frame_buf;
+            sl_u32 waitTime = 0;
+            // a zero timeout still frames the bytes already received
+            do {
+                size_t remainSize = sizeof(sl_lidar_response_capsule_measurement_nodes_t) - _frame_pos;
                 size_t recvSize;
                 bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
                 if (!ans) return SL_RESULT_OPERATION_TIMEOUT;
 
                 if (recvSize > remainSize) recvSize = remainSize;
-                recvSize = _channel->read(recvBuffer, recvSize);
+                recvSize = _channel->readWithTimestamp(recvBuffer, recvSize, &chunkTs);
+                SL_TRACE_INSTANT(TRACE_BYTES_ARRIVED, recvSize);
 
                 for (size_t pos = 0; pos < recvSize; ++pos) {
                     sl_u8 currentByte = recvBuffer[pos];
 
-                    switch (recvPos) {
+                    switch (_frame_pos) {
                     case 0: // expect the sync bit 1
                     {
                         sl_u8 tmp = (currentByte >> 4);
@@ -1490,15 +3048,19 @@ namespace sl {
                             // pass
                         }
                         else {
-                            recvPos = 0;
+                            _frame_pos = 0;
+                            internal::statAdd(_stats.resyncs);
                             _is_previous_capsuledataRdy = false;
                             continue;
                         }
                     }
                     break;
                     }
-                    nodeBuffer[recvPos++] = currentByte;
-                    if (recvPos == sizeof(sl_lidar_response_capsule_measurement_nodes_t)) {
+                    if (!_frame_pos) _frame_ts = chunkTs;
+                    nodeBuffer[_frame_pos++] = currentByte;
+                    if (_frame_pos == sizeof(sl_lidar_response_capsule_measurement_nodes_t)) {
+                        _frame_pos = 0;
+                        memcpy(&node, nodeBuffer, sizeof(sl_lidar_response_capsule_measurement_nodes_t));
                         // calc the checksum ...
                         sl_u8 checksum = 0;
                         sl_u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
@@ -1509,6 +3071,7 @@ namespace sl {
                         }
                         if (recvChecksum == checksum) {
                             // only consider vaild if the checksum matches...
+                            _frame_arrival_us = _frame_ts;
                             if (node.start_angle_sync_q6 & SL_LIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
                                 // this is the first capsule frame in logic, discard the previous cached data...
                                 _scan_node_synced = false;
@@ -1521,147 +3084,196 @@ namespace sl {
                         return SL_RESULT_INVALID_DATA;
                     }
                 }
-            }
-            _is_previous_capsuledataRdy = false;
+            } while ((waitTime = getms() - startTs) <= timeout);
             return SL_RESULT_OPERATION_TIMEOUT;
         }
+        int _getCapsuleAngleDiff_q8(int prevStartAngle_q8, int currentStartAngle_q8)
+        {
+            int diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
+            if (prevStartAngle_q8 > currentStartAngle_q8) {
+                diffAngle_q8 += (360 << 8);
+            }
+            // the latest measured span is used as the estimate for the capsule in progress
+            _predicted_diffAngle_q8 = diffAngle_q8;
+            return diffAngle_q8;
+        }
+
+        // Span of the capsule decoded ahead in predictive mode, aimed at its extrapolated end
+        // It starts where the previous capsule decoded ahead ended, so the error of the previous estimate is corrected
+        // by this capsule instead of leaving a gap or an overlap, and the revolution boundary is crossed exactly once.
+        void _predictCapsuleSpan(int currentStartAngle_q8, int& startAngle_q8, int& diffAngle_q8)
+        {
+            int targetEnd_q8 = (currentStartAngle_q8 + _predicted_diffAngle_q8) % (360 << 8);
+            startAngle_q8 = currentStartAngle_q8;
+            diffAngle_q8 = _predicted_diffAngle_q8;
+            if (_is_previous_capsuledataRdy && _predicted_end_q8 >= 0) {
+                int span_q8 = ((targetEnd_q8 - _predicted_end_q8) % (360 << 8) + (360 << 8)) % (360 << 8);
+                // a residual larger than the span itself is a glitch of the stream, restart from the received angle
+                if (span_q8 > 0 && span_q8 <= 2 * _predicted_diffAngle_q8) {
+                    startAngle_q8 = _predicted_end_q8;
+                    diffAngle_q8 = span_q8;
+                }
+            }
+            _predicted_end_q8 = targetEnd_q8;
+        }
+
         void _capsuleToNormal(const sl_lidar_response_capsule_measurement_nodes_t & capsule, sl_lidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
         {
             nodeCount = 0;
+            int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 2);
             if (_is_previous_capsuledataRdy) {
-                int diffAngle_q8;
-                int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 2);
                 int prevStartAngle_q8 = ((_cached_previous_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
-
-                diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
-                if (prevStartAngle_q8 > currentStartAngle_q8) {
-                    diffAngle_q8 += (360 << 8);
+                int diffAngle_q8 = _getCapsuleAngleDiff_q8(prevStartAngle_q8, currentStartAngle_q8);
+
+                if (!_predictive_decode) {
+                    _decodeCapsule(_cached_previous_capsuledata, prevStartAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
                 }
+            }
 
-                int angleInc_q16 = (diffAngle_q8 << 3);
-                int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-                for (size_t pos = 0; pos < _countof(_cached_previous_capsuledata.cabins); ++pos) {
-                    int dist_q2[2];
-                    int angle_q6[2];
-                    int syncBit[2];
+            if (_predictive_decode && _predicted_diffAngle_q8) {
+                int startAngle_q8, diffAngle_q8;
+                _predictCapsuleSpan(currentStartAngle_q8, startAngle_q8, diffAngle_q8);
+                _decodeCapsule(capsule, startAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
+            }
 
-                    dist_q2[0] = (_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0xFFFC);
-                    dist_q2[1] = (_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0xFFFC);
+            _cached_previous_capsuledata = capsule;
+            _is_previous_capsuledataRdy = true;
+        }
 
-                    int angle_offset1_q3 = ((_cached_previous_capsuledata.cabins[pos].offset_angles_q3 & 0xF) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0x3) << 4));
-                    int angle_offset2_q3 = ((_cached_previous_capsuledata.cabins[pos].offset_angles_q3 >> 4) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0x3) << 4));
+        void _decodeCapsule(const sl_lidar_response_capsule_measurement_nodes_t & capsule, int startAngle_q8, int diffAngle_q8, sl_lidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+        {
+            int angleInc_q16 = (diffAngle_q8 << 3);
+            int currentAngle_raw_q16 = (startAngle_q8 << 8);
+            for (size_t pos = 0; pos < _countof(capsule.cabins); ++pos) {
+                int dist_q2[2];
+                int angle_q6[2];
+                int syncBit[2];
 
-                    angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3 << 13)) >> 10);
-                    syncBit[0] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-                    currentAngle_raw_q16 += angleInc_q16;
+                dist_q2[0] = (capsule.cabins[pos].distance_angle_1 & 0xFFFC);
+                dist_q2[1] = (capsule.cabins[pos].distance_angle_2 & 0xFFFC);
 
+                int angle_offset1_q3 = ((capsule.cabins[pos].offset_angles_q3 & 0xF) | ((capsule.cabins[pos].distance_angle_1 & 0x3) << 4));
+                int angle_offset2_q3 = ((capsule.cabins[pos].offset_angles_q3 >> 4) | ((capsule.cabins[pos].distance_angle_2 & 0x3) << 4));
 
-                    angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3 << 13)) >> 10);
-                    syncBit[1] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-                    currentAngle_raw_q16 += angleInc_q16;
+                angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3 << 13)) >> 10);
+                syncBit[0] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+                currentAngle_raw_q16 += angleInc_q16;
 
-                    for (int cpos = 0; cpos < 2; ++cpos) {
 
-                        if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
-                        if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
+                angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3 << 13)) >> 10);
+                syncBit[1] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+                currentAngle_raw_q16 += angleInc_q16;
 
-                        sl_lidar_response_measurement_node_hq_t node;
+                for (int cpos = 0; cpos < 2; ++cpos) {
 
-                        node.angle_z_q14 = sl_u16((angle_q6[cpos] << 8) / 90);
-                        node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
-                        node.quality = dist_q2[cpos] ? (0x2f << SL_LIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                        node.dist_mm_q2 = dist_q2[cpos];
+                    if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
+                    if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
 
-                        nodebuffer[nodeCount++] = node;
-                    }
+                    sl_lidar_response_measurement_node_hq_t node;
+
+                    node.angle_z_q14 = sl_u16((angle_q6[cpos] << 8) / 90);
+                    node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
+                    node.quality = dist_q2[cpos] ? (0x2f << SL_LIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+                    node.dist_mm_q2 = dist_q2[cpos];
 
+                    nodebuffer[nodeCount++] = node;
                 }
-            }
 
-            _cached_previous_capsuledata = capsule;
-            _is_previous_capsuledataRdy = true;
+            }
         }
 
         void _dense_capsuleToNormal(const sl_lidar_response_capsule_measurement_nodes_t & capsule, sl_lidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
         {
-            static int lastNodeSyncBit = 0;
             const sl_lidar_response_dense_capsule_measurement_nodes_t *dense_capsule = reinterpret_cast<const sl_lidar_response_dense_capsule_measurement_nodes_t*>(&capsule);
             nodeCount = 0;
+            int currentStartAngle_q8 = ((dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
             if (_is_previous_capsuledataRdy) {
-                int diffAngle_q8;
-                int currentStartAngle_q8 = ((dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
                 int prevStartAngle_q8 = ((_cached_previous_dense_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+                int diffAngle_q8 = _getCapsuleAngleDiff_q8(prevStartAngle_q8, currentStartAngle_q8);
 
-                diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
-                if (prevStartAngle_q8 > currentStartAngle_q8) {
-                    diffAngle_q8 += (360 << 8);
-                }
-
-                int angleInc_q16 = (diffAngle_q8 << 8) / 40;
-                int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-                for (size_t pos = 0; pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos) {
-                    int dist_q2;
-                    int angle_q6;
-                    int syncBit;
-                    const int dist = static_cast<const int>(_cached_previous_dense_capsuledata.cabins[pos].distance);
-                    dist_q2 = dist << 2;
-                    angle_q6 = (currentAngle_raw_q16 >> 10);
-
-                    syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < (angleInc_q16<<1)) ? 1 : 0;
-                    syncBit = (syncBit^ lastNodeSyncBit)&syncBit;//Ensure that syncBit is exactly detected
-                    if (syncBit) {
-                        _scan_node_synced = true;
-                    }
-
-                    currentAngle_raw_q16 += angleInc_q16;
-
-                    if (angle_q6 < 0) angle_q6 += (360 << 6);
-                    if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
-
-                    
-                    sl_lidar_response_measurement_node_hq_t node;
-
-                    node.angle_z_q14 = sl_u16((angle_q6 << 8) / 90);
-                    node.flag = (syncBit | ((!syncBit) << 1));
-                    node.quality = dist_q2 ? (0x2f << SL_LIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                    node.dist_mm_q2 = dist_q2;
-                    if(_scan_node_synced)
-                        nodebuffer[nodeCount++] = node;
-                    lastNodeSyncBit = syncBit;
+                if (!_predictive_decode) {
+                    _decodeDenseCapsule(_cached_previous_dense_capsuledata, prevStartAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
                 }
             }
             else {
                 _scan_node_synced = false;
             }
 
+            if (_predictive_decode && _predicted_diffAngle_q8) {
+                int startAngle_q8, diffAngle_q8;
+                _predictCapsuleSpan(currentStartAngle_q8, startAngle_q8, diffAngle_q8);
+                _decodeDenseCapsule(*dense_capsule, startAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
+            }
+
             _cached_previous_dense_capsuledata = *dense_capsule;
             _is_previous_capsuledataRdy = true;
         }
 
+        void _decodeDenseCapsule(const sl_lidar_response_dense_capsule_measurement_nodes_t & dense_capsule, int startAngle_q8, int diffAngle_q8, sl_lidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+        {
+            static int lastNodeSyncBit = 0;
+            int angleInc_q16 = (diffAngle_q8 << 8) / 40;
+            int currentAngle_raw_q16 = (startAngle_q8 << 8);
+            for (size_t pos = 0; pos < _countof(dense_capsule.cabins); ++pos) {
+                int dist_q2;
+                int angle_q6;
+                int syncBit;
+                const int dist = static_cast<const int>(dense_capsule.cabins[pos].distance);
+                dist_q2 = dist << 2;
+                angle_q6 = (currentAngle_raw_q16 >> 10);
+
+                syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < (angleInc_q16<<1)) ? 1 : 0;
+                syncBit = (syncBit^ lastNodeSyncBit)&syncBit;//Ensure that syncBit is exactly detected
+                if (syncBit) {
+                    _scan_node_synced = true;
+                }
+
+                currentAngle_raw_q16 += angleInc_q16;
+
+                if (angle_q6 < 0) angle_q6 += (360 << 6);
+                if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
+
+                
+                sl_lidar_response_measurement_node_hq_t node;
+
+                node.angle_z_q14 = sl_u16((angle_q6 << 8) / 90);
+                node.flag = (syncBit | ((!syncBit) << 1));
+                node.quality = dist_q2 ? (0x2f << SL_LIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+                node.dist_mm_q2 = dist_q2;
+                if(_scan_node_synced)
+                    nodebuffer[nodeCount++] = node;
+                lastNodeSyncBit = syncBit;
+            }
+        }
+
         sl_result _cacheCapsuledScanData()
         {
             sl_lidar_response_capsule_measurement_nodes_t    capsule_node;
             sl_lidar_response_measurement_node_hq_t          local_buf[256];
             size_t                                           count = 256;
-            sl_lidar_response_measurement_node_hq_t          local_scan[MAX_SCAN_NODES];
-            size_t                                           scan_count = 0;
             Result<nullptr_t>                                ans = SL_RESULT_OK;  
-            memset(local_scan, 0, sizeof(local_scan));
+            _resetScanAccumulator();
+            _resetStallWatchdog((_cached_capsule_flag == DENSE_CAPSULE) ? 40 : 32);
 
             _waitCapsuledNode(capsule_node); // // always discard the first data since it may be incomplete
 
             while (_isScanning) {
-                ans = _waitCapsuledNode(capsule_node);
+                _serviceRequests();
+                ans = _waitCapsuledNode(capsule_node, _captureWaitTimeout());
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, (sl_result)ans);
+                if (!_watchCaptureWait(ans)) return _captureFailed();
                 if (!ans) {
                     if ((sl_result)ans != SL_RESULT_OPERATION_TIMEOUT && (sl_result)ans != SL_RESULT_INVALID_DATA) {
-                        _isScanning = false;
-                        return SL_RESULT_OPERATION_FAIL;
+                        return _captureFailed();
                     }
                     else {
                         // current data is invalid, do not use it.
+                        _countCaptureError(ans);
                         continue;
                     }
                 }
+                sl_u64 decodeStartTs = getus();
+                SL_TRACE_BEGIN(TRACE_DECODE);
                 switch (_cached_capsule_flag) {
                 case NORMAL_CAPSULE:
                     _capsuleToNormal(capsule_node, local_buf, count);
@@ -1672,29 +3284,9 @@ namespace sl {
                 }
                 //
 
-                for (size_t pos = 0; pos < count; ++pos) {
-                    if (local_buf[pos].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
-                        // only publish the data when it contains a full 360 degree scan 
-
-                        if ((local_scan[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                            _lock.lock();
-                            memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(sl_lidar_response_measurement_node_hq_t));
-                            _cached_scan_node_hq_count = scan_count;
-                            _dataEvt.set();
-                            _lock.unlock();
-                        }
-                        scan_count = 0;
-                    }
-                    local_scan[scan_count++] = local_buf[pos];
-                    if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-
-                    //for interval retrieve
-                    {
-                        rp::hal::AutoLocker l(_lock);
-                        _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                        if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-                    }
-                }
+                _publishScanNodes(local_buf, count);
+                _stats.observeDecodeTime(getus() - decodeStartTs);
+                SL_TRACE_END(TRACE_DECODE);
             }
             _isScanning = false;
 
@@ -1703,24 +3295,26 @@ namespace sl {
 
         sl_result _waitUltraDenseCapsuledNode(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t& node, sl_u32 timeout = DEFAULT_TIMEOUT)
         {
-            int  recvPos = 0;
+            sl_u64 chunkTs = 0;
             sl_u32 startTs = getms();
             sl_u8  recvBuffer[sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t)];
-            sl_u8* nodeBuffer = (sl_u8*)&node;
-            sl_u32 waitTime;
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t) - recvPos;
+            sl_u8 *nodeBuffer = (sl_u8*)&_frame_buf;
+            sl_u32 waitTime = 0;
+            // a zero timeout still frames the bytes already received
+            do {
+                size_t remainSize = sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t) - _frame_pos;
                 size_t recvSize;
                 bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
                 if (!ans) return SL_RESULT_OPERATION_TIMEOUT;
 
                 if (recvSize > remainSize) recvSize = remainSize;
-                recvSize = _channel->read(recvBuffer, recvSize);
+                recvSize = _channel->readWithTimestamp(recvBuffer, recvSize, &chunkTs);
+                SL_TRACE_INSTANT(TRACE_BYTES_ARRIVED, recvSize);
 
                 for (size_t pos = 0; pos < recvSize; ++pos) {
                     sl_u8 currentByte = recvBuffer[pos];
 
-                    switch (recvPos) {
+                    switch (_frame_pos) {
                     case 0: // expect the sync bit 1
                     {
                         sl_u8 tmp = (currentByte >> 4);
@@ -1741,15 +3335,19 @@ namespace sl {
                             // pass
                         }
                         else {
-                            recvPos = 0;
+                            _frame_pos = 0;
+                            internal::statAdd(_stats.resyncs);
                             _is_previous_capsuledataRdy = false;
                             continue;
                         }
                     }
                     break;
                     }
-                    nodeBuffer[recvPos++] = currentByte;
-                    if (recvPos == sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t)) {
+                    if (!_frame_pos) _frame_ts = chunkTs;
+                    nodeBuffer[_frame_pos++] = currentByte;
+                    if (_frame_pos == sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t)) {
+                        _frame_pos = 0;
+                        memcpy(&node, nodeBuffer, sizeof(sl_lidar_response_ultra_dense_capsule_measurement_nodes_t));
                         // calc the checksum ...
                         sl_u8 checksum = 0;
                         sl_u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
@@ -1760,6 +3358,7 @@ namespace sl {
                         }
                         if (recvChecksum == checksum) {
                             // only consider vaild if the checksum matches...
+                            _frame_arrival_us = _frame_ts;
                             if (node.start_angle_sync_q6 & SL_LIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
                                 // this is the first capsule frame in logic, discard the previous cached data...
                                 _scan_node_synced = false;
@@ -1772,96 +3371,104 @@ namespace sl {
                         return SL_RESULT_INVALID_DATA;
                     }
                 }
-            }
-            _is_previous_capsuledataRdy = false;
+            } while ((waitTime = getms() - startTs) <= timeout);
             return SL_RESULT_OPERATION_TIMEOUT;
         }
 
         void _ultra_dense_capsuleToNormal(const sl_lidar_response_ultra_dense_capsule_measurement_nodes_t& capslue, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& nodeCount)
         {
-            static int lastNodeSyncBit = 0;
             const sl_lidar_response_ultra_dense_capsule_measurement_nodes_t* ultra_dense_capsule = reinterpret_cast<const sl_lidar_response_ultra_dense_capsule_measurement_nodes_t*>(&capslue);
             nodeCount = 0;
+            int currentStartAngle_q8 = ((ultra_dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
             if (_is_previous_capsuledataRdy) {
-                int diffAngle_q8;
-                int currentStartAngle_q8 = ((ultra_dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
                 int prevStartAngle_q8 = ((_cached_previous_ultra_dense_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+                int diffAngle_q8 = _getCapsuleAngleDiff_q8(prevStartAngle_q8, currentStartAngle_q8);
 
-                diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
-                if (prevStartAngle_q8 > currentStartAngle_q8) {
-                    diffAngle_q8 += (360 << 8);
+                if (!_predictive_decode) {
+                    _decodeUltraDenseCapsule(_cached_previous_ultra_dense_capsuledata, prevStartAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
                 }
+            }
+            else {
+                _scan_node_synced = false;
+            }
+
+            if (_predictive_decode && _predicted_diffAngle_q8) {
+                int startAngle_q8, diffAngle_q8;
+                _predictCapsuleSpan(currentStartAngle_q8, startAngle_q8, diffAngle_q8);
+                _decodeUltraDenseCapsule(*ultra_dense_capsule, startAngle_q8, diffAngle_q8, nodebuffer, nodeCount);
+            }
+
+            _cached_previous_ultra_dense_capsuledata = *ultra_dense_capsule;
+            _is_previous_capsuledataRdy = true;
+        }
+
+        void _decodeUltraDenseCapsule(const sl_lidar_response_ultra_dense_capsule_measurement_nodes_t& ultra_dense_capsule, int startAngle_q8, int diffAngle_q8, sl_lidar_response_measurement_node_hq_t* nodebuffer, size_t& nodeCount)
+        {
+            static int lastNodeSyncBit = 0;
 #define DISTANCE_THRESHOLD_TO_SCALE_1 2046
 #define DISTANCE_THRESHOLD_TO_SCALE_2 8187  // (2^11-1)*3 + 2046
 #define DISTANCE_THRESHOLD_TO_SCALE_3 24567
-                int angleInc_q16 = (diffAngle_q8 << 8) / 64;
-                int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-                for (size_t pos = 0; pos < (_countof(_cached_previous_ultra_dense_capsuledata.cabins)*2); ++pos) {
-
-                    int angle_q6;
-                    int syncBit;
-                    size_t cabin_idx = pos >> 1;
-                    sl_u32 quality_dist_scale;
-                    if (!(pos&0x1)) {
-                         quality_dist_scale = _cached_previous_ultra_dense_capsuledata.cabins[cabin_idx].qualityl_distance_scale[0] | ((_cached_previous_ultra_dense_capsuledata.cabins[cabin_idx].qualityh_array & 0x0F) << 16);
-                    }
-                    else {
-                         quality_dist_scale = _cached_previous_ultra_dense_capsuledata.cabins[cabin_idx].qualityl_distance_scale[1] | ((_cached_previous_ultra_dense_capsuledata.cabins[cabin_idx].qualityh_array >> 4) << 16);
-                    }
-                    
-                    sl_u8 scale = quality_dist_scale & 0x3;
-                    sl_u8 quality = 0;
-                    int dist_q2 = 0;
-                    switch (scale) {
-                    case 0:
-                        quality = quality_dist_scale >> 12;
-                        dist_q2 = (quality_dist_scale & 0xFFC) * 2;
-                        break;
-                    case 1:
-                        quality = (quality_dist_scale >> 13)<<1;
-                        dist_q2 = (quality_dist_scale & 0x1FFC) * 3 +(DISTANCE_THRESHOLD_TO_SCALE_1<<2);
-                        break;
-                    case 2:
-                        quality = (quality_dist_scale >> 14) << 2;
-                        dist_q2 = (quality_dist_scale & 0x3FFC) * 4 + (DISTANCE_THRESHOLD_TO_SCALE_2<<2);
-                        break;
-                    case 3:
-                        quality = (quality_dist_scale >> 15) << 3;
-                        dist_q2 = (quality_dist_scale & 0x7FFC) * 5+ (DISTANCE_THRESHOLD_TO_SCALE_3<<2);
-                        break;
-                    }
+            int angleInc_q16 = (diffAngle_q8 << 8) / 64;
+            int currentAngle_raw_q16 = (startAngle_q8 << 8);
+            for (size_t pos = 0; pos < (_countof(ultra_dense_capsule.cabins)*2); ++pos) {
+
+                int angle_q6;
+                int syncBit;
+                size_t cabin_idx = pos >> 1;
+                sl_u32 quality_dist_scale;
+                if (!(pos&0x1)) {
+                     quality_dist_scale = ultra_dense_capsule.cabins[cabin_idx].qualityl_distance_scale[0] | ((ultra_dense_capsule.cabins[cabin_idx].qualityh_array & 0x0F) << 16);
+                }
+                else {
+                     quality_dist_scale = ultra_dense_capsule.cabins[cabin_idx].qualityl_distance_scale[1] | ((ultra_dense_capsule.cabins[cabin_idx].qualityh_array >> 4) << 16);
+                }
+                
+                sl_u8 scale = quality_dist_scale & 0x3;
+                sl_u8 quality = 0;
+                int dist_q2 = 0;
+                switch (scale) {
+                case 0:
+                    quality = quality_dist_scale >> 12;
+                    dist_q2 = (quality_dist_scale & 0xFFC) * 2;
+                    break;
+                case 1:
+                    quality = (quality_dist_scale >> 13)<<1;
+                    dist_q2 = (quality_dist_scale & 0x1FFC) * 3 +(DISTANCE_THRESHOLD_TO_SCALE_1<<2);
+                    break;
+                case 2:
+                    quality = (quality_dist_scale >> 14) << 2;
+                    dist_q2 = (quality_dist_scale & 0x3FFC) * 4 + (DISTANCE_THRESHOLD_TO_SCALE_2<<2);
+                    break;
+                case 3:
+                    quality = (quality_dist_scale >> 15) << 3;
+                    dist_q2 = (quality_dist_scale & 0x7FFC) * 5+ (DISTANCE_THRESHOLD_TO_SCALE_3<<2);
+                    break;
+                }
  
-                    angle_q6 = (currentAngle_raw_q16 >> 10);
+                angle_q6 = (currentAngle_raw_q16 >> 10);
 
-                    syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < (angleInc_q16 << 1)) ? 1 : 0;
-                    syncBit = (syncBit ^ lastNodeSyncBit) & syncBit;//Ensure that syncBit is exactly detected
-                    if (syncBit) {
-                        _scan_node_synced = true;
-                    }
+                syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < (angleInc_q16 << 1)) ? 1 : 0;
+                syncBit = (syncBit ^ lastNodeSyncBit) & syncBit;//Ensure that syncBit is exactly detected
+                if (syncBit) {
+                    _scan_node_synced = true;
+                }
 
-                    currentAngle_raw_q16 += angleInc_q16;
+                currentAngle_raw_q16 += angleInc_q16;
 
-                    if (angle_q6 < 0) angle_q6 += (360 << 6);
-                    if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
+                if (angle_q6 < 0) angle_q6 += (360 << 6);
+                if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
 
 
-                    sl_lidar_response_measurement_node_hq_t node;
+                sl_lidar_response_measurement_node_hq_t node;
 
-                    node.angle_z_q14 = sl_u16((angle_q6 << 8) / 90);
-                    node.flag = (syncBit | ((!syncBit) << 1));
-                    node.quality = quality;
-                    node.dist_mm_q2 = dist_q2;
-                    if (_scan_node_synced)
-                        nodebuffer[nodeCount++] = node;
-                    lastNodeSyncBit = syncBit;
-                }
-            }
-            else {
-                _scan_node_synced = false;
+                node.angle_z_q14 = sl_u16((angle_q6 << 8) / 90);
+                node.flag = (syncBit | ((!syncBit) << 1));
+                node.quality = quality;
+                node.dist_mm_q2 = dist_q2;
+                if (_scan_node_synced)
+                    nodebuffer[nodeCount++] = node;
+                lastNodeSyncBit = syncBit;
             }
-
-            _cached_previous_ultra_dense_capsuledata = *ultra_dense_capsule;
-            _is_previous_capsuledataRdy = true;
         }
 
         sl_result _cacheUltraDenseCapsuledScanData()
@@ -1870,51 +3477,36 @@ namespace sl {
             sl_lidar_response_ultra_dense_capsule_measurement_nodes_t ultra_dense_capsule_node;
             sl_lidar_response_measurement_node_hq_t          local_buf[256];
             size_t                                           count = 256;
-            sl_lidar_response_measurement_node_hq_t          local_scan[MAX_SCAN_NODES];
-            size_t                                           scan_count = 0;
             Result<nullptr_t>                                ans = SL_RESULT_OK;
-            memset(local_scan, 0, sizeof(local_scan));
+            _resetScanAccumulator();
+            _resetStallWatchdog(64);
 
             _waitUltraDenseCapsuledNode(ultra_dense_capsule_node); // // always discard the first data since it may be incomplete
 
             while (_isScanning) {
-                ans = _waitUltraDenseCapsuledNode(ultra_dense_capsule_node);
+                _serviceRequests();
+                ans = _waitUltraDenseCapsuledNode(ultra_dense_capsule_node, _captureWaitTimeout());
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, (sl_result)ans);
+                if (!_watchCaptureWait(ans)) return _captureFailed();
                 if (!ans) {
                     if ((sl_result)ans != SL_RESULT_OPERATION_TIMEOUT && (sl_result)ans != SL_RESULT_INVALID_DATA) {
-                        _isScanning = false;
-                        return SL_RESULT_OPERATION_FAIL;
+                        return _captureFailed();
                     }
                     else {
                         // current data is invalid, do not use it.
+                        _countCaptureError(ans);
                         continue;
                     }
                 }
+                sl_u64 decodeStartTs = getus();
+                SL_TRACE_BEGIN(TRACE_DECODE);
+                _recordDeviceStatus(ultra_dense_capsule_node.dev_status);
                 _ultra_dense_capsuleToNormal(ultra_dense_capsule_node, local_buf, count);
 
 
-                for (size_t pos = 0; pos < count; ++pos) {
-                    if (local_buf[pos].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
-                        // only publish the data when it contains a full 360 degree scan 
-
-                        if ((local_scan[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                            _lock.lock();
-                            memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(sl_lidar_response_measurement_node_hq_t));
-                            _cached_scan_node_hq_count = scan_count;
-                            _dataEvt.set();
-                            _lock.unlock();
-                        }
-                        scan_count = 0;
-                    }
-                    local_scan[scan_count++] = local_buf[pos];
-                    if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-
-                    //for interval retrieve
-                    {
-                        rp::hal::AutoLocker l(_lock);
-                        _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                        if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-                    }
-                }
+                _publishScanNodes(local_buf, count);
+                _stats.observeDecodeTime(getus() - decodeStartTs);
+                SL_TRACE_END(TRACE_DECODE);
             }
             _isScanning = false;
 
@@ -1926,14 +3518,15 @@ namespace sl {
                 return SL_RESULT_OPERATION_FAIL;
             }
 
-            int  recvPos = 0;
+            sl_u64 chunkTs = 0;
             sl_u32 startTs = getms();
             sl_u8  recvBuffer[sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t)];
-            sl_u8 *nodeBuffer = (sl_u8*)&node;
-            sl_u32 waitTime;
+            sl_u8 *nodeBuffer = (sl_u8*)&_frame_buf;
+            sl_u32 waitTime = 0;
 
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t) - recvPos;
+            // a zero timeout still frames the bytes already received
+            do {
+                size_t remainSize = sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t) - _frame_pos;
                 size_t recvSize;
 
                 bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
@@ -1942,11 +3535,12 @@ namespace sl {
                 }
                 if (recvSize > remainSize) recvSize = remainSize;
 
-                recvSize = _channel->read(recvBuffer, recvSize);
+                recvSize = _channel->readWithTimestamp(recvBuffer, recvSize, &chunkTs);
+                SL_TRACE_INSTANT(TRACE_BYTES_ARRIVED, recvSize);
 
                 for (size_t pos = 0; pos < recvSize; ++pos) {
                     sl_u8 currentByte = recvBuffer[pos];
-                    switch (recvPos) {
+                    switch (_frame_pos) {
                     case 0: // expect the sync byte
                     {
                         sl_u8 tmp = (currentByte);
@@ -1954,8 +3548,8 @@ namespace sl {
                             // pass
                         }
                         else {
-                            recvPos = 0;
-                            _is_previous_HqdataRdy = false;
+                            _frame_pos = 0;
+                            internal::statAdd(_stats.resyncs);
                             continue;
                         }
                     }
@@ -1971,37 +3565,34 @@ namespace sl {
                     }
                     break;
                     }
-                    nodeBuffer[recvPos++] = currentByte;
-                    if (recvPos == sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t)) {
+                    if (!_frame_pos) _frame_ts = chunkTs;
+                    nodeBuffer[_frame_pos++] = currentByte;
+                    if (_frame_pos == sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t)) {
+                        _frame_pos = 0;
+                        memcpy(&node, nodeBuffer, sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t));
                         sl_u32 crcCalc2 = crc32::getResult(nodeBuffer, sizeof(sl_lidar_response_hq_capsule_measurement_nodes_t) - 4);
 
                         if (crcCalc2 == node.crc32) {
-                            _is_previous_HqdataRdy = true;
+                            _frame_arrival_us = _frame_ts;
                             return SL_RESULT_OK;
                         }
                         else {
-                            _is_previous_HqdataRdy = false;
                             return SL_RESULT_INVALID_DATA;
                         }
 
                     }
                 }
-            }
-            _is_previous_HqdataRdy = false;
+            } while ((waitTime = getms() - startTs) <= timeout);
             return SL_RESULT_OPERATION_TIMEOUT;
         }
 
         void _HqToNormal(const sl_lidar_response_hq_capsule_measurement_nodes_t & node_hq, sl_lidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
         {
+            // HQ capsules carry the absolute angle of every node, no need to wait for the next capsule
             nodeCount = 0;
-            if (_is_previous_HqdataRdy) {
-                for (size_t pos = 0; pos < _countof(_cached_previous_Hqdata.node_hq); ++pos) {
-                    nodebuffer[nodeCount++] = node_hq.node_hq[pos];
-                }
+            for (size_t pos = 0; pos < _countof(node_hq.node_hq); ++pos) {
+                nodebuffer[nodeCount++] = node_hq.node_hq[pos];
             }
-            _cached_previous_Hqdata = node_hq;
-            _is_previous_HqdataRdy = true;
-
         }
 
         sl_result _cacheHqScanData()
@@ -2009,46 +3600,32 @@ namespace sl {
             sl_lidar_response_hq_capsule_measurement_nodes_t    hq_node;
             sl_lidar_response_measurement_node_hq_t   local_buf[256];
             size_t                                   count = 256;
-            sl_lidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-            size_t                                   scan_count = 0;
             Result<nullptr_t>                             ans = SL_RESULT_OK;
-            memset(local_scan, 0, sizeof(local_scan));
+            _resetScanAccumulator();
+            _resetStallWatchdog(96);
             _waitHqNode(hq_node);
             while (_isScanning) {
-                ans = _waitHqNode(hq_node);
+                _serviceRequests();
+                ans = _waitHqNode(hq_node, _captureWaitTimeout());
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, (sl_result)ans);
+                if (!_watchCaptureWait(ans)) return _captureFailed();
                 if (!ans) {
                     if ((sl_result)ans != SL_RESULT_OPERATION_TIMEOUT && (sl_result)ans != SL_RESULT_INVALID_DATA) {
-                        _isScanning = false;
-                        return SL_RESULT_OPERATION_FAIL;
+                        return _captureFailed();
                     }
                     else {
                         // current data is invalid, do not use it.
+                        _countCaptureError(ans);
                         continue;
                     }
                 }
+                sl_u64 decodeStartTs = getus();
+                SL_TRACE_BEGIN(TRACE_DECODE);
 
                 _HqToNormal(hq_node, local_buf, count);
-                for (size_t pos = 0; pos < count; ++pos){
-                    if (local_buf[pos].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT){
-                        // only publish the data when it contains a full 360 degree scan 
-                        if ((local_scan[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                            _lock.lock();
-                            memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(sl_lidar_response_measurement_node_hq_t));
-                            _cached_scan_node_hq_count = scan_count;
-                            _dataEvt.set();
-                            _lock.unlock();
-                        }
-                        scan_count = 0;
-                    }
-                    local_scan[scan_count++] = local_buf[pos];
-                    if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-                                                                             //for interval retrieve
-                    {
-                        rp::hal::AutoLocker l(_lock);
-                        _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                        if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-                    }
-                }
+                _publishScanNodes(local_buf, count);
+                _stats.observeDecodeTime(getus() - decodeStartTs);
+                SL_TRACE_END(TRACE_DECODE);
 
             }
             return SL_RESULT_OK;
@@ -2060,14 +3637,15 @@ namespace sl {
                 return SL_RESULT_OPERATION_FAIL;
             }
 
-            int  recvPos = 0;
+            sl_u64 chunkTs = 0;
             sl_u32 startTs = getms();
             sl_u8  recvBuffer[sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t)];
-            sl_u8 *nodeBuffer = (sl_u8*)&node;
-            sl_u32 waitTime;
+            sl_u8 *nodeBuffer = (sl_u8*)&_frame_buf;
+            sl_u32 waitTime = 0;
 
-            while ((waitTime = getms() - startTs) <= timeout) {
-                size_t remainSize = sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t) - recvPos;
+            // a zero timeout still frames the bytes already received
+            do {
+                size_t remainSize = sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t) - _frame_pos;
                 size_t recvSize;
 
                 bool ans = _channel->waitForData(remainSize, timeout - waitTime, &recvSize);
@@ -2076,11 +3654,12 @@ namespace sl {
                 }
                 if (recvSize > remainSize) recvSize = remainSize;
 
-                recvSize = _channel->read(recvBuffer, recvSize);
+                recvSize = _channel->readWithTimestamp(recvBuffer, recvSize, &chunkTs);
+                SL_TRACE_INSTANT(TRACE_BYTES_ARRIVED, recvSize);
 
                 for (size_t pos = 0; pos < recvSize; ++pos) {
                     sl_u8 currentByte = recvBuffer[pos];
-                    switch (recvPos) {
+                    switch (_frame_pos) {
                     case 0: // expect the sync bit 1
                     {
                         sl_u8 tmp = (currentByte >> 4);
@@ -2100,15 +3679,19 @@ namespace sl {
                             // pass
                         }
                         else {
-                            recvPos = 0;
+                            _frame_pos = 0;
+                            internal::statAdd(_stats.resyncs);
                             _is_previous_capsuledataRdy = false;
                             continue;
                         }
                     }
                     break;
                     }
-                    nodeBuffer[recvPos++] = currentByte;
-                    if (recvPos == sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t)) {
+                    if (!_frame_pos) _frame_ts = chunkTs;
+                    nodeBuffer[_frame_pos++] = currentByte;
+                    if (_frame_pos == sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t)) {
+                        _frame_pos = 0;
+                        memcpy(&node, nodeBuffer, sizeof(sl_lidar_response_ultra_capsule_measurement_nodes_t));
                         // calc the checksum ...
                         sl_u8 checksum = 0;
                         sl_u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
@@ -2121,6 +3704,7 @@ namespace sl {
 
                         if (recvChecksum == checksum) {
                             // only consider vaild if the checksum matches...
+                            _frame_arrival_us = _frame_ts;
                             if (node.start_angle_sync_q6 & SL_LIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
                                 // this is the first capsule frame in logic, discard the previous cached data...
                                 _is_previous_capsuledataRdy = false;
@@ -2132,8 +3716,7 @@ namespace sl {
                         return SL_RESULT_INVALID_DATA;
                     }
                 }
-            }
-            _is_previous_capsuledataRdy = false;
+            } while ((waitTime = getms() - startTs) <= timeout);
             return SL_RESULT_OPERATION_TIMEOUT;
         }
 
@@ -2142,57 +3725,353 @@ namespace sl {
             sl_lidar_response_ultra_capsule_measurement_nodes_t    ultra_capsule_node;
             sl_lidar_response_measurement_node_hq_t   local_buf[256];
             size_t                                   count = 256;
-            sl_lidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-            size_t                                   scan_count = 0;
             Result<nullptr_t>                        ans = SL_RESULT_OK;
-            memset(local_scan, 0, sizeof(local_scan));
+            _resetScanAccumulator();
+            _resetStallWatchdog(96);
 
             _waitUltraCapsuledNode(ultra_capsule_node);
 
             while (_isScanning) {
-                ans = _waitUltraCapsuledNode(ultra_capsule_node);
+                _serviceRequests();
+                ans = _waitUltraCapsuledNode(ultra_capsule_node, _captureWaitTimeout());
+                SL_TRACE_INSTANT(TRACE_CAPSULE_FRAMED, (sl_result)ans);
+                if (!_watchCaptureWait(ans)) return _captureFailed();
                 if (!ans) {
                     if ((sl_result)ans != SL_RESULT_OPERATION_TIMEOUT && (sl_result)ans != SL_RESULT_INVALID_DATA) {
-                        _isScanning = false;
-                        return SL_RESULT_OPERATION_FAIL;
+                        return _captureFailed();
                     }
                     else {
                         // current data is invalid, do not use it.
+                        _countCaptureError(ans);
                         continue;
                     }
                 }
+                sl_u64 decodeStartTs = getus();
+                SL_TRACE_BEGIN(TRACE_DECODE);
 
                 _ultraCapsuleToNormal(ultra_capsule_node, local_buf, count);
 
+                _publishScanNodes(local_buf, count);
+                _stats.observeDecodeTime(getus() - decodeStartTs);
+                SL_TRACE_END(TRACE_DECODE);
+            }
+
+            _isScanning = false;
+
+            return SL_RESULT_OK;
+        }
+        void _resetScanAccumulator()
+        {
+            memset(_scan_accum_buf, 0, sizeof(_scan_accum_buf));
+            _scan_accum_count = 0;
+            _scan_accum_total = 0;
+            _scan_accum_valid = 0;
+            _scan_accum_quality = 0;
+            _scan_accum_first_ts = 0;
+            _scan_accum_last_ts = 0;
+            _frame_arrival_us = 0;
+            _frame_pos = 0;
+            _is_previous_capsuledataRdy = false;
+            _scan_checksum_errors = 0;
+            _scan_dropped_nodes = 0;
+            _sector_accum_count = 0;
+            _sector_accum_index = -1;
+
+            _predictive_decode = _predictive_decode_conf;
+            _predicted_diffAngle_q8 = 0;
+            _predicted_end_q8 = -1;
+
+            rp::hal::AutoLocker l(_safety_lock);
+            // keep the intrusion state across restarts, only the debounce counts start over
+            _safety_hit_rotation_mask = 0;
+            memset(_safety_hit_run, 0, sizeof(_safety_hit_run));
+            memset(_safety_clear_rotations, 0, sizeof(_safety_clear_rotations));
+        }
+
+        // Called by the capture thread after every decoded capsule.
+        // Publishes the complete 360 degree scans and the complete angular sectors.
+        void _publishScanNodes(const sl_lidar_response_measurement_node_hq_t* nodes, size_t count)
+        {
+            // the nodes are stamped when their capsule arrived, decode and queueing delays excluded
+            sl_u64 timestamp = _frame_arrival_us ? _frame_arrival_us : getus();
+            _last_capsule_us.store(timestamp, std::memory_order_relaxed);
+
+            // the safety zones are the most latency critical consumer, evaluate them first
+            _evaluateSafetyZones(nodes, count);
+
+            _lockFromCapture();
+            //for interval retrieve
+            for (size_t pos = 0; pos < count; ++pos) {
+                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = nodes[pos];
+                if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
+            }
+
+            if (_sector_span != _sector_conf_span) {
+                // sector size changed, the sector in progress is no longer valid
+                _sector_span = _sector_conf_span;
+                _sector_accum_count = 0;
+                _sector_accum_index = -1;
+            }
+            _lock.unlock();
+
+            for (size_t pos = 0; pos < count; ++pos) {
+                if (nodes[pos].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
+                    // only publish the data when it contains a full 360 degree scan
+                    if ((_scan_accum_buf[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
+                        _lockFromCapture();
+                        internal::statAdd(_stats.scans_published);
+                        if (_cached_scan_node_hq_count) internal::statAdd(_stats.scans_dropped); // the previous scan was never grabbed
+                        memcpy(_cached_scan_node_hq_buf, _scan_accum_buf, _scan_accum_count * sizeof(sl_lidar_response_measurement_node_hq_t));
+                        _cached_scan_node_hq_count = _scan_accum_count;
+                        _fillScanHeader(_cached_scan_header, timestamp);
+                        SL_TRACE_INSTANT(TRACE_SCAN_PUBLISH, _cached_scan_node_hq_count);
+                        _dataEvt.set();
+                        _readyEvt.set();
+                        _lock.unlock();
+                    }
+                    _scan_accum_count = 0;
+                    _scan_accum_total = 0;
+                    _scan_accum_valid = 0;
+                    _scan_accum_quality = 0;
+                    _scan_accum_first_ts = timestamp;
+                }
+                _scan_accum_buf[_scan_accum_count++] = nodes[pos];
+                if (_scan_accum_count == _countof(_scan_accum_buf)) {
+                    _scan_accum_count -= 1; // prevent overflow
+                    ++_scan_dropped_nodes;
+                }
+
+                ++_scan_accum_total;
+                if (nodes[pos].dist_mm_q2) {
+                    ++_scan_accum_valid;
+                    _scan_accum_quality += nodes[pos].quality;
+                }
+                _scan_accum_last_ts = timestamp;
+
+                if (_sector_span > 0) {
+                    _accumulateSectorNode(nodes[pos]);
+                }
+            }
+        }
+
+        // Readable while a scan or a sector waits to be grabbed, _lock must be held
+        void _updateReadyEvt()
+        {
+            _readyEvt.set(_cached_scan_node_hq_count || _cached_sector_node_hq_count);
+        }
+
+        // Take _lock from the capture thread, accounting the time spent waiting for it
+        void _lockFromCapture()
+        {
+            if (_lock.lock(0) == rp::hal::Locker::LOCK_OK) return;
+
+            sl_u64 waitStartTs = getus();
+            _lock.lock();
+            internal::statAdd(_stats.lock_contentions);
+            internal::statAdd(_stats.lock_wait_us, getus() - waitStartTs);
+        }
+
+        // Called by the capture thread before the first capsule of a scan, the watchdog is armed by that capsule
+        void _resetStallWatchdog(size_t samplesPerWait)
+        {
+            rp::hal::AutoLocker l(_watchdog_lock);
+            float intervalUs = _scan_us_per_sample * samplesPerWait;
+            _watchdog.armed = false;
+            _watchdog.stalled = false;
+            _watchdog.expected_interval_us = (sl_u32)intervalUs;
+            if (_stall_interval_multiple > 0) {
+                sl_u32 timeoutMs = (sl_u32)ceilf(intervalUs * _stall_interval_multiple / 1000.0f);
+                _watchdog.stall_timeout_ms = std::min<sl_u32>(std::max(timeoutMs, _stall_min_timeout), DEFAULT_TIMEOUT);
+            }
+            else {
+                _watchdog.stall_timeout_ms = DEFAULT_TIMEOUT;
+            }
+            _watchdog_last_capsule_us = 0;
+        }
+
+        // The motor may still be spinning up before the first capsule, the short timeout only applies afterwards
+        sl_u32 _captureWaitTimeout()
+        {
+            return _watchdog_last_capsule_us ? _watchdog.stall_timeout_ms : (sl_u32)DEFAULT_TIMEOUT;
+        }
+
+        // Called by the capture thread after every wait for a capsule, returns false once the link is considered lost
+        bool _watchCaptureWait(sl_result ans)
+        {
+            sl_u64 currentTs = getus();
+            if (IS_OK(ans)) {
+                if (_watchdog_last_capsule_us) {
+                    sl_u32 gapMs = (sl_u32)((currentTs - _watchdog_last_capsule_us) / 1000);
+                    bool resumed = false;
+                    if (_watchdog.stalled || gapMs > _watchdog.longest_gap_ms) {
+                        rp::hal::AutoLocker l(_watchdog_lock);
+                        resumed = _watchdog.stalled;
+                        _watchdog.stalled = false;
+                        if (gapMs > _watchdog.longest_gap_ms) _watchdog.longest_gap_ms = gapMs;
+                    }
+                    if (resumed) {
+                        if (ILidarEventListener* listener = _currentListener()) listener->onStreamResumed(gapMs);
+                    }
+                }
+                else {
+                    rp::hal::AutoLocker l(_watchdog_lock);
+                    _watchdog.armed = true;
+                }
+                _watchdog_last_capsule_us = currentTs;
+                return true;
+            }
+
+            // a wait cancelled by stop() is not a stall
+            if (ans != SL_RESULT_OPERATION_TIMEOUT || !_isScanning) return true;
+
+            // before the first capsule the motor may still be spinning up, a full DEFAULT_TIMEOUT is allowed
+            if (!_watchdog_last_capsule_us) return !_auto_reconnect;
+
+            sl_u32 gapMs = (sl_u32)((currentTs - _watchdog_last_capsule_us) / 1000);
+            if (!_watchdog.stalled) {
+                {
+                    rp::hal::AutoLocker l(_watchdog_lock);
+                    _watchdog.stalled = true;
+                    ++_watchdog.stall_count;
+                }
+                if (ILidarEventListener* listener = _currentListener()) listener->onStreamStalled(gapMs);
+            }
+            return !(_auto_reconnect && gapMs >= _link_loss_timeout);
+        }
+
+        void _countCaptureError(sl_result ans)
+        {
+            if (ans == SL_RESULT_INVALID_DATA) {
+                ++_scan_checksum_errors;
+                internal::statAdd(_stats.checksum_errors);
+            }
+            else if (ans == SL_RESULT_OPERATION_TIMEOUT) {
+                // a late capsule still follows the cached one, the framers resume it where it stopped: only a resync,
+                // a checksum failure or a link recovery breaks the stream
+                internal::statAdd(_stats.timeouts);
+            }
+        }
+
+        // Build the header of the accumulated scan, the next scan starts at the given timestamp
+        void _fillScanHeader(LidarScanHeader& header, sl_u64 nextScanTs)
+        {
+            header.sequence = _scan_sequence++;
+            header.first_timestamp_us = _scan_accum_first_ts;
+            header.last_timestamp_us = _scan_accum_last_ts;
+            header.measured_frequency = (nextScanTs > _scan_accum_first_ts) ? 1000000.f / (nextScanTs - _scan_accum_first_ts) : 0;
+            header.valid_ratio = _scan_accum_total ? (float)_scan_accum_valid / _scan_accum_total : 0;
+            header.mean_quality = _scan_accum_valid ? (float)_scan_accum_quality / _scan_accum_valid : 0;
+            header.checksum_errors = _scan_checksum_errors;
+            header.dropped_nodes = _scan_dropped_nodes;
+            header.link_downtime_ms = _scan_link_downtime_ms;
+
+            _scan_checksum_errors = 0;
+            _scan_dropped_nodes = 0;
+            _scan_link_downtime_ms = 0;
+        }
+
+        void _evaluateSafetyZones(const sl_lidar_response_measurement_node_hq_t* nodes, size_t count)
+        {
+            sl_u32 intrudedMask, changedMask;
+            {
+                rp::hal::AutoLocker l(_safety_lock);
+                if (!_safety_zone_mask) return;
+
+                sl_u32 prevMask = _safety_intruded_mask;
                 for (size_t pos = 0; pos < count; ++pos) {
-                    if (local_buf[pos].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
-                        // only publish the data when it contains a full 360 degree scan 
-
-                        if ((local_scan[0].flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                            _lock.lock();
-                            memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(sl_lidar_response_measurement_node_hq_t));
-                            _cached_scan_node_hq_count = scan_count;
-                            _dataEvt.set();
-                            _lock.unlock();
+                    const sl_lidar_response_measurement_node_hq_t& node = nodes[pos];
+                    if (node.flag & SL_LIDAR_RESP_MEASUREMENT_SYNCBIT) {
+                        _releaseSafetyZones();
+                    }
+                    if (!node.dist_mm_q2) continue;
+
+                    size_t bin = (node.angle_z_q14 >> SAFETY_ZONE_BIN_SHIFT);
+                    sl_u32 binMask = _safety_zone_bin_mask[bin];
+                    for (int zoneId = 0; binMask; ++zoneId, binMask >>= 1) {
+                        if (!(binMask & 0x1)) continue;
+
+                        const SafetyZoneRange& range = _safety_zone_ranges[zoneId][bin];
+                        if (node.dist_mm_q2 >= range.near_q2 && node.dist_mm_q2 < range.far_q2) {
+                            _safety_hit_rotation_mask |= (1 << zoneId);
+                            if (_safety_hit_run[zoneId] < 0xFFFF) ++_safety_hit_run[zoneId];
+                            if (_safety_hit_run[zoneId] >= _safety_zones[zoneId].trigger_count) {
+                                _safety_intruded_mask |= (1 << zoneId);
+                            }
+                        }
+                        else {
+                            _safety_hit_run[zoneId] = 0;
                         }
-                        scan_count = 0;
                     }
-                    local_scan[scan_count++] = local_buf[pos];
-                    if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
+                }
 
-                    //for interval retrieve
-                    {
-                        rp::hal::AutoLocker l(_lock);
-                        _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                        if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-                    }
+                intrudedMask = _safety_intruded_mask;
+                changedMask = prevMask ^ intrudedMask;
+                if (!changedMask) return;
+                _safetyEvt.set();
+            }
+
+            if (ILidarEventListener* listener = _currentListener()) {
+                listener->onSafetyZoneStateChanged(intrudedMask, changedMask);
+            }
+        }
+
+        // Called at the end of each rotation, release the zones which stayed clear long enough
+        void _releaseSafetyZones()
+        {
+            for (int zoneId = 0; zoneId < MAX_SAFETY_ZONES; ++zoneId) {
+                sl_u32 zoneBit = (1 << zoneId);
+                if (!(_safety_intruded_mask & zoneBit)) continue;
+
+                if (_safety_hit_rotation_mask & zoneBit) {
+                    _safety_clear_rotations[zoneId] = 0;
+                }
+                else if (++_safety_clear_rotations[zoneId] >= std::max<sl_u16>(1, _safety_zones[zoneId].release_count)) {
+                    _safety_intruded_mask &= ~zoneBit;
+                    _safety_clear_rotations[zoneId] = 0;
                 }
             }
+            _safety_hit_rotation_mask = 0;
+        }
 
-            _isScanning = false;
+        void _accumulateSectorNode(const sl_lidar_response_measurement_node_hq_t& node)
+        {
+            int sectorCount = (int)ceilf(360.f / _sector_span);
+            int index = (int)(getAngle(node) / _sector_span);
+            if (index >= sectorCount) index = sectorCount - 1;
+
+            if (_sector_accum_index < 0) {
+                // the first sector after (re)start begins in the middle, never publish it
+                _sector_accum_index = index;
+                _sector_accum_complete = false;
+            }
+            else if (index != _sector_accum_index) {
+                // the angles of the capsuled formats may jitter slightly backwards around
+                // the boundary, only move forward to the next sectors
+                int ahead = (index - _sector_accum_index + sectorCount) % sectorCount;
+                if (ahead <= sectorCount / 2) {
+                    if (_sector_accum_complete && _sector_accum_count) {
+                        _lockFromCapture();
+                        memcpy(_cached_sector_node_hq_buf, _sector_accum_buf, _sector_accum_count * sizeof(sl_lidar_response_measurement_node_hq_t));
+                        _cached_sector_node_hq_count = _sector_accum_count;
+                        _cached_sector.sequence = _sector_sequence++;
+                        _cached_sector.index = (sl_u16)_sector_accum_index;
+                        _cached_sector.start_angle = _sector_accum_index * _sector_span;
+                        _cached_sector.end_angle = std::min(360.f, (_sector_accum_index + 1) * _sector_span);
+                        SL_TRACE_INSTANT(TRACE_SECTOR_PUBLISH, _cached_sector.index);
+                        _sectorEvt.set();
+                        _readyEvt.set();
+                        _lock.unlock();
+                    }
+                    _sector_accum_count = 0;
+                    _sector_accum_index = index;
+                    _sector_accum_complete = (ahead == 1);
+                }
+            }
 
-            return SL_RESULT_OK;
+            _sector_accum_buf[_sector_accum_count++] = node;
+            if (_sector_accum_count == _countof(_sector_accum_buf)) _sector_accum_count -= 1; // prevent overflow
         }
+
         sl_result _clearRxDataCache()
         {
             if (!isConnected())
@@ -2226,18 +4105,194 @@ namespace sl {
         sl_lidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf_for_interval_retrieve[8192];
         size_t                                   _cached_scan_node_hq_count_for_interval_retrieve;
 
+        // the scan being assembled by the capture thread
+        sl_lidar_response_measurement_node_hq_t   _scan_accum_buf[MAX_SCAN_NODES];
+        size_t                                   _scan_accum_count;
+
+        // statistics of the scan in progress, reported in the scan header
+        size_t                                   _scan_accum_total;
+        size_t                                   _scan_accum_valid;
+        sl_u64                                   _scan_accum_quality;
+        sl_u64                                   _scan_accum_first_ts;
+        sl_u64                                   _scan_accum_last_ts;
+        // arrival time of the first byte of the last capsule framed, 0 when the channel does not record it
+        sl_u64                                   _frame_arrival_us;
+        // frame being received, kept across the waits of the framers so a frame cut by their timeout resumes where it stopped
+        CaptureFrame                             _frame_buf;
+        int                                      _frame_pos;
+        sl_u64                                   _frame_ts;
+        sl_u32                                   _scan_checksum_errors;
+        sl_u32                                   _scan_dropped_nodes;
+        sl_u32                                   _scan_sequence;
+        LidarScanHeader                          _cached_scan_header;
+
+        // sector publish mode
+        rp::hal::Event                           _sectorEvt;
+        rp::hal::PollableEvent                   _readyEvt;     // see getScanReadyHandle, guarded by _lock
+        float                                    _sector_conf_span;
+        float                                    _sector_span;
+        sl_u32                                   _sector_sequence;
+        sl_lidar_response_measurement_node_hq_t   _sector_accum_buf[MAX_SCAN_NODES];
+        size_t                                   _sector_accum_count;
+        int                                      _sector_accum_index;
+        bool                                     _sector_accum_complete;
+        sl_lidar_response_measurement_node_hq_t   _cached_sector_node_hq_buf[MAX_SCAN_NODES];
+        size_t                                   _cached_sector_node_hq_count;
+        LidarScanSector                          _cached_sector;
+
+        internal::DriverStatCounters             _stats;
+
+        // Device capabilities, queried once per connection
+        rp::hal::Locker                          _profile_lock;
+        internal::DeviceProfile                  _profile;
+        bool                                     _profile_dirty;        // learned something not stored yet
+        std::string                              _profile_cache_dir;
+        rp::hal::Locker                          _profile_store_lock;   // held while writing the cache file, taken before _profile_lock
+
+        rp::hal::Locker                          _listener_lock;
+        ILidarEventListener*                     _listener;
+
+        rp::hal::Locker                          _safety_lock;
+        rp::hal::Event                           _safetyEvt;
+        LidarSafetyZone                          _safety_zones[MAX_SAFETY_ZONES];
+        SafetyZoneRange                          _safety_zone_ranges[MAX_SAFETY_ZONES][SAFETY_ZONE_BINS];
+        sl_u8                                    _safety_zone_bin_mask[SAFETY_ZONE_BINS];
+        sl_u32                                   _safety_zone_mask;
+        sl_u32                                   _safety_intruded_mask;
+        sl_u32                                   _safety_hit_rotation_mask;
+        sl_u16                                   _safety_hit_run[MAX_SAFETY_ZONES];
+        sl_u16                                   _safety_clear_rotations[MAX_SAFETY_ZONES];
+
         sl_lidar_response_capsule_measurement_nodes_t       _cached_previous_capsuledata;
         sl_lidar_response_dense_capsule_measurement_nodes_t _cached_previous_dense_capsuledata;
         sl_lidar_response_ultra_dense_capsule_measurement_nodes_t _cached_previous_ultra_dense_capsuledata;
 
         sl_lidar_response_ultra_capsule_measurement_nodes_t _cached_previous_ultracapsuledata;
-        sl_lidar_response_hq_capsule_measurement_nodes_t _cached_previous_Hqdata;
         bool                                         _is_previous_capsuledataRdy;
-        bool                                         _is_previous_HqdataRdy;
+
+        bool                                         _predictive_decode_conf;
+        bool                                         _predictive_decode;
+        int                                          _predicted_diffAngle_q8;
+        int                                          _predicted_end_q8;     // where the last capsule decoded ahead ended, -1 if none
+
+        sl_u64                                       _cmd_guard_until_us;
+        bool                                         _conf_pipeline_disabled;
+
+        // Health and status gathered without interrupting the scan
+        rp::hal::Locker                              _health_lock;
+        bool                                         _health_query_valid;
+        sl_lidar_response_device_health_t            _health_query;
+        sl_u64                                       _health_query_us;
+        bool                                         _dev_status_valid;
+        sl_u16                                       _dev_status;
+        sl_u64                                       _dev_status_us;
+        internal::StatCounter                        _last_capsule_us;
+        bool                                         _scan_interruption_allowed;
+
+        // Requests without answer waiting for the capture thread
+        rp::hal::Locker                              _request_lock;
+        PendingRequest*                              _request_head;
+        PendingRequest*                              _request_tail;
+
+        // Capture worker, the capture loop of every scan runs on the same thread
+        rp::hal::Locker                              _capture_lock;
+        rp::hal::Event                               _captureJobEvt;
+        rp::hal::Event                               _captureIdleEvt;   // manual reset, signaled while no capture loop runs
+        CaptureJob                                   _capture_job;
+        bool                                         _capture_busy;
+        bool                                         _capture_quit;
+
+        // Capture serviced by a reactor instead of the capture worker, _reactor_* are only used by the steps of the reactor
+        internal::LidarReactor*                      _capture_reactor;
+        internal::LidarReactor*                      _attached_reactor;
+        CaptureJob                                   _scan_job;         // capture loop matching the answer type of the scan
+        CaptureFrame                                 _reactor_frame;
+        bool                                         _reactor_discard;
+        sl_u64                                       _reactor_wait_start_us;
+        sl_lidar_response_measurement_node_hq_t      _reactor_nodes[256];
+        size_t                                       _reactor_node_count;
+
+        // Stall watchdog of the measurement stream, _watchdog_last_capsule_us is only used by the capture thread
+        float                                        _scan_us_per_sample;
+        rp::hal::Locker                              _watchdog_lock;
+        float                                        _stall_interval_multiple;
+        sl_u32                                       _stall_min_timeout;
+        LidarWatchdogState                           _watchdog;
+        sl_u64                                       _watchdog_last_capsule_us;
+
+        // Link supervision, replays the last scan and motor requests on a reopened channel
+        sl_u16                                       _scan_cmd;
+        sl_lidar_payload_express_scan_t              _scan_req;
+        sl_u8                                        _scan_ans_type;
+        sl_u32                                       _scan_link_downtime_ms;
+        sl_u16                                       _motor_cmd;
+        sl_lidar_payload_motor_pwm_t                 _motor_payload;
+        bool                                         _auto_reconnect;
+        sl_u32                                       _link_loss_timeout;
+        sl_u32                                       _link_max_backoff;
+        rp::hal::Event                               _recoveryEvt;
     };
 
     Result<ILidarDriver*> createLidarDriver()
     {
         return new SlamtecLidarDriver();
     }
+
+    // One port of probeSerialLidars, the baudrates are tried in turn by the thread of the port
+    struct SerialProbeJob
+    {
+        const std::string* device;
+        const std::vector<sl_u32>* baudrates;
+        sl_u32 timeout;
+        bool found;
+        LidarProbeResult result;
+    };
+
+    static _word_size_t THREAD_PROC probeSerialPort(void* data)
+    {
+        SerialProbeJob* job = static_cast<SerialProbeJob*>(data);
+        // the scan and publish buffers of a driver are far too large for the stack of a probing thread
+        SlamtecLidarDriver* prober = new SlamtecLidarDriver();
+
+        for (size_t pos = 0; pos < job->baudrates->size() && !job->found; ++pos) {
+            sl_u32 baudrate = (*job->baudrates)[pos];
+            IChannel* channel = *createSerialPortChannel(*job->device, (int)baudrate);
+            if (!channel) break;
+            if (SL_IS_OK(prober->probeDeviceInfo(channel, job->result.devinfo, job->timeout))) {
+                job->result.device = *job->device;
+                job->result.baudrate = baudrate;
+                job->found = true;
+            }
+            delete channel;
+        }
+        delete prober;
+        return 0;
+    }
+
+    sl_result probeSerialLidars(const std::vector<std::string>& devices, const std::vector<sl_u32>& baudrates, std::vector<LidarProbeResult>& found, sl_u32 timeoutInMs)
+    {
+        if (devices.empty() || baudrates.empty()) return SL_RESULT_INVALID_DATA;
+
+        std::vector<SerialProbeJob> jobs(devices.size());
+        std::vector<rp::hal::Thread> threads(devices.size());
+        for (size_t pos = 0; pos < devices.size(); ++pos) {
+            jobs[pos].device = &devices[pos];
+            jobs[pos].baudrates = &baudrates;
+            jobs[pos].timeout = timeoutInMs;
+            jobs[pos].found = false;
+            threads[pos] = rp::hal::Thread::create(probeSerialPort, &jobs[pos]);
+            // no thread available, probe this port from the calling thread
+            if (!threads[pos].getHandle()) probeSerialPort(&jobs[pos]);
+        }
+
+        sl_result ans = SL_RESULT_OPERATION_TIMEOUT;
+        for (size_t pos = 0; pos < devices.size(); ++pos) {
+            threads[pos].join();
+            if (jobs[pos].found) {
+                found.push_back(jobs[pos].result);
+                ans = SL_RESULT_OK;
+            }
+        }
+        return ans;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,290 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include "sl_lidar_profile_cache.h"
+#include "sl_crc.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace sl { namespace internal {
+
+    // 'SLDP'
+    static const sl_u32 DEVICE_PROFILE_MAGIC = 0x50444C53;
+    // Bump when the layout below changes, older files are then ignored
+    static const sl_u32 DEVICE_PROFILE_FORMAT_VERSION = 2;
+
+    enum DeviceProfileFlag
+    {
+        PROFILE_FLAG_CONF_SUPPORT  = 0x01,
+        PROFILE_FLAG_SCAN_MODES    = 0x02,
+        PROFILE_FLAG_TYPICAL_MODE  = 0x04,
+        PROFILE_FLAG_MOTOR_CTRL    = 0x08,
+        PROFILE_FLAG_DESIRED_SPEED = 0x10,
+        PROFILE_FLAG_MOTOR_INFO    = 0x20,
+        PROFILE_FLAG_IP_CONF       = 0x40,
+        PROFILE_FLAG_LINK_BAUDRATE = 0x80,
+    };
+
+    struct DeviceProfileFileHeader
+    {
+        sl_u32 magic;
+        sl_u32 format_version;
+        sl_u32 payload_size;
+        sl_u32 payload_crc;
+    };
+
+    static void putBytes(std::vector<sl_u8>& out, const void* data, size_t size)
+    {
+        const sl_u8* p = reinterpret_cast<const sl_u8*>(data);
+        out.insert(out.end(), p, p + size);
+    }
+
+    template <typename T>
+    static void put(std::vector<sl_u8>& out, const T& value)
+    {
+        putBytes(out, &value, sizeof(T));
+    }
+
+    class PayloadReader
+    {
+    public:
+        PayloadReader(const std::vector<sl_u8>& data) : _data(data), _pos(0) {}
+
+        bool getBytes(void* dest, size_t size)
+        {
+            if (_data.size() - _pos < size) return false;
+            memcpy(dest, &_data[_pos], size);
+            _pos += size;
+            return true;
+        }
+
+        template <typename T>
+        bool get(T& value)
+        {
+            return getBytes(&value, sizeof(T));
+        }
+
+    private:
+        const std::vector<sl_u8>& _data;
+        size_t _pos;
+    };
+
+    DeviceProfile::DeviceProfile()
+    {
+        reset();
+    }
+
+    void DeviceProfile::reset()
+    {
+        devinfo_valid = false;
+        conf_support_valid = false;
+        conf_support = false;
+        scan_modes_valid = false;
+        scan_modes.clear();
+        typical_mode_valid = false;
+        typical_mode = 0;
+        motor_ctrl_valid = false;
+        motor_ctrl = MotorCtrlSupportNone;
+        desired_speed_valid = false;
+        motor_info_valid = false;
+        ip_conf_valid = false;
+        link_baudrate_valid = false;
+        link_baudrate = 0;
+        memset(&devinfo, 0, sizeof(devinfo));
+        memset(&desired_speed, 0, sizeof(desired_speed));
+        memset(&motor_info, 0, sizeof(motor_info));
+        memset(&ip_conf, 0, sizeof(ip_conf));
+    }
+
+    std::string getDeviceProfilePath(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo)
+    {
+        char name[2 * sizeof(devinfo.serialnum) + 1];
+        for (size_t pos = 0; pos < sizeof(devinfo.serialnum); ++pos) {
+            sprintf(name + 2 * pos, "%02X", devinfo.serialnum[pos]);
+        }
+
+        std::string path = cacheDir;
+        if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') {
+            path += '/';
+        }
+        path += name;
+        path += ".slprofile";
+        return path;
+    }
+
+    bool loadDeviceProfile(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo, DeviceProfile& profile)
+    {
+        FILE* fp = fopen(getDeviceProfilePath(cacheDir, devinfo).c_str(), "rb");
+        if (!fp) return false;
+
+        DeviceProfileFileHeader header;
+        std::vector<sl_u8> payload;
+        bool ok = (fread(&header, sizeof(header), 1, fp) == 1)
+            && header.magic == DEVICE_PROFILE_MAGIC
+            && header.format_version == DEVICE_PROFILE_FORMAT_VERSION
+            && header.payload_size < 0x10000;
+        if (ok) {
+            payload.resize(header.payload_size);
+            ok = payload.empty() || fread(&payload[0], payload.size(), 1, fp) == 1;
+        }
+        fclose(fp);
+        if (!ok || payload.empty()) return false;
+        if (crc32::getResult(&payload[0], (sl_u32)payload.size()) != header.payload_crc) return false;
+
+        PayloadReader reader(payload);
+        DeviceProfile loaded;
+        sl_u8 flags;
+        sl_u32 motorCtrl, motorInfoCtrl;
+        sl_u16 modeCount;
+        if (!reader.get(loaded.devinfo)) return false;
+        // the serial number selects the file, the remaining fields catch firmware updates
+        if (memcmp(&loaded.devinfo, &devinfo, sizeof(devinfo)) != 0) return false;
+
+        if (!reader.get(flags)
+            || !reader.get(loaded.typical_mode)
+            || !reader.get(motorCtrl)
+            || !reader.get(loaded.desired_speed)
+            || !reader.get(motorInfoCtrl)
+            || !reader.get(loaded.motor_info.desired_speed)
+            || !reader.get(loaded.motor_info.max_speed)
+            || !reader.get(loaded.motor_info.min_speed)
+            || !reader.get(loaded.ip_conf)
+            || !reader.get(loaded.link_baudrate)
+            || !reader.get(modeCount)) {
+            return false;
+        }
+
+        for (sl_u16 pos = 0; pos < modeCount; ++pos) {
+            LidarScanMode mode;
+            memset(&mode, 0, sizeof(mode));
+            if (!reader.get(mode.id)
+                || !reader.get(mode.us_per_sample)
+                || !reader.get(mode.max_distance)
+                || !reader.get(mode.ans_type)
+                || !reader.getBytes(mode.scan_mode, sizeof(mode.scan_mode))) {
+                return false;
+            }
+            mode.scan_mode[sizeof(mode.scan_mode) - 1] = 0;
+            loaded.scan_modes.push_back(mode);
+        }
+
+        loaded.devinfo_valid = true;
+        loaded.conf_support_valid = true;
+        loaded.conf_support = (flags & PROFILE_FLAG_CONF_SUPPORT) != 0;
+        loaded.scan_modes_valid = (flags & PROFILE_FLAG_SCAN_MODES) != 0;
+        loaded.typical_mode_valid = (flags & PROFILE_FLAG_TYPICAL_MODE) != 0;
+        loaded.motor_ctrl_valid = (flags & PROFILE_FLAG_MOTOR_CTRL) != 0;
+        loaded.motor_ctrl = (MotorCtrlSupport)motorCtrl;
+        loaded.desired_speed_valid = (flags & PROFILE_FLAG_DESIRED_SPEED) != 0;
+        loaded.motor_info_valid = (flags & PROFILE_FLAG_MOTOR_INFO) != 0;
+        loaded.motor_info.motorCtrlSupport = (MotorCtrlSupport)motorInfoCtrl;
+        loaded.ip_conf_valid = (flags & PROFILE_FLAG_IP_CONF) != 0;
+        loaded.link_baudrate_valid = (flags & PROFILE_FLAG_LINK_BAUDRATE) != 0;
+
+        profile = loaded;
+        return true;
+    }
+
+    bool encodeDeviceProfile(const DeviceProfile& profile, std::vector<sl_u8>& content)
+    {
+        // a profile without the config protocol answer is not worth a file
+        if (!profile.devinfo_valid || !profile.conf_support_valid) return false;
+
+        sl_u8 flags = 0;
+        if (profile.conf_support) flags |= PROFILE_FLAG_CONF_SUPPORT;
+        if (profile.scan_modes_valid) flags |= PROFILE_FLAG_SCAN_MODES;
+        if (profile.typical_mode_valid) flags |= PROFILE_FLAG_TYPICAL_MODE;
+        if (profile.motor_ctrl_valid) flags |= PROFILE_FLAG_MOTOR_CTRL;
+        if (profile.desired_speed_valid) flags |= PROFILE_FLAG_DESIRED_SPEED;
+        if (profile.motor_info_valid) flags |= PROFILE_FLAG_MOTOR_INFO;
+        if (profile.ip_conf_valid) flags |= PROFILE_FLAG_IP_CONF;
+        if (profile.link_baudrate_valid) flags |= PROFILE_FLAG_LINK_BAUDRATE;
+
+        std::vector<sl_u8> payload;
+        put(payload, profile.devinfo);
+        put(payload, flags);
+        put(payload, profile.typical_mode);
+        put(payload, (sl_u32)profile.motor_ctrl);
+        put(payload, profile.desired_speed);
+        put(payload, (sl_u32)profile.motor_info.motorCtrlSupport);
+        put(payload, profile.motor_info.desired_speed);
+        put(payload, profile.motor_info.max_speed);
+        put(payload, profile.motor_info.min_speed);
+        put(payload, profile.ip_conf);
+        put(payload, profile.link_baudrate);
+        sl_u16 modeCount = profile.scan_modes_valid ? (sl_u16)profile.scan_modes.size() : 0;
+        put(payload, modeCount);
+        for (sl_u16 pos = 0; pos < modeCount; ++pos) {
+            const LidarScanMode& mode = profile.scan_modes[pos];
+            put(payload, mode.id);
+            put(payload, mode.us_per_sample);
+            put(payload, mode.max_distance);
+            put(payload, mode.ans_type);
+            putBytes(payload, mode.scan_mode, sizeof(mode.scan_mode));
+        }
+
+        DeviceProfileFileHeader header;
+        header.magic = DEVICE_PROFILE_MAGIC;
+        header.format_version = DEVICE_PROFILE_FORMAT_VERSION;
+        header.payload_size = (sl_u32)payload.size();
+        header.payload_crc = crc32::getResult(&payload[0], (sl_u32)payload.size());
+
+        content.clear();
+        put(content, header);
+        content.insert(content.end(), payload.begin(), payload.end());
+        return true;
+    }
+
+    bool writeDeviceProfile(const std::string& path, const std::vector<sl_u8>& content)
+    {
+        if (content.empty()) return false;
+
+        std::string tmpPath = path + ".tmp";
+        FILE* fp = fopen(tmpPath.c_str(), "wb");
+        if (!fp) return false;
+        bool ok = fwrite(&content[0], content.size(), 1, fp) == 1;
+        ok = (fclose(fp) == 0) && ok;
+        if (ok && rename(tmpPath.c_str(), path.c_str()) != 0) {
+            // rename does not replace an existing file on Windows
+            remove(path.c_str());
+            ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+        }
+        if (!ok) remove(tmpPath.c_str());
+        return ok;
+    }
+
+    void removeDeviceProfile(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo)
+    {
+        remove(getDeviceProfilePath(cacheDir, devinfo).c_str());
+    }
+
+}}
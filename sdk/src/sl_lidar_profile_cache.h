@@ -0,0 +1,84 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#pragma once
+
+#include "sl_lidar_driver.h"
+#include <string>
+#include <vector>
+
+namespace sl { namespace internal {
+
+    // Device capabilities which never change while the device keeps the same firmware and configuration
+    struct DeviceProfile
+    {
+        bool                                    devinfo_valid;
+        sl_lidar_response_device_info_t         devinfo;
+        bool                                    conf_support_valid;
+        bool                                    conf_support;
+        bool                                    scan_modes_valid;
+        std::vector<LidarScanMode>              scan_modes;
+        bool                                    typical_mode_valid;
+        sl_u16                                  typical_mode;
+        bool                                    motor_ctrl_valid;
+        MotorCtrlSupport                        motor_ctrl;
+        bool                                    desired_speed_valid;
+        sl_lidar_response_desired_rot_speed_t   desired_speed;
+        bool                                    motor_info_valid;
+        LidarMotorInfo                          motor_info;
+        bool                                    ip_conf_valid;
+        sl_lidar_ip_conf_t                      ip_conf;
+        // serial baudrate settled on by negotiateBestSerialBaudRate
+        bool                                    link_baudrate_valid;
+        sl_u32                                  link_baudrate;
+
+        DeviceProfile();
+        void reset();
+    };
+
+    // Path of the cache file of a device: one file per serial number in the cache directory
+    std::string getDeviceProfilePath(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo);
+
+    // Load the cached profile of the given device
+    // Fails if there is no cache file, if it is corrupted or if it was written for another firmware version
+    bool loadDeviceProfile(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo, DeviceProfile& profile);
+
+    // Build the content of the cache file of the profile
+    // Fails if the profile is not worth a file yet
+    bool encodeDeviceProfile(const DeviceProfile& profile, std::vector<sl_u8>& content);
+
+    // Write an encoded profile to its cache file, the file is replaced atomically so concurrent readers never see a partial file
+    bool writeDeviceProfile(const std::string& path, const std::vector<sl_u8>& content);
+
+    void removeDeviceProfile(const std::string& cacheDir, const sl_lidar_response_device_info_t& devinfo);
+
+}}
@@ -0,0 +1,378 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include "sdkcommon.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "sl_lidar_reactor.h"
+#include "sl_lidar_stats.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#endif
+
+namespace sl { namespace internal {
+
+#if defined(__linux__)
+
+    // One thread of the reactor and the captures it services
+    // The channels are registered edge triggered: a step frames everything the channel holds, the channel becomes
+    // readable again with the next data received. A step runs under _step_lock, so remove() can wait it out.
+    class ReactorLoop
+    {
+    public:
+        enum {
+            MAX_EVENTS = 64,
+            WAKE_KEY = 0,
+        };
+
+        ReactorLoop()
+            : _epoll_fd(-1)
+            , _wake_fd(-1)
+            , _quit(false)
+            , _next_key(WAKE_KEY + 1)
+            , _wakeups(0)
+            , _steps(0)
+            , _deadline_steps(0)
+        {
+        }
+
+        ~ReactorLoop()
+        {
+            stop();
+        }
+
+        bool start()
+        {
+            _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (_epoll_fd == -1 || _wake_fd == -1) return false;
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = WAKE_KEY;
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &ev) == -1) return false;
+
+            _due.reserve(MAX_EVENTS);
+            _thread = CLASS_THREAD(ReactorLoop, _run);
+            return _thread.getHandle() != 0;
+        }
+
+        void stop()
+        {
+            if (_thread.getHandle()) {
+                {
+                    rp::hal::AutoLocker l(_lock);
+                    _quit = true;
+                }
+                _wake();
+                _thread.join();
+                _thread = rp::hal::Thread();
+            }
+            if (_wake_fd != -1) ::close(_wake_fd);
+            if (_epoll_fd != -1) ::close(_epoll_fd);
+            _wake_fd = -1;
+            _epoll_fd = -1;
+        }
+
+        size_t getCaptureCount()
+        {
+            rp::hal::AutoLocker l(_lock);
+            return _entries.size();
+        }
+
+        sl_result add(IReactorClient* client, int pollHandle)
+        {
+            rp::hal::AutoLocker l(_lock);
+            Entry entry;
+            entry.client = client;
+            entry.handle = pollHandle;
+            entry.key = _next_key++;
+            entry.deadline_us = 0;  // due right away
+            entry.due = false;
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            ev.data.u64 = entry.key;
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, pollHandle, &ev) == -1) return SL_RESULT_OPERATION_FAIL;
+
+            _entries.push_back(entry);
+            _wake();
+            return SL_RESULT_OK;
+        }
+
+        // Returns false if the client is not serviced by this loop
+        bool remove(IReactorClient* client)
+        {
+            {
+                rp::hal::AutoLocker l(_lock);
+                size_t pos = 0;
+                while (pos < _entries.size() && _entries[pos].client != client) ++pos;
+                if (pos == _entries.size()) return false;
+                _erase(pos);
+            }
+
+            if (!pthread_equal(pthread_self(), (pthread_t)_thread.getHandle())) {
+                // the step in progress may belong to the client
+                _step_lock.lock();
+                _step_lock.unlock();
+            }
+            return true;
+        }
+
+        void addStats(LidarReactorStats& stats)
+        {
+            stats.capture_count += (sl_u32)getCaptureCount();
+            stats.wakeups += statGet(_wakeups);
+            stats.steps += statGet(_steps);
+            stats.deadline_steps += statGet(_deadline_steps);
+        }
+
+    private:
+        struct Entry
+        {
+            IReactorClient* client;
+            int             handle;
+            sl_u64          key;            // tag of the epoll registration, the events of a removed entry match no other
+            sl_u64          deadline_us;
+            bool            due;
+        };
+
+        u_result _run()
+        {
+            struct epoll_event events[MAX_EVENTS];
+            while (true) {
+                int timeout;
+                {
+                    rp::hal::AutoLocker l(_lock);
+                    if (_quit) break;
+                    timeout = _waitTimeout(getus());
+                }
+
+                int count = epoll_wait(_epoll_fd, events, MAX_EVENTS, timeout);
+                if (count < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                statAdd(_wakeups);
+
+                sl_u64 currentTs = getus();
+                {
+                    rp::hal::AutoLocker l(_lock);
+                    for (int pos = 0; pos < count; ++pos) {
+                        if (events[pos].data.u64 == WAKE_KEY) {
+                            eventfd_t value;
+                            eventfd_read(_wake_fd, &value);
+                            continue;
+                        }
+                        Entry* entry = _find(events[pos].data.u64);
+                        if (entry) entry->due = true;
+                    }
+
+                    _due.clear();
+                    for (size_t pos = 0; pos < _entries.size(); ++pos) {
+                        Entry& entry = _entries[pos];
+                        if (!entry.due && entry.deadline_us > currentTs) continue;
+                        if (!entry.due) statAdd(_deadline_steps);
+                        entry.due = false;
+                        _due.push_back(entry.key);
+                    }
+                }
+
+                for (size_t pos = 0; pos < _due.size(); ++pos) {
+                    _step(_due[pos]);
+                }
+            }
+            return RESULT_OK;
+        }
+
+        void _step(sl_u64 key)
+        {
+            rp::hal::AutoLocker stepLock(_step_lock);
+            IReactorClient* client;
+            {
+                rp::hal::AutoLocker l(_lock);
+                Entry* entry = _find(key);
+                if (!entry) return;
+                client = entry->client;
+            }
+
+            statAdd(_steps);
+            sl_u64 deadline = client->onReactorStep();
+
+            rp::hal::AutoLocker l(_lock);
+            // the step may have removed its own entry
+            Entry* entry = _find(key);
+            if (!entry) return;
+            if (deadline) {
+                entry->deadline_us = deadline;
+            }
+            else {
+                _erase(entry - &_entries[0]);
+            }
+        }
+
+        // Time to the nearest deadline, in milliseconds rounded up, -1 without any
+        int _waitTimeout(sl_u64 currentTs)
+        {
+            if (_entries.empty()) return -1;
+
+            sl_u64 nearest = _entries[0].deadline_us;
+            for (size_t pos = 1; pos < _entries.size(); ++pos) {
+                nearest = std::min(nearest, _entries[pos].deadline_us);
+            }
+            if (nearest <= currentTs) return 0;
+            return (int)std::min<sl_u64>((nearest - currentTs + 999) / 1000, INT_MAX);
+        }
+
+        Entry* _find(sl_u64 key)
+        {
+            for (size_t pos = 0; pos < _entries.size(); ++pos) {
+                if (_entries[pos].key == key) return &_entries[pos];
+            }
+            return NULL;
+        }
+
+        void _erase(size_t pos)
+        {
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _entries[pos].handle, NULL);
+            _entries.erase(_entries.begin() + pos);
+        }
+
+        void _wake()
+        {
+            eventfd_write(_wake_fd, 1);
+        }
+
+        int                     _epoll_fd;
+        int                     _wake_fd;
+        rp::hal::Thread         _thread;
+        rp::hal::Locker         _lock;
+        rp::hal::Locker         _step_lock;
+        std::vector<Entry>      _entries;
+        std::vector<sl_u64>     _due;       // only used by the loop thread
+        bool                    _quit;
+        sl_u64                  _next_key;
+
+        StatCounter             _wakeups;
+        StatCounter             _steps;
+        StatCounter             _deadline_steps;
+    };
+
+    class EpollReactor : public LidarReactor
+    {
+    public:
+        ~EpollReactor()
+        {
+            for (size_t pos = 0; pos < _loops.size(); ++pos) {
+                delete _loops[pos];
+            }
+        }
+
+        bool start(size_t threadCount)
+        {
+            for (size_t pos = 0; pos < threadCount; ++pos) {
+                ReactorLoop* loop = new ReactorLoop();
+                _loops.push_back(loop);
+                if (!loop->start()) return false;
+            }
+            return true;
+        }
+
+        sl_result add(IReactorClient* client, int pollHandle)
+        {
+            rp::hal::AutoLocker l(_lock);
+            ReactorLoop* target = _loops[0];
+            size_t targetCount = target->getCaptureCount();
+            for (size_t pos = 1; pos < _loops.size(); ++pos) {
+                size_t count = _loops[pos]->getCaptureCount();
+                if (count < targetCount) {
+                    target = _loops[pos];
+                    targetCount = count;
+                }
+            }
+            return target->add(client, pollHandle);
+        }
+
+        void remove(IReactorClient* client)
+        {
+            for (size_t pos = 0; pos < _loops.size(); ++pos) {
+                if (_loops[pos]->remove(client)) return;
+            }
+        }
+
+        sl_result getStats(LidarReactorStats& stats)
+        {
+            memset(&stats, 0, sizeof(stats));
+            stats.thread_count = (sl_u32)_loops.size();
+            for (size_t pos = 0; pos < _loops.size(); ++pos) {
+                _loops[pos]->addStats(stats);
+            }
+            return SL_RESULT_OK;
+        }
+
+    private:
+        rp::hal::Locker             _lock;  // serializes the choice of the least loaded loop
+        std::vector<ReactorLoop*>   _loops;
+    };
+
+#endif
+
+}}
+
+namespace sl {
+
+    Result<ILidarReactor*> createLidarReactor(size_t threadCount)
+    {
+#if defined(__linux__)
+        if (!threadCount) return SL_RESULT_INVALID_DATA;
+
+        internal::EpollReactor* reactor = new internal::EpollReactor();
+        if (!reactor->start(threadCount)) {
+            delete reactor;
+            return SL_RESULT_OPERATION_FAIL;
+        }
+        return reactor;
+#else
+        return SL_RESULT_OPERATION_NOT_SUPPORT;
+#endif
+    }
+
+}
@@ -0,0 +1,164 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include "sl_lidar_stats.h"
+#include <stdio.h>
+
+namespace sl { namespace internal {
+
+    ChannelStatCounters::ChannelStatCounters()
+        : bytes_read(0)
+        , bytes_written(0)
+        , read_calls(0)
+        , wait_calls(0)
+        , wait_timeouts(0)
+        , datagrams_received(0)
+        , datagrams_truncated(0)
+        , datagrams_dropped(0)
+        , buffered_reads(0)
+        , peer_disconnects(0)
+    {
+    }
+
+    void ChannelStatCounters::snapshot(ChannelStats& stats) const
+    {
+        stats.bytes_read = statGet(bytes_read);
+        stats.bytes_written = statGet(bytes_written);
+        stats.read_calls = statGet(read_calls);
+        stats.wait_calls = statGet(wait_calls);
+        stats.wait_timeouts = statGet(wait_timeouts);
+        stats.datagrams_received = statGet(datagrams_received);
+        stats.datagrams_truncated = statGet(datagrams_truncated);
+        stats.datagrams_dropped = statGet(datagrams_dropped);
+        stats.buffered_reads = statGet(buffered_reads);
+        stats.peer_disconnects = statGet(peer_disconnects);
+    }
+
+    DriverStatCounters::DriverStatCounters()
+        : capsules_decoded(0)
+        , checksum_errors(0)
+        , resyncs(0)
+        , timeouts(0)
+        , scans_published(0)
+        , scans_dropped(0)
+        , lock_contentions(0)
+        , lock_wait_us(0)
+        , decode_time_sum_us(0)
+    {
+        for (size_t pos = 0; pos < LidarDriverStats::DECODE_TIME_BUCKETS; ++pos) {
+            decode_time_bucket[pos] = 0;
+        }
+    }
+
+    void DriverStatCounters::snapshot(LidarDriverStats& stats) const
+    {
+        stats.capsules_decoded = statGet(capsules_decoded);
+        stats.checksum_errors = statGet(checksum_errors);
+        stats.resyncs = statGet(resyncs);
+        stats.timeouts = statGet(timeouts);
+        stats.scans_published = statGet(scans_published);
+        stats.scans_dropped = statGet(scans_dropped);
+        stats.lock_contentions = statGet(lock_contentions);
+        stats.lock_wait_us = statGet(lock_wait_us);
+        stats.decode_time_sum_us = statGet(decode_time_sum_us);
+        for (size_t pos = 0; pos < LidarDriverStats::DECODE_TIME_BUCKETS; ++pos) {
+            stats.decode_time_bucket[pos] = statGet(decode_time_bucket[pos]);
+        }
+    }
+
+    void DriverStatCounters::observeDecodeTime(sl_u64 us)
+    {
+        // bucket n holds the samples in ((1 << (n-1)), (1 << n)] us, the last one everything longer
+        size_t bucket = 0;
+        while (bucket < LidarDriverStats::DECODE_TIME_BUCKETS - 1 && us > (1ULL << bucket)) {
+            ++bucket;
+        }
+        statAdd(decode_time_bucket[bucket]);
+        statAdd(decode_time_sum_us, us);
+        statAdd(capsules_decoded);
+    }
+
+    static void appendMetric(std::string& out, const char* name, const char* type, const char* help, sl_u64 value)
+    {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, (unsigned long long)value);
+        out += buf;
+    }
+
+    std::string formatPrometheusStats(const LidarDriverStats& driverStats, const ChannelStats* channelStats)
+    {
+        std::string out;
+        char buf[128];
+
+        appendMetric(out, "sl_lidar_capsules_decoded_total", "counter", "Capsules decoded by the capture thread", driverStats.capsules_decoded);
+        appendMetric(out, "sl_lidar_checksum_errors_total", "counter", "Capsules rejected by checksum or CRC", driverStats.checksum_errors);
+        appendMetric(out, "sl_lidar_resyncs_total", "counter", "Frame synchronization losses", driverStats.resyncs);
+        appendMetric(out, "sl_lidar_timeouts_total", "counter", "Capture waits expired without a complete capsule", driverStats.timeouts);
+        appendMetric(out, "sl_lidar_scans_published_total", "counter", "Complete scans published", driverStats.scans_published);
+        appendMetric(out, "sl_lidar_scans_dropped_total", "counter", "Published scans overwritten before being grabbed", driverStats.scans_dropped);
+        appendMetric(out, "sl_lidar_lock_contentions_total", "counter", "Contended lock acquisitions by the capture thread", driverStats.lock_contentions);
+        appendMetric(out, "sl_lidar_lock_wait_microseconds_total", "counter", "Time spent by the capture thread waiting for contended locks", driverStats.lock_wait_us);
+
+        out += "# HELP sl_lidar_decode_time_microseconds Decode and publication time of one capsule\n";
+        out += "# TYPE sl_lidar_decode_time_microseconds histogram\n";
+        sl_u64 cumulative = 0;
+        for (size_t pos = 0; pos < LidarDriverStats::DECODE_TIME_BUCKETS; ++pos) {
+            cumulative += driverStats.decode_time_bucket[pos];
+            if (pos == LidarDriverStats::DECODE_TIME_BUCKETS - 1) {
+                snprintf(buf, sizeof(buf), "sl_lidar_decode_time_microseconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+            }
+            else {
+                snprintf(buf, sizeof(buf), "sl_lidar_decode_time_microseconds_bucket{le=\"%llu\"} %llu\n", (1ULL << pos), (unsigned long long)cumulative);
+            }
+            out += buf;
+        }
+        snprintf(buf, sizeof(buf), "sl_lidar_decode_time_microseconds_sum %llu\n", (unsigned long long)driverStats.decode_time_sum_us);
+        out += buf;
+        snprintf(buf, sizeof(buf), "sl_lidar_decode_time_microseconds_count %llu\n", (unsigned long long)cumulative);
+        out += buf;
+
+        if (channelStats) {
+            appendMetric(out, "sl_channel_bytes_read_total", "counter", "Bytes read from the channel", channelStats->bytes_read);
+            appendMetric(out, "sl_channel_bytes_written_total", "counter", "Bytes written to the channel", channelStats->bytes_written);
+            appendMetric(out, "sl_channel_read_calls_total", "counter", "Read system calls", channelStats->read_calls);
+            appendMetric(out, "sl_channel_wait_calls_total", "counter", "Wait (select) system calls", channelStats->wait_calls);
+            appendMetric(out, "sl_channel_wait_timeouts_total", "counter", "Waits expired without enough data", channelStats->wait_timeouts);
+            appendMetric(out, "sl_channel_datagrams_received_total", "counter", "Datagrams received (UDP)", channelStats->datagrams_received);
+            appendMetric(out, "sl_channel_datagrams_truncated_total", "counter", "Datagrams longer than the channel buffer (UDP)", channelStats->datagrams_truncated);
+            appendMetric(out, "sl_channel_datagrams_dropped_total", "counter", "Datagrams dropped by the full socket buffer (UDP)", channelStats->datagrams_dropped);
+            appendMetric(out, "sl_channel_buffered_reads_total", "counter", "Reads served from the read-ahead buffer (TCP)", channelStats->buffered_reads);
+            appendMetric(out, "sl_channel_peer_disconnects_total", "counter", "Connections closed by the peer (TCP)", channelStats->peer_disconnects);
+        }
+        return out;
+    }
+
+}}
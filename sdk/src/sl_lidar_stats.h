@@ -0,0 +1,93 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#pragma once
+
+#include "sl_lidar_driver.h"
+#include <atomic>
+#include <string>
+
+namespace sl { namespace internal {
+
+    typedef std::atomic<sl_u64> StatCounter;
+
+    // Counters are only incremented by the threads doing the I/O and can be read at any time,
+    // relaxed ordering is enough as every counter is independent
+    static inline void statAdd(StatCounter& counter, sl_u64 value = 1)
+    {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static inline sl_u64 statGet(const StatCounter& counter)
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    struct ChannelStatCounters
+    {
+        StatCounter bytes_read;
+        StatCounter bytes_written;
+        StatCounter read_calls;
+        StatCounter wait_calls;
+        StatCounter wait_timeouts;
+        StatCounter datagrams_received;
+        StatCounter datagrams_truncated;
+        StatCounter datagrams_dropped;
+        StatCounter buffered_reads;
+        StatCounter peer_disconnects;
+
+        ChannelStatCounters();
+        void snapshot(ChannelStats& stats) const;
+    };
+
+    struct DriverStatCounters
+    {
+        StatCounter capsules_decoded;
+        StatCounter checksum_errors;
+        StatCounter resyncs;
+        StatCounter timeouts;
+        StatCounter scans_published;
+        StatCounter scans_dropped;
+        StatCounter lock_contentions;
+        StatCounter lock_wait_us;
+        StatCounter decode_time_sum_us;
+        StatCounter decode_time_bucket[LidarDriverStats::DECODE_TIME_BUCKETS];
+
+        DriverStatCounters();
+        void snapshot(LidarDriverStats& stats) const;
+        void observeDecodeTime(sl_u64 us);
+    };
+
+    // Format the stats in the Prometheus text exposition format, channelStats is optional
+    std::string formatPrometheusStats(const LidarDriverStats& driverStats, const ChannelStats* channelStats);
+
+}}
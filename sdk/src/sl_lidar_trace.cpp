@@ -0,0 +1,199 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#include "sdkcommon.h"
+#include "hal/locker.h"
+#include "sl_lidar_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+namespace sl { namespace trace {
+
+    static const char TRACE_FILE_MAGIC[8] = { 'S', 'L', 'T', 'R', 'A', 'C', 'E', '1' };
+
+    static const char* const TRACE_EVENT_NAMES[TRACE_EVENT_COUNT] = {
+        "bytes_arrived",
+        "capsule_framed",
+        "decode",
+        "scan_publish",
+        "sector_publish",
+        "grab_wakeup",
+    };
+
+#ifdef SL_LIDAR_ENABLE_TRACE
+    struct TraceRing
+    {
+        enum
+        {
+            CAPACITY = 16384, // must be a power of 2
+        };
+
+        TraceRecord             records[CAPACITY];
+        std::atomic<sl_u64>     head;
+        sl_u32                  thread_id;
+    };
+
+    static rp::hal::Locker& ringRegistryLock()
+    {
+        static rp::hal::Locker lock;
+        return lock;
+    }
+
+    // the rings are never released: a thread may exit before the trace is dumped
+    static std::vector<TraceRing*>& ringRegistry()
+    {
+        static std::vector<TraceRing*> rings;
+        return rings;
+    }
+
+    static TraceRing* registerRing()
+    {
+        TraceRing* ring = new TraceRing();
+        ring->head.store(0);
+
+        rp::hal::AutoLocker l(ringRegistryLock());
+        ring->thread_id = (sl_u32)ringRegistry().size() + 1;
+        ringRegistry().push_back(ring);
+        return ring;
+    }
+
+    void record(sl_u16 event, sl_u8 phase, sl_u32 arg)
+    {
+        static thread_local TraceRing* localRing = NULL;
+        if (!localRing) localRing = registerRing();
+
+        // single writer per ring: no atomic read-modify-write needed
+        sl_u64 head = localRing->head.load(std::memory_order_relaxed);
+        TraceRecord& rec = localRing->records[head & (TraceRing::CAPACITY - 1)];
+        rec.timestamp_us = getus();
+        rec.thread_id = localRing->thread_id;
+        rec.arg = arg;
+        rec.event = event;
+        rec.phase = phase;
+        rec.reserved = 0;
+        localRing->head.store(head + 1, std::memory_order_release);
+    }
+#endif
+
+}}
+
+namespace sl {
+
+    sl_result dumpTrace(const char* path)
+    {
+#ifdef SL_LIDAR_ENABLE_TRACE
+        using namespace trace;
+
+        std::vector<TraceRecord> records;
+        {
+            rp::hal::AutoLocker l(ringRegistryLock());
+            for (size_t pos = 0; pos < ringRegistry().size(); ++pos) {
+                TraceRing* ring = ringRegistry()[pos];
+                // The owner thread keeps recording while the ring is copied: the slot of the oldest record is the next
+                // one written, so it is skipped, and the records overwritten during the copy are dropped afterwards.
+                sl_u64 head = ring->head.load(std::memory_order_acquire);
+                sl_u64 tail = (head >= TraceRing::CAPACITY) ? (head - TraceRing::CAPACITY + 1) : 0;
+                size_t first = records.size();
+                for (sl_u64 idx = tail; idx < head; ++idx) {
+                    records.push_back(ring->records[idx & (TraceRing::CAPACITY - 1)]);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                sl_u64 headAfter = ring->head.load(std::memory_order_relaxed);
+                sl_u64 validTail = (headAfter >= TraceRing::CAPACITY) ? (headAfter - TraceRing::CAPACITY + 1) : 0;
+                if (validTail > tail) {
+                    size_t torn = (size_t)std::min(validTail - tail, head - tail);
+                    records.erase(records.begin() + first, records.begin() + first + torn);
+                }
+            }
+        }
+
+        FILE* fp = fopen(path, "wb");
+        if (!fp) return SL_RESULT_OPERATION_FAIL;
+
+        sl_u32 count = (sl_u32)records.size();
+        bool ok = (fwrite(TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC), 1, fp) == 1)
+            && (fwrite(&count, sizeof(count), 1, fp) == 1)
+            && (!count || fwrite(&records[0], sizeof(TraceRecord), count, fp) == count);
+        fclose(fp);
+        return ok ? SL_RESULT_OK : SL_RESULT_OPERATION_FAIL;
+#else
+        (void)path;
+        return SL_RESULT_OPERATION_NOT_SUPPORT;
+#endif
+    }
+
+    sl_result convertTraceToJson(const char* tracePath, const char* jsonPath)
+    {
+        using namespace trace;
+
+        FILE* in = fopen(tracePath, "rb");
+        if (!in) return SL_RESULT_OPERATION_FAIL;
+
+        char magic[sizeof(TRACE_FILE_MAGIC)];
+        sl_u32 count = 0;
+        if (fread(magic, sizeof(magic), 1, in) != 1 || memcmp(magic, TRACE_FILE_MAGIC, sizeof(magic)) != 0
+            || fread(&count, sizeof(count), 1, in) != 1) {
+            fclose(in);
+            return SL_RESULT_INVALID_DATA;
+        }
+
+        FILE* out = fopen(jsonPath, "w");
+        if (!out) {
+            fclose(in);
+            return SL_RESULT_OPERATION_FAIL;
+        }
+
+        sl_result ans = SL_RESULT_OK;
+        fprintf(out, "{\"traceEvents\":[\n");
+        for (sl_u32 pos = 0; pos < count; ++pos) {
+            TraceRecord rec;
+            if (fread(&rec, sizeof(rec), 1, in) != 1) {
+                ans = SL_RESULT_INVALID_DATA;
+                break;
+            }
+            const char* name = (rec.event < TRACE_EVENT_COUNT) ? TRACE_EVENT_NAMES[rec.event] : "unknown";
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%u%s,\"args\":{\"arg\":%u}}\n",
+                pos ? "," : "", name, (char)rec.phase, (unsigned long long)rec.timestamp_us, rec.thread_id,
+                (rec.phase == PHASE_INSTANT) ? ",\"s\":\"t\"" : "", rec.arg);
+        }
+        fprintf(out, "]}\n");
+
+        fclose(out);
+        fclose(in);
+        return ans;
+    }
+
+}
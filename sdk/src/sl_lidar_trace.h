@@ -0,0 +1,84 @@
+/*
+ * Slamtec LIDAR SDK
+ *
+ *  Copyright (c) 2014 - 2020 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+ /*
+  * Redistribution and use in source and binary forms, with or without
+  * modification, are permitted provided that the following conditions are met:
+  *
+  * 1. Redistributions of source code must retain the above copyright notice,
+  *    this list of conditions and the following disclaimer.
+  *
+  * 2. Redistributions in binary form must reproduce the above copyright notice,
+  *    this list of conditions and the following disclaimer in the documentation
+  *    and/or other materials provided with the distribution.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+  * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+  * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+  * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+  * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  */
+
+#pragma once
+
+#include "sl_lidar_driver.h"
+
+// Hot path trace points, only compiled in when SL_LIDAR_ENABLE_TRACE is defined (make TRACE=1).
+// Every thread records into its own ring, see dumpTrace() and convertTraceToJson().
+
+namespace sl { namespace trace {
+
+    enum TraceEventId
+    {
+        TRACE_BYTES_ARRIVED = 0,     // instant, arg: bytes read by a framer
+        TRACE_CAPSULE_FRAMED,        // instant, arg: result of the framer
+        TRACE_DECODE,                // begin/end, decode and publication of one capsule
+        TRACE_SCAN_PUBLISH,          // instant, arg: node count of the published scan
+        TRACE_SECTOR_PUBLISH,        // instant, arg: index of the published sector
+        TRACE_GRAB_WAKEUP,           // instant, arg: result of the wait
+        TRACE_EVENT_COUNT,
+    };
+
+    enum TracePhase
+    {
+        PHASE_BEGIN = 'B',
+        PHASE_END = 'E',
+        PHASE_INSTANT = 'i',
+    };
+
+    struct TraceRecord
+    {
+        sl_u64  timestamp_us;
+        sl_u32  thread_id;
+        sl_u32  arg;
+        sl_u16  event;
+        sl_u8   phase;
+        sl_u8   reserved;
+    };
+
+#ifdef SL_LIDAR_ENABLE_TRACE
+    void record(sl_u16 event, sl_u8 phase, sl_u32 arg);
+#endif
+
+}}
+
+#ifdef SL_LIDAR_ENABLE_TRACE
+#define SL_TRACE_BEGIN(event)           sl::trace::record(sl::trace::event, sl::trace::PHASE_BEGIN, 0)
+#define SL_TRACE_END(event)             sl::trace::record(sl::trace::event, sl::trace::PHASE_END, 0)
+#define SL_TRACE_INSTANT(event, arg)    sl::trace::record(sl::trace::event, sl::trace::PHASE_INSTANT, (sl_u32)(arg))
+#else
+#define SL_TRACE_BEGIN(event)           do {} while (0)
+#define SL_TRACE_END(event)             do {} while (0)
+#define SL_TRACE_INSTANT(event, arg)    do {} while (0)
+#endif
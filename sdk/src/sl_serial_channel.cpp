@@ -30,9 +30,11 @@
   *
   */
 
+#include "sdkcommon.h"
 #include "sl_lidar_driver.h"
 #include "hal/abs_rxtx.h"
 #include "hal/socket.h"
+#include "sl_lidar_stats.h"
 
 
 namespace sl {
@@ -40,10 +42,13 @@ namespace sl {
     class SerialPortChannel : public ISerialPortChannel
     {
     public:
-        SerialPortChannel(const std::string& device, int baudrate) :_rxtxSerial(rp::hal::serial_rxtx::CreateRxTx())
+        SerialPortChannel(const std::string& device, int baudrate, sl_u32 flags) :_rxtxSerial(rp::hal::serial_rxtx::CreateRxTx())
         {
             _device = device;
             _baudrate = baudrate;
+            _flags = 0;
+            if (flags & SERIAL_PORT_FLAG_LOW_LATENCY) _flags |= rp::hal::serial_rxtx::FLAG_LOW_LATENCY;
+            if (flags & SERIAL_PORT_FLAG_IO_URING) _flags |= rp::hal::serial_rxtx::FLAG_IO_URING;
         }
 
         ~SerialPortChannel()
@@ -55,7 +60,7 @@ namespace sl {
         bool bind(const std::string& device, sl_s32 baudrate)
         {
             _closePending = false;
-            return _rxtxSerial->bind(device.c_str(), baudrate);
+            return _rxtxSerial->bind(device.c_str(), baudrate, _flags);
         }
 
         bool open()
@@ -76,24 +81,50 @@ namespace sl {
             _rxtxSerial->flush(0);
         }
 
+        void cancelWait()
+        {
+            _rxtxSerial->cancelOperation();
+        }
+
+        void resumeWait()
+        {
+            _rxtxSerial->resumeOperation();
+        }
+
         bool waitForData(size_t size, sl_u32 timeoutInMs, size_t* actualReady)
         {
             if (_closePending) return false;
-            return (_rxtxSerial->waitfordata(size, timeoutInMs, actualReady) == rp::hal::serial_rxtx::ANS_OK);
+            internal::statAdd(_stats.wait_calls);
+            if (_rxtxSerial->waitfordata(size, timeoutInMs, actualReady) != rp::hal::serial_rxtx::ANS_OK) {
+                internal::statAdd(_stats.wait_timeouts);
+                return false;
+            }
+            return true;
         }
 
         int write(const void* data, size_t size)
         {
-           return _rxtxSerial->senddata((const sl_u8 * )data, size);
+           int lenSent = _rxtxSerial->senddata((const sl_u8 * )data, size);
+           if (lenSent > 0) internal::statAdd(_stats.bytes_written, lenSent);
+           return lenSent;
         }
 
         int read(void* buffer, size_t size)
         {
             size_t lenRec = 0;
             lenRec = _rxtxSerial->recvdata((sl_u8 *)buffer, size);
+            if (!_rxtxSerial->isRingReceiveActive()) internal::statAdd(_stats.read_calls);
+            internal::statAdd(_stats.bytes_read, lenRec);
             return lenRec;
         }
 
+        // The driver of the port does not tell when the bytes came in, the time they are picked up is the closest one
+        int readWithTimestamp(void* buffer, size_t size, sl_u64* timestampUs)
+        {
+            if (timestampUs) *timestampUs = getus();
+            return read(buffer, size);
+        }
+
         void clearReadCache()
         {
            
@@ -104,21 +135,45 @@ namespace sl {
             dtr ? _rxtxSerial->setDTR() : _rxtxSerial->clearDTR();
         }
 
+        bool setBaudRate(sl_u32 baudrate)
+        {
+            _baudrate = (int)baudrate;
+            return true;
+        }
+
+        sl_u32 getBaudRate()
+        {
+            return (sl_u32)_baudrate;
+        }
+
         int getChannelType() {
             return CHANNEL_TYPE_SERIALPORT;
         }
 
+        sl_result getStats(ChannelStats& stats)
+        {
+            _stats.snapshot(stats);
+            return SL_RESULT_OK;
+        }
+
+        int getPollHandle()
+        {
+            return _rxtxSerial->getPollHandle();
+        }
+
     private:
         rp::hal::serial_rxtx  * _rxtxSerial;
         bool _closePending;
         std::string _device;
         int _baudrate;
+        sl_u32 _flags;
+        internal::ChannelStatCounters _stats;
 
     };
 
-    Result<IChannel*> createSerialPortChannel(const std::string& device, int baudrate)
+    Result<IChannel*> createSerialPortChannel(const std::string& device, int baudrate, sl_u32 flags)
     {
-        return new  SerialPortChannel(device, baudrate);
+        return new  SerialPortChannel(device, baudrate, flags);
     }
 
 }
\ No newline at end of file
@@ -30,9 +30,12 @@
   *
   */
 
+#include "sdkcommon.h"
 #include "sl_lidar_driver.h"
 #include "hal/abs_rxtx.h"
 #include "hal/socket.h"
+#include "sl_lidar_stats.h"
+#include <vector>
 
 
 namespace sl {
@@ -40,9 +43,23 @@ namespace sl {
     class TcpChannel : public IChannel
     {
     public:
-        TcpChannel(const std::string& ip, int port) : _binded_socket(rp::net::StreamSocket::CreateSocket()) {
+        enum {
+            // size of the read-ahead buffer, a single receive takes whatever the socket holds up to it
+            READ_AHEAD_SIZE = 32 * 1024,
+            // arrival times kept for the buffered bytes, one per receive, the older ones are merged once it is full
+            READ_AHEAD_SEGMENTS = 16,
+        };
+
+        TcpChannel(const std::string& ip, int port, size_t receiveBufferSize, sl_u32 flags)
+            : _binded_socket(rp::net::StreamSocket::CreateSocket())
+            , _receive_buffer_size(receiveBufferSize)
+            , _flags(flags)
+            , _ring_receive(false)
+            , _rx_buffer(READ_AHEAD_SIZE)
+        {
             _ip = ip;
             _port = port;
+            _resetBuffer();
         }
 
         bool bind(const std::string & ip, sl_s32 port)
@@ -55,12 +72,25 @@ namespace sl {
         {
             if(SL_IS_FAIL(bind(_ip, _port)))
                 return false;
-            return IS_OK(_binded_socket->connect(_socket));
-            
+            // a closed channel gets a new socket, so that it can be reopened
+            if (!_binded_socket) _binded_socket = rp::net::StreamSocket::CreateSocket();
+            if (!_binded_socket)
+                return false;
+            _resetBuffer();
+            // set before the connection, so that the window advertised to the device accounts for it
+            if (_receive_buffer_size) _binded_socket->setReceiveBufferSize(_receive_buffer_size);
+            if (IS_FAIL(_binded_socket->connect(_socket)))
+                return false;
+            // the requests are small and each one waits for its answer, they must not be held by Nagle
+            _binded_socket->enableNoDelay(true);
+            _binded_socket->enableKeepAlive(true);
+            _ring_receive = (_flags & NETWORK_CHANNEL_FLAG_IO_URING) && IS_OK(_binded_socket->enableRingReceive());
+            return true;
         }
 
         void close()
         {
+            if (!_binded_socket) return;
             _binded_socket->dispose();
             _binded_socket = NULL;
         }
@@ -69,26 +99,77 @@ namespace sl {
         
         }
 
+        void cancelWait()
+        {
+            if (_binded_socket) _binded_socket->cancelWait();
+        }
+
+        void resumeWait()
+        {
+            if (_binded_socket) _binded_socket->resumeWait();
+        }
+
         bool waitForData(size_t size, sl_u32 timeoutInMs, size_t* actualReady)
         {
-            if (actualReady)
-                *actualReady = size;
-            return (_binded_socket->waitforData(timeoutInMs) == RESULT_OK);
+            sl_u32 startTs = getms();
+            sl_u32 waitTime = 0;
+            bool ok = true;
+
+            // a request larger than the buffer is satisfied once the buffer is full
+            size = std::min(size, _rx_buffer.size());
+            if (_buffered() < size) _fill();
+            while (_buffered() < size) {
+                waitTime = getms() - startTs;
+                if (_peer_closed || waitTime > timeoutInMs) {
+                    ok = false;
+                    break;
+                }
+                internal::statAdd(_stats.wait_calls);
+                if (_binded_socket->waitforData(timeoutInMs - waitTime) != RESULT_OK) {
+                    ok = false;
+                    break;
+                }
+                _fill();
+            }
 
+            if (!ok) internal::statAdd(_stats.wait_timeouts);
+            if (actualReady)
+                *actualReady = _buffered();
+            return ok;
         }
 
         int write(const void* data, size_t size)
         {
-            return _binded_socket->send(data, size);
+            u_result ans = _binded_socket->send(data, size);
+            if (IS_OK(ans)) internal::statAdd(_stats.bytes_written, size);
+            return ans;
         }
 
+        // Served from the read-ahead buffer, refilled only once it is empty
         int read(void* buffer, size_t size)
         {
-            size_t lenRec = 0;
-            _binded_socket->recv(buffer, size, lenRec);
+            if (!_buffered()) {
+                _fill();
+            } else {
+                internal::statAdd(_stats.buffered_reads);
+            }
+
+            size_t lenRec = std::min(size, _buffered());
+            memcpy(buffer, &_rx_buffer[_rx_begin], lenRec);
+            _rx_begin += lenRec;
+            internal::statAdd(_stats.bytes_read, lenRec);
             return lenRec;
         }
 
+        // Stamped with the time the receive which brought the first returned byte was made
+        int readWithTimestamp(void* buffer, size_t size, sl_u64* timestampUs)
+        {
+            if (!_buffered()) _fill();
+            while (_seg_count && _seg_end[0] <= _rx_begin) _popSegment();
+            if (timestampUs) *timestampUs = _seg_count ? _seg_ts[0] : 0;
+            return read(buffer, size);
+        }
+
         void clearReadCache() {}
 
         void setStatus(_u32 flag){}
@@ -96,14 +177,95 @@ namespace sl {
         int getChannelType() {
             return CHANNEL_TYPE_TCP;
         }
+
+        sl_result getStats(ChannelStats& stats)
+        {
+            _stats.snapshot(stats);
+            return SL_RESULT_OK;
+        }
+
+        int getPollHandle()
+        {
+            return _binded_socket ? _binded_socket->getPollHandle() : -1;
+        }
     private:
+        size_t _buffered() const
+        {
+            return _rx_end - _rx_begin;
+        }
+
+        void _resetBuffer()
+        {
+            _rx_begin = 0;
+            _rx_end = 0;
+            _seg_count = 0;
+            _peer_closed = false;
+        }
+
+        void _popSegment()
+        {
+            --_seg_count;
+            memmove(_seg_end, _seg_end + 1, sizeof(_seg_end[0]) * _seg_count);
+            memmove(_seg_ts, _seg_ts + 1, sizeof(_seg_ts[0]) * _seg_count);
+        }
+
+        // Append what the socket already holds to the buffer, in a single receive without blocking
+        void _fill()
+        {
+            if (_peer_closed) return;
+            if (_rx_begin == _rx_end) {
+                _rx_begin = _rx_end = 0;
+                _seg_count = 0;
+            } else if (_rx_begin) {
+                memmove(&_rx_buffer[0], &_rx_buffer[_rx_begin], _buffered());
+                for (size_t pos = 0; pos < _seg_count; ++pos) {
+                    _seg_end[pos] = _seg_end[pos] > _rx_begin ? _seg_end[pos] - _rx_begin : 0;
+                }
+                _rx_end -= _rx_begin;
+                _rx_begin = 0;
+            }
+            if (_rx_end == _rx_buffer.size()) return;
+
+            size_t lenRec = 0;
+            sl_u64 receiveTs = getus();
+            if (!_ring_receive) internal::statAdd(_stats.read_calls);
+            u_result ans = _binded_socket->recvNoWait(&_rx_buffer[_rx_end], _rx_buffer.size() - _rx_end, lenRec);
+            if (ans == RESULT_OPERATION_TIMEOUT) return;
+            if (IS_FAIL(ans) || !lenRec) {
+                // the connection is gone, the link recovery of the driver reopens the channel
+                _peer_closed = true;
+                internal::statAdd(_stats.peer_disconnects);
+                return;
+            }
+            _rx_end += lenRec;
+            if (_seg_count == READ_AHEAD_SEGMENTS) {
+                _seg_end[_seg_count - 1] = _rx_end;
+            } else {
+                _seg_end[_seg_count] = _rx_end;
+                _seg_ts[_seg_count] = receiveTs;
+                ++_seg_count;
+            }
+        }
+
         rp::net::StreamSocket * _binded_socket;
         rp::net::SocketAddress _socket;
         std::string _ip;
         int _port;
+        size_t _receive_buffer_size;
+        sl_u32 _flags;
+        bool _ring_receive;
+        internal::ChannelStatCounters _stats;
+
+        std::vector<sl_u8> _rx_buffer;
+        size_t _rx_begin;
+        size_t _rx_end;
+        size_t _seg_end[READ_AHEAD_SEGMENTS];
+        sl_u64 _seg_ts[READ_AHEAD_SEGMENTS];
+        size_t _seg_count;
+        bool _peer_closed;
     };
-    Result<IChannel*> createTcpChannel(const std::string& ip, int port)
+    Result<IChannel*> createTcpChannel(const std::string& ip, int port, size_t receiveBufferSize, sl_u32 flags)
     {
-        return new  TcpChannel(ip, port);
+        return new  TcpChannel(ip, port, receiveBufferSize, flags);
     }
 }
\ No newline at end of file
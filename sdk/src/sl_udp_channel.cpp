@@ -30,18 +30,35 @@
   *
   */
 
+#include "sdkcommon.h"
 #include "sl_lidar_driver.h"
 #include "hal/abs_rxtx.h"
 #include "hal/socket.h"
+#include "sl_lidar_stats.h"
+#include <vector>
 
 
 namespace sl {
 	class UdpChannel : public IChannel
 	{
 	public:
-		UdpChannel(const std::string& ip, int port) : _binded_socket(rp::net::DGramSocket::CreateSocket()) {
+        enum {
+            // a datagram longer than this is truncated and counted in ChannelStats::datagrams_truncated
+            MAX_DATAGRAM_SIZE = 4096,
+            // datagrams received but not read yet, the socket buffer holds the following ones
+            DATAGRAM_POOL_SIZE = 64,
+        };
+
+		UdpChannel(const std::string& ip, int port, size_t receiveBufferSize, sl_u32 flags)
+            : _binded_socket(rp::net::DGramSocket::CreateSocket())
+            , _receive_buffer_size(receiveBufferSize)
+            , _flags(flags)
+            , _ring_receive(false)
+            , _pool(MAX_DATAGRAM_SIZE * DATAGRAM_POOL_SIZE)
+        {
             _ip = ip;
             _port = port;
+            _resetPool();
         }
 
 		bool bind(const std::string & ip, sl_s32 port)
@@ -54,50 +71,108 @@ namespace sl {
         {
             if(SL_IS_FAIL(bind(_ip, _port)))
                 return false;
-            return SL_IS_OK(_binded_socket->setPairAddress(&_socket));         
+            // a closed channel gets a new socket, so that it can be reopened
+            if (!_binded_socket) _binded_socket = rp::net::DGramSocket::CreateSocket();
+            if (!_binded_socket)
+                return false;
+            _resetPool();
+            if (_receive_buffer_size) _binded_socket->setReceiveBufferSize(_receive_buffer_size);
+            if (SL_IS_FAIL(_binded_socket->setPairAddress(&_socket)))
+                return false;
+            _ring_receive = (_flags & NETWORK_CHANNEL_FLAG_IO_URING) && IS_OK(_binded_socket->enableRingReceive());
+            return true;
         }
 
         void close()
         {
+            if (!_binded_socket) return;
             _binded_socket->dispose();
             _binded_socket = NULL;
         }
         void flush()
         {
         
+        }
+
+        void cancelWait()
+        {
+            if (_binded_socket) _binded_socket->cancelWait();
+        }
+
+        void resumeWait()
+        {
+            if (_binded_socket) _binded_socket->resumeWait();
         }
 
 		bool waitForData(size_t size, sl_u32 timeoutInMs, size_t* actualReady)
         {
-            if (actualReady)
-                *actualReady = size;
-            return (_binded_socket->waitforData(timeoutInMs) == RESULT_OK);
+            sl_u32 startTs = getms();
+            sl_u32 waitTime = 0;
+            bool ok = true;
+
+            _receiveQueued();
+            while (_buffered_bytes < size && _queued_count < DATAGRAM_POOL_SIZE) {
+                waitTime = getms() - startTs;
+                if (waitTime > timeoutInMs) {
+                    ok = false;
+                    break;
+                }
+                internal::statAdd(_stats.wait_calls);
+                if (_binded_socket->waitforData(timeoutInMs - waitTime) != RESULT_OK) {
+                    ok = false;
+                    break;
+                }
+                _receiveQueued();
+            }
 
+            if (!ok) internal::statAdd(_stats.wait_timeouts);
+            if (actualReady)
+                *actualReady = _buffered_bytes;
+            return ok;
         }
 
         int write(const void* data, size_t size)
         {
-            return _binded_socket->sendTo(_socket, data, size);
+            u_result ans = _binded_socket->sendTo(_socket, data, size);
+            if (IS_OK(ans)) internal::statAdd(_stats.bytes_written, size);
+            return ans;
         }
 
+        // Served from the datagrams already received, a datagram can be consumed over several reads
         int read(void* buffer, size_t size)
         {
-            u_result ans;
+            if (!_buffered_bytes) _receiveQueued();
+
             size_t recCnt = 0;
-            size_t lenRec = 0;
-            while (size > recCnt)
-            {
-				sl_u8 *temp = (sl_u8 *)buffer+recCnt;
-                ans = _binded_socket->recvFrom(temp, size, lenRec);
-                recCnt += lenRec;
-                if (ans)
-                    break;
+            while (recCnt < size && _queued_count) {
+                size_t slot = _queued_head;
+                size_t avail = _datagram_size[slot] - _read_offset;
+                size_t chunk = std::min(avail, size - recCnt);
+                memcpy((sl_u8 *)buffer + recCnt, &_pool[slot * MAX_DATAGRAM_SIZE + _read_offset], chunk);
+                recCnt += chunk;
+                _read_offset += chunk;
+                _buffered_bytes -= chunk;
+                if (_read_offset == _datagram_size[slot]) {
+                    _queued_head = (_queued_head + 1) % DATAGRAM_POOL_SIZE;
+                    --_queued_count;
+                    _read_offset = 0;
+                }
             }
+            internal::statAdd(_stats.bytes_read, recCnt);
             return recCnt;
         
         }
 
+        // Stamped with the time the datagram holding the first returned byte was received by the kernel
+        int readWithTimestamp(void* buffer, size_t size, sl_u64* timestampUs)
+        {
+            if (!_buffered_bytes) _receiveQueued();
+            if (timestampUs) *timestampUs = _queued_count ? _datagram_ts[_queued_head] : 0;
+            return read(buffer, size);
+        }
+
         void clearReadCache() {
+          _resetPool();
           _binded_socket->clearRxCache();
         }
 
@@ -107,15 +182,86 @@ namespace sl {
             return CHANNEL_TYPE_UDP;
         }
 
+        sl_result getStats(ChannelStats& stats)
+        {
+            _stats.snapshot(stats);
+            return SL_RESULT_OK;
+        }
+
+        int getPollHandle()
+        {
+            return _binded_socket ? _binded_socket->getPollHandle() : -1;
+        }
+
 	private:
+        void _resetPool()
+        {
+            _queued_head = 0;
+            _queued_count = 0;
+            _read_offset = 0;
+            _buffered_bytes = 0;
+            _socket_drops = 0;
+        }
+
+        // Move the datagrams queued by the socket into the free slots of the pool, without blocking
+        void _receiveQueued()
+        {
+            rp::net::DGramSocket::Datagram datagrams[DATAGRAM_POOL_SIZE];
+            size_t freeSlots = DATAGRAM_POOL_SIZE - _queued_count;
+            if (!freeSlots) return;
+
+            size_t firstFree = (_queued_head + _queued_count) % DATAGRAM_POOL_SIZE;
+            for (size_t pos = 0; pos < freeSlots; ++pos) {
+                size_t slot = (firstFree + pos) % DATAGRAM_POOL_SIZE;
+                datagrams[pos].buf = &_pool[slot * MAX_DATAGRAM_SIZE];
+                datagrams[pos].len = MAX_DATAGRAM_SIZE;
+            }
+
+            size_t received = 0;
+            if (!_ring_receive) internal::statAdd(_stats.read_calls);
+            if (IS_FAIL(_binded_socket->recvBatch(datagrams, freeSlots, received))) return;
+            sl_u64 receiveTs = getus();
+
+            for (size_t pos = 0; pos < received; ++pos) {
+                const rp::net::DGramSocket::Datagram& dgram = datagrams[pos];
+                size_t size = std::min(dgram.recv_len, (size_t)MAX_DATAGRAM_SIZE);
+                if (dgram.truncated) internal::statAdd(_stats.datagrams_truncated);
+                // the socket reports a running total of its drops
+                if (dgram.drops > _socket_drops) {
+                    internal::statAdd(_stats.datagrams_dropped, dgram.drops - _socket_drops);
+                    _socket_drops = dgram.drops;
+                }
+                // an empty datagram keeps its slot, read() skips it
+                _datagram_size[(firstFree + pos) % DATAGRAM_POOL_SIZE] = size;
+                // without a kernel timestamp, the datagram is stamped when it is taken from the socket
+                _datagram_ts[(firstFree + pos) % DATAGRAM_POOL_SIZE] = dgram.timestamp_us ? dgram.timestamp_us : receiveTs;
+                _buffered_bytes += size;
+            }
+            _queued_count += received;
+            internal::statAdd(_stats.datagrams_received, received);
+        }
+
 		rp::net::DGramSocket * _binded_socket;
 		rp::net::SocketAddress _socket;
         std::string _ip;
         int _port;
+        size_t _receive_buffer_size;
+        sl_u32 _flags;
+        bool _ring_receive;
+        internal::ChannelStatCounters _stats;
+
+        std::vector<sl_u8> _pool;
+        size_t _datagram_size[DATAGRAM_POOL_SIZE];
+        sl_u64 _datagram_ts[DATAGRAM_POOL_SIZE];
+        size_t _queued_head;
+        size_t _queued_count;
+        size_t _read_offset;
+        size_t _buffered_bytes;
+        sl_u32 _socket_drops;
 	};
 
-    Result<IChannel*> createUdpChannel(const std::string& ip, int port)
+    Result<IChannel*> createUdpChannel(const std::string& ip, int port, size_t receiveBufferSize, sl_u32 flags)
     {
-        return new  UdpChannel(ip, port);
+        return new  UdpChannel(ip, port, receiveBufferSize, flags);
     }
-}
\ No newline at end of file
+}